@@ -1,3 +1,16 @@
 # File for module specific CMake tests.
 find_package(Matlab REQUIRED)
 include_directories(${Matlab_INCLUDE_DIRS})
+
+# optional, used for compressed vtu output
+find_package(ZLIB)
+set(HAVE_ZLIB ${ZLIB_FOUND})
+if(ZLIB_FOUND)
+  include_directories(${ZLIB_INCLUDE_DIRS})
+endif()
+
+# shm_open is part of librt before glibc 2.34, used by the server mode
+find_library(RT_LIBRARY rt)
+if(NOT RT_LIBRARY)
+  set(RT_LIBRARY "")
+endif()
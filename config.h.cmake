@@ -40,6 +40,9 @@
 /* Define to the revision of duneuro-matlab */
 #define DUNEURO_MATLAB_VERSION_REVISION @DUNEURO_MATLAB_VERSION_REVISION@
 
+/* Define to 1 if zlib is available, used for compressed vtu output */
+#cmakedefine HAVE_ZLIB 1
+
 /* end duneuro-matlab
    Everything below here will be overwritten
 */
@@ -0,0 +1,109 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/array_file.hh>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/server_protocol.hh>
+#include <duneuro/matlab/temporary_file.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    const char arrayFileMagic[8] = {'D', 'U', 'N', 'E', 'U', 'R', 'A', 'R'};
+    const std::uint64_t arrayFileVersion = 1;
+  }
+
+  void write_array_file(const std::string& filename, const mxArray* arr)
+  {
+    ScopedPhase phase("write_array_file");
+    const auto tmpname = temporary_filename(filename);
+    {
+      std::ofstream stream(tmpname, std::ios::binary);
+      if (!stream) {
+        DUNE_THROW(Dune::IOError, "could not open array file \"" << tmpname << "\"");
+      }
+      MessageWriter writer(stream);
+      writer.write_bytes(arrayFileMagic, sizeof(arrayFileMagic));
+      writer.write(arrayFileVersion);
+      // files never refer to shared memory
+      SharedMemorySegments segments(0);
+      try {
+        writer.write_array(arr, segments);
+      } catch (...) {
+        stream.close();
+        std::remove(tmpname.c_str());
+        throw;
+      }
+      phase.add_bytes(stream.tellp());
+      stream.close();
+      if (!stream) {
+        std::remove(tmpname.c_str());
+        DUNE_THROW(Dune::IOError, "could not write array file \"" << tmpname << "\"");
+      }
+    }
+    if (std::rename(tmpname.c_str(), filename.c_str()) != 0) {
+      std::remove(tmpname.c_str());
+      DUNE_THROW(Dune::IOError, "could not move array file to \"" << filename << "\"");
+    }
+  }
+
+  mxArray* read_array_file(const std::string& filename)
+  {
+    ScopedPhase phase("read_array_file");
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      DUNE_THROW(Dune::IOError, "could not open array file \"" << filename << "\": "
+                                                               << std::strerror(errno));
+    }
+    struct stat st;
+    const std::size_t header = sizeof(arrayFileMagic) + sizeof(arrayFileVersion);
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < header) {
+      ::close(fd);
+      DUNE_THROW(Dune::IOError, "array file \"" << filename << "\" is truncated");
+    }
+    const std::size_t size = st.st_size;
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      DUNE_THROW(Dune::IOError, "could not map array file \"" << filename << "\": "
+                                                              << std::strerror(errno));
+    }
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+    phase.add_bytes(size);
+    try {
+      MessageReader reader(static_cast<const char*>(mapping), size);
+      char magic[sizeof(arrayFileMagic)];
+      reader.read_bytes(magic, sizeof(magic));
+      if (std::memcmp(magic, arrayFileMagic, sizeof(magic)) != 0) {
+        DUNE_THROW(Dune::IOError, "\"" << filename << "\" is not an array file");
+      }
+      const auto version = reader.read<std::uint64_t>();
+      if (version != arrayFileVersion) {
+        DUNE_THROW(Dune::IOError, "array file \"" << filename << "\" has version " << version
+                                                  << ", expected " << arrayFileVersion);
+      }
+      mxArray* arr = reader.read_array();
+      ::munmap(mapping, size);
+      return arr;
+    } catch (...) {
+      ::munmap(mapping, size);
+      throw;
+    }
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef DUNEURO_MATLAB_ARRAY_FILE_HH
+#define DUNEURO_MATLAB_ARRAY_FILE_HH
+
+#include <mex.h>
+
+#include <string>
+
+namespace duneuro
+{
+  /**
+   * \brief write a matlab array to a binary file
+   *
+   * the file consists of a magic, a version and the array in the encoding of server_protocol.hh,
+   * which covers numeric, logical, char, struct and cell arrays in native byte order. It is
+   * written to a temporary name and renamed afterwards. Array files are used to exchange inputs
+   * and results with duneuro_matlab_runner.
+   */
+  void write_array_file(const std::string& filename, const mxArray* arr);
+
+  /** \brief read an array written by write_array_file, the file is memory mapped */
+  mxArray* read_array_file(const std::string& filename);
+}
+
+#endif // DUNEURO_MATLAB_ARRAY_FILE_HH
@@ -0,0 +1,200 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/async.hh>
+
+#include <exception>
+
+#include <dune/common/exceptions.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    struct AsyncJobCancelled {
+    };
+  }
+
+  AsyncJob::AsyncJob(Work work)
+      : work_(std::move(work))
+      , state_(State::pending)
+      , retrieved_(false)
+      , cancelRequested_(false)
+  {
+  }
+
+  AsyncJob::State AsyncJob::state() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state_;
+  }
+
+  std::string AsyncJob::state_name() const
+  {
+    switch (state()) {
+    case State::pending: return "pending";
+    case State::running: return "running";
+    case State::finished: return "finished";
+    case State::failed: return "failed";
+    case State::cancelled: return "cancelled";
+    }
+    return "unknown";
+  }
+
+  void AsyncJob::cancel()
+  {
+    cancelRequested_ = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::pending) {
+      state_ = State::cancelled;
+      finished_.notify_all();
+    }
+  }
+
+  void AsyncJob::checkpoint() const
+  {
+    if (cancelRequested_) {
+      throw AsyncJobCancelled();
+    }
+  }
+
+  void AsyncJob::wait() const
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this]() {
+      return state_ == State::finished || state_ == State::failed || state_ == State::cancelled;
+    });
+  }
+
+  void AsyncJob::run()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (state_ != State::pending) {
+        return;
+      }
+      state_ = State::running;
+    }
+    State state = State::finished;
+    Marshal marshal;
+    std::string error;
+    try {
+      marshal = work_(*this);
+      if (cancelRequested_) {
+        state = State::cancelled;
+      }
+    } catch (AsyncJobCancelled&) {
+      state = State::cancelled;
+    } catch (Dune::Exception& ex) {
+      state = State::failed;
+      error = ex.what();
+    } catch (std::exception& ex) {
+      state = State::failed;
+      error = ex.what();
+    } catch (...) {
+      state = State::failed;
+      error = "unknown error";
+    }
+    // release the inputs owned by the work function
+    work_ = Work();
+    std::lock_guard<std::mutex> lock(mutex_);
+    state_ = state;
+    if (state == State::finished) {
+      marshal_ = std::move(marshal);
+    }
+    error_ = error;
+    finished_.notify_all();
+  }
+
+  void AsyncJob::retrieve(int nlhs, mxArray* plhs[])
+  {
+    wait();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (state_ == State::cancelled) {
+      lock.unlock();
+      mexErrMsgTxt("the job was cancelled");
+      return;
+    }
+    if (state_ == State::failed) {
+      auto error = "the job failed: " + error_;
+      lock.unlock();
+      mexErrMsgTxt(error.c_str());
+      return;
+    }
+    if (retrieved_) {
+      lock.unlock();
+      mexErrMsgTxt("the result of the job has already been retrieved");
+      return;
+    }
+    retrieved_ = true;
+    auto marshal = std::move(marshal_);
+    lock.unlock();
+    marshal(nlhs, plhs);
+  }
+
+  AsyncExecutor& AsyncExecutor::instance()
+  {
+    static AsyncExecutor executor;
+    return executor;
+  }
+
+  AsyncExecutor::AsyncExecutor() : stop_(false)
+  {
+  }
+
+  AsyncExecutor::~AsyncExecutor()
+  {
+    shutdown();
+  }
+
+  void AsyncExecutor::submit(std::shared_ptr<AsyncJob> job)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!worker_.joinable()) {
+      stop_ = false;
+      worker_ = std::thread([this]() { loop(); });
+    }
+    queue_.push_back(std::move(job));
+    condition_.notify_one();
+  }
+
+  void AsyncExecutor::shutdown()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& job : queue_) {
+        job->cancel();
+      }
+      queue_.clear();
+      if (current_) {
+        current_->cancel();
+      }
+      stop_ = true;
+      condition_.notify_all();
+    }
+    if (worker_.joinable()) {
+      worker_.join();
+    }
+  }
+
+  void AsyncExecutor::loop()
+  {
+    while (true) {
+      std::shared_ptr<AsyncJob> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (stop_) {
+          return;
+        }
+        job = std::move(queue_.front());
+        queue_.pop_front();
+        current_ = job;
+      }
+      job->run();
+      std::lock_guard<std::mutex> lock(mutex_);
+      current_.reset();
+    }
+  }
+}
@@ -0,0 +1,118 @@
+#ifndef DUNEURO_MATLAB_ASYNC_HH
+#define DUNEURO_MATLAB_ASYNC_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <mex.h>
+
+namespace duneuro
+{
+  /**
+   * \brief a command executed on the background worker of the mex module
+   *
+   * The work function runs on the worker thread and must not use the mex api. It returns a
+   * function marshalling the result into matlab arrays, which is called on the matlab thread when
+   * the result is retrieved. All inputs have to be owned by the work function or kept alive by the
+   * caller until the job is done.
+   */
+  class AsyncJob
+  {
+  public:
+    using Marshal = std::function<void(int nlhs, mxArray* plhs[])>;
+    using Work = std::function<Marshal(const AsyncJob&)>;
+
+    enum class State { pending, running, finished, failed, cancelled };
+
+    explicit AsyncJob(Work work);
+
+    State state() const;
+
+    /** \brief name of the current state as returned to matlab */
+    std::string state_name() const;
+
+    /**
+     * \brief request cancellation
+     *
+     * pending jobs will not be started. Running jobs stop at their next checkpoint, if they provide
+     * one, otherwise their result is discarded.
+     */
+    void cancel();
+
+    /** \brief throw if cancellation was requested. To be called by the work function */
+    void checkpoint() const;
+
+    /** \brief block until the job is finished, failed or cancelled */
+    void wait() const;
+
+    /** \brief execute the work function. Called by the executor */
+    void run();
+
+    /**
+     * \brief marshal the result into the output arguments
+     *
+     * has to be called on the matlab thread after wait. Reports errors of the job through
+     * mexErrMsgTxt. The result can only be retrieved once.
+     */
+    void retrieve(int nlhs, mxArray* plhs[]);
+
+  private:
+    Work work_;
+    Marshal marshal_;
+    std::string error_;
+    State state_;
+    bool retrieved_;
+    std::atomic<bool> cancelRequested_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable finished_;
+  };
+
+  /** \brief the object behind a future handle passed to matlab */
+  struct AsyncFuture {
+    std::shared_ptr<AsyncJob> job;
+  };
+
+  /**
+   * \brief single background worker executing jobs in submission order
+   *
+   * Jobs are executed one after another, so that jobs on the same driver do not interfere. Each
+   * job may use several threads internally.
+   */
+  class AsyncExecutor
+  {
+  public:
+    static AsyncExecutor& instance();
+
+    ~AsyncExecutor();
+
+    /** \brief queue a job, starting the worker thread if necessary */
+    void submit(std::shared_ptr<AsyncJob> job);
+
+    /**
+     * \brief cancel all jobs and wait for the running one to stop
+     *
+     * the running job stops at its next checkpoint, or when its work function returns.
+     */
+    void shutdown();
+
+  private:
+    AsyncExecutor();
+
+    void loop();
+
+    std::deque<std::shared_ptr<AsyncJob>> queue_;
+    std::shared_ptr<AsyncJob> current_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread worker_;
+    bool stop_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_ASYNC_HH
@@ -4,15 +4,183 @@
 
 #include <duneuro/matlab/command_handler.hh>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <type_traits>
+
+#include <dune/common/exceptions.hh>
+
 #include <duneuro/common/fitted_driver_data.hh>
 #include <duneuro/driver/driver_factory.hh>
 #include <duneuro/io/volume_conductor_vtk_writer.hh>
 #include <duneuro/io/point_vtk_writer.hh>
 
+#include <duneuro/matlab/array_file.hh>
+#include <duneuro/matlab/async.hh>
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/driver_cache.hh>
+#include <duneuro/matlab/handle_registry.hh>
+#include <duneuro/matlab/mesh_file.hh>
+#include <duneuro/matlab/parallel.hh>
+#include <duneuro/matlab/point_vtu_writer.hh>
+#include <duneuro/matlab/server_client.hh>
+#include <duneuro/matlab/snapshot.hh>
+#include <duneuro/matlab/transfer_matrix.hh>
+#include <duneuro/matlab/transfer_matrix_store.hh>
 #include <duneuro/matlab/utilities.hh>
+#include <duneuro/matlab/vtu_series_writer.hh>
 
 namespace duneuro
 {
+  namespace
+  {
+    /** hand out a reference to a driver of the DriverCache, which is released with the handle */
+    mxArray* make_driver_handle(DriverInterface<3>* driver)
+    {
+      return make_handle(HandleType::driver, driver, [](void* ptr) {
+        DriverCache::instance().release(static_cast<DriverInterface<3>*>(ptr));
+      });
+    }
+
+    // number of threads the mesh of a driver config is validated and converted on
+    unsigned int ingestion_threads(const Dune::ParameterTree& config)
+    {
+      return config.get<unsigned int>("ingestion.threads", default_number_of_threads());
+    }
+
+    // digest of the struct a driver is created from. A mesh file is identified by its identity
+    // instead of its content, see digest_file_identity
+    ContentDigest driver_digest(const mxArray* str, const std::string& meshFile,
+                                const Dune::ParameterTree& config)
+    {
+      ScopedPhase phase("driver_digest");
+      ContentHasher hasher;
+      digest_matlab_array(hasher, str, ingestion_threads(config));
+      if (!meshFile.empty()) {
+        digest_file_identity(hasher, meshFile);
+      }
+      return hasher.finish();
+    }
+
+    // the digest is a pass over the whole mesh, so it is only computed if the driver is shared
+    // or its transfer matrices are stored, see compute_or_load_transfer_matrix
+    ContentDigest driver_digest_if_needed(const mxArray* str, const std::string& meshFile,
+                                          const Dune::ParameterTree& config)
+    {
+      if (config.get<bool>("driver_cache.enable", false)
+          || config.get<bool>("driver_cache.digest", false)) {
+        return driver_digest(str, meshFile, config);
+      }
+      return ContentDigest();
+    }
+
+    // the mesh of the struct a driver is created from, read from the mesh file if one is given
+    void extract_driver_mesh(const mxArray* str, const std::string& meshFile,
+                             FittedDriverData<3>& data, unsigned int threads)
+    {
+      if (meshFile.empty()) {
+        extract_fitted_driver_data_from_struct(str, data, threads);
+      } else {
+        read_mesh_file(meshFile, data, threads);
+      }
+    }
+
+    /**
+     * compute a transfer matrix into a matlab (nodes x sensors) matrix, or return a handle to it
+     * if it was mapped from a transfer matrix store
+     */
+    template <class T>
+    mxArray* compute_transfer_matrix_to_matlab(DriverInterface<3>* driver,
+                                               const Dune::ParameterTree& config,
+                                               TransferMatrixStore::Type type)
+    {
+      mxArray* out = nullptr;
+      try {
+        auto mapped = compute_or_load_transfer_matrix<T>(
+            driver, config, type, [&](std::size_t nodes, std::size_t sensors) {
+              out = mxCreateUninitNumericMatrix(
+                  nodes, sensors, std::is_same<T, float>::value ? mxSINGLE_CLASS : mxDOUBLE_CLASS,
+                  mxREAL);
+              return static_cast<T*>(mxGetData(out));
+            });
+        if (mapped) {
+          return make_handle(std::move(mapped));
+        }
+      } catch (...) {
+        if (out) {
+          mxDestroyArray(out);
+        }
+        throw;
+      }
+      return out;
+    }
+
+    mxArray* compute_transfer_matrix_to_matlab(DriverInterface<3>* driver,
+                                               const Dune::ParameterTree& config,
+                                               TransferMatrixStore::Type type)
+    {
+      return single_precision(config)
+                 ? compute_transfer_matrix_to_matlab<float>(driver, config, type)
+                 : compute_transfer_matrix_to_matlab<double>(driver, config, type);
+    }
+
+    /**
+     * extract a transfer matrix given either as a double or single matrix or as a handle to a
+     * mapped transfer matrix. Single matrices are widened, see widen_transfer_matrix.
+     */
+    std::unique_ptr<const DenseMatrix<double>>
+    extract_transfer_matrix(DriverInterface<3>* driver, TransferMatrixStore::Type type,
+                            const mxArray* arr, const Dune::ParameterTree& config)
+    {
+      if (mxIsSingle(arr)) {
+        const SingleTransferMatrix single{static_cast<const float*>(mxGetData(arr)), mxGetN(arr),
+                                          mxGetM(arr)};
+        return widen_transfer_matrix(driver, type, single, config);
+      }
+      if (mxIsUint64(arr) && mxGetNumberOfElements(arr) == 1) {
+        return extract_handle<MappedTransferMatrix>(arr)->view();
+      }
+      // the const cast below is a work around to fulfill the dense matrix interface.
+      return extract_dense_matrix(const_cast<mxArray*>(arr));
+    }
+
+    /**
+     * apply a transfer matrix, given as double or single matrix or as mapped transfer matrix, to
+     * the dipoles given as a 6xN matlab matrix, or to the three unit dipoles of each position of
+     * a 3xN matlab matrix if positions is set, writing into a newly created (sensors x columns)
+     * matlab matrix
+     */
+    mxArray* apply_transfer_to_matlab(DriverInterface<3>* driver, TransferMatrixStore::Type type,
+                                      const mxArray* matrix, const mxArray* dipoles,
+                                      bool positions, const Dune::ParameterTree& config,
+                                      const TransferApplication& apply)
+    {
+      if (!mxIsDouble(dipoles) || mxGetM(dipoles) != (positions ? 3 : 6)) {
+        mexErrMsgTxt(positions ? "expected 3xN double matrix for positions"
+                               : "expected 6xN double matrix for dipoles");
+        return nullptr;
+      }
+      const TransferInput input{mxGetPr(dipoles), mxGetN(dipoles), positions};
+      auto tm = extract_transfer_matrix(driver, type, matrix, config);
+      mxArray* out =
+          mxCreateUninitNumericMatrix(tm->rows(), input.columns(), mxDOUBLE_CLASS, mxREAL);
+      try {
+        apply_transfer_blocked(*tm, input, config, mxGetPr(out), apply);
+      } catch (...) {
+        mxDestroyArray(out);
+        throw;
+      }
+      return out;
+    }
+  }
+
   void CommandHandler::create_driver(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
   {
     if (nlhs != 1) {
@@ -22,13 +190,82 @@ namespace duneuro
     if (nrhs != 1) {
       mexErrMsgTxt("one input required");
     }
-    duneuro::MEEGDriverData<3> data;
-    extract_fitted_driver_data_from_struct(prhs[0], data.fittedData);
-    plhs[0] = convert_ptr_to_mat(
-        DriverFactory<3>::make_driver(matlab_struct_to_parametertree(prhs[0]), data)
-            .release());
-    // note: mexLock has a lock count, call mexUnlock each time a driver is destroyed
-    mexLock();
+    auto config = matlab_struct_to_parametertree(prhs[0]);
+    const auto meshFile = extract_mesh_filename(prhs[0]);
+    // drivers are only shared if explicitly requested, as their sessions take turns on the driver
+    bool share = config.get<bool>("driver_cache.enable", false);
+    const auto digest = driver_digest_if_needed(prhs[0], meshFile, config);
+    auto* driver = DriverCache::instance().acquire(digest, share, [&]() {
+      duneuro::MEEGDriverData<3> data;
+      extract_driver_mesh(prhs[0], meshFile, data.fittedData, ingestion_threads(config));
+      return DriverFactory<3>::make_driver(config, data);
+    });
+    plhs[0] = make_driver_handle(driver);
+  }
+
+  void CommandHandler::save_snapshot(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nrhs != 3 || nlhs != 0) {
+      mexErrMsgTxt("please provide a handle to the object, the struct it was created from and a "
+                   "filename");
+      return;
+    }
+    if (!mxIsChar(prhs[2])) {
+      mexErrMsgTxt("expected the filename as char array");
+      return;
+    }
+    auto* driver = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(driver);
+    auto& cache = DriverCache::instance();
+    DriverSnapshot snapshot;
+    const auto meshFile = extract_mesh_filename(prhs[1]);
+    snapshot.config = matlab_struct_to_parametertree(prhs[1]);
+    // the snapshot always carries the digest, so that restored drivers can be shared. It can only
+    // be checked against drivers which were created with a digest
+    snapshot.digest = driver_digest(prhs[1], meshFile, snapshot.config);
+    const auto driverDigest = cache.digest(driver);
+    if (!driverDigest.empty() && snapshot.digest != driverDigest) {
+      mexErrMsgTxt("the struct does not match the one the driver was created from");
+      return;
+    }
+    extract_driver_mesh(prhs[1], meshFile, snapshot.mesh, ingestion_threads(snapshot.config));
+    snapshot.electrodes = cache.electrodes(driver);
+    snapshot.coils = cache.coils(driver);
+    write_snapshot(extract_string(prhs[2]), snapshot);
+  }
+
+  void CommandHandler::load_snapshot(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nrhs != 1 || nlhs != 1) {
+      mexErrMsgTxt("please provide a filename, the method returns a handle");
+      return;
+    }
+    if (!mxIsChar(prhs[0])) {
+      mexErrMsgTxt("expected the filename as char array");
+      return;
+    }
+    auto snapshot = read_snapshot(extract_string(prhs[0]));
+    auto& cache = DriverCache::instance();
+    bool share = snapshot.config.get<bool>("driver_cache.enable", false);
+    auto* driver = cache.acquire(snapshot.digest, share, [&]() {
+      duneuro::MEEGDriverData<3> data;
+      data.fittedData = std::move(snapshot.mesh);
+      return DriverFactory<3>::make_driver(snapshot.config, data);
+    });
+    try {
+      auto lock = cache.lock(driver);
+      // every session of a shared driver records its own sensors
+      if (!snapshot.electrodes.positions.empty()) {
+        cache.set_electrodes(driver, std::move(snapshot.electrodes));
+      }
+      if (!snapshot.coils.positions.empty()) {
+        cache.set_coils(driver, std::move(snapshot.coils));
+      }
+    } catch (...) {
+      cache.release(driver);
+      throw;
+    }
+    plhs[0] = make_driver_handle(driver);
   }
 
   void CommandHandler::make_domain_function(int nlhs, mxArray* plhs[], int nrhs,
@@ -37,10 +274,9 @@ namespace duneuro
     if (nrhs != 1) {
       mexErrMsgTxt("one input required");
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    plhs[0] = convert_ptr_to_mat(foo->makeDomainFunction().release());
-    // note: mexLock has a lock count, call mexUnlock each time a function is destroyed
-    mexLock();
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    plhs[0] = make_handle(foo->makeDomainFunction());
   }
 
   void CommandHandler::delete_function(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -49,9 +285,7 @@ namespace duneuro
       mexErrMsgTxt("please provide a function handle");
       return;
     }
-    auto* foo = convert_mat_to_ptr<Function>(prhs[0]);
-    delete foo;
-    mexUnlock();
+    release_handle(prhs[0], HandleType::function);
   }
 
   void CommandHandler::solve_eeg_forward(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -66,10 +300,58 @@ namespace duneuro
       mexErrMsgTxt("the method does not return variables");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    auto* solution = convert_mat_to_ptr<Function>(prhs[2]);
-    foo->solveEEGForward(extract_dipole(prhs[1]), *solution,
-                         matlab_struct_to_parametertree(prhs[3]));
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    auto* solution = extract_handle<Function>(prhs[2]);
+    Dune::ParameterTree storage;
+    foo->solveEEGForward(extract_dipole(prhs[1]), *solution, extract_config(prhs[3], storage));
+  }
+
+  void CommandHandler::solve_eeg_forward_batch(int nlhs, mxArray* plhs[], int nrhs,
+                                               const mxArray* prhs[])
+  {
+    if (nrhs < 3) {
+      mexErrMsgTxt("please provide a handle to the object, the dipoles and a configuration struct");
+      return;
+    }
+    if (nlhs != 1) {
+      mexErrMsgTxt("the method returns a matrix");
+      return;
+    }
+    if (!mxIsDouble(prhs[1]) || mxGetM(prhs[1]) != 6) {
+      mexErrMsgTxt("expected 6xN double matrix for dipoles");
+      return;
+    }
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    const std::size_t electrodes = DriverCache::instance().electrodes(foo).positions.size();
+    if (electrodes == 0) {
+      mexErrMsgTxt("please set the electrodes before solving for potentials");
+      return;
+    }
+    Dune::ParameterTree storage;
+    const auto& config = extract_config(prhs[2], storage);
+    const std::size_t ndipoles = mxGetN(prhs[1]);
+    const double* dipolePtr = mxGetPr(prhs[1]);
+    plhs[0] = mxCreateUninitNumericMatrix(electrodes, ndipoles, mxDOUBLE_CLASS, mxREAL);
+    double* outPtr = mxGetPr(plhs[0]);
+    // the solves share the driver, which does not support concurrent solves
+    if (config.get<unsigned int>("batch.threads", 1) > 1) {
+      mexErrMsgTxt("batch.threads > 1 is not supported, the solves of a driver run one at a time");
+      return;
+    }
+    // TODO: solving all dipoles with one assembled system and preconditioner needs a batch solve
+    // in the duneuro drivers
+    auto solution = foo->makeDomainFunction();
+    auto dipoles = make_dipoles(dipolePtr, ndipoles);
+    for (std::size_t i = 0; i < ndipoles; ++i) {
+      foo->solveEEGForward(dipoles[i], *solution, config);
+      auto ae = foo->evaluateAtElectrodes(*solution);
+      if (ae.size() != electrodes) {
+        DUNE_THROW(Dune::Exception, "unexpected number of electrode potentials");
+      }
+      std::copy(ae.begin(), ae.end(), outPtr + i * electrodes);
+    }
   }
 
   void CommandHandler::solve_meg_forward(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -84,9 +366,11 @@ namespace duneuro
       mexErrMsgTxt("the method returns a matrix");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    auto* sol = convert_mat_to_ptr<Function>(prhs[1]);
-    auto ae = foo->solveMEGForward(*sol, matlab_struct_to_parametertree(prhs[2]));
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    auto* sol = extract_handle<Function>(prhs[1]);
+    Dune::ParameterTree storage;
+    auto ae = foo->solveMEGForward(*sol, extract_config(prhs[2], storage));
     plhs[0] = mxCreateDoubleMatrix(ae.size(), 1, mxREAL);
     std::copy(ae.begin(), ae.end(), mxGetPr(plhs[0]));
   }
@@ -102,10 +386,11 @@ namespace duneuro
       mexErrMsgTxt("the method returns a matrix");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    auto tm = foo->computeEEGTransferMatrix(matlab_struct_to_parametertree(prhs[1]));
-    plhs[0] = mxCreateDoubleMatrix(tm->cols(), tm->rows(), mxREAL);
-    std::copy(tm->data(), tm->data() + tm->rows() * tm->cols(), mxGetPr(plhs[0]));
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    Dune::ParameterTree storage;
+    const auto& config = extract_config(prhs[1], storage);
+    plhs[0] = compute_transfer_matrix_to_matlab(foo, config, TransferMatrixStore::Type::eeg);
   }
 
   void CommandHandler::compute_meg_transfer_matrix(int nlhs, mxArray* plhs[], int nrhs,
@@ -119,10 +404,11 @@ namespace duneuro
       mexErrMsgTxt("the method returns a matrix");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    auto tm = foo->computeMEGTransferMatrix(matlab_struct_to_parametertree(prhs[1]));
-    plhs[0] = mxCreateDoubleMatrix(tm->cols(), tm->rows(), mxREAL);
-    std::copy(tm->data(), tm->data() + tm->rows() * tm->cols(), mxGetPr(plhs[0]));
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    Dune::ParameterTree storage;
+    const auto& config = extract_config(prhs[1], storage);
+    plhs[0] = compute_transfer_matrix_to_matlab(foo, config, TransferMatrixStore::Type::meg);
   }
 
   void CommandHandler::apply_eeg_transfer(int nlhs, mxArray* plhs[], int nrhs,
@@ -138,17 +424,15 @@ namespace duneuro
       mexErrMsgTxt("the method returns a matrix");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    // the const cast below is a work around to fulfill the dense matrix interface.
-    auto tm = extract_dense_matrix(const_cast<mxArray*>(prhs[1]));
-    auto ae = foo->applyEEGTransfer(*tm, extract_dipoles(prhs[2]),
-                                    matlab_struct_to_parametertree(prhs[3]));
-    plhs[0] = mxCreateDoubleMatrix(tm->rows(), ae.size(), mxREAL);
-    auto pr = mxGetPr(plhs[0]);
-    for (const auto& a : ae) {
-      std::copy(a.begin(), a.end(), pr);
-      pr += a.size();
-    }
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    Dune::ParameterTree storage;
+    const auto& config = extract_config(prhs[3], storage);
+    plhs[0] = apply_transfer_to_matlab(
+        foo, TransferMatrixStore::Type::eeg, prhs[1], prhs[2], false, config,
+        [&](const DenseMatrix<double>& tm, const std::vector<Dipole<double, 3>>& dipoles) {
+          return foo->applyEEGTransfer(tm, dipoles, config);
+        });
   }
 
   void CommandHandler::apply_meg_transfer(int nlhs, mxArray* plhs[], int nrhs,
@@ -164,17 +448,94 @@ namespace duneuro
       mexErrMsgTxt("the method returns a matrix");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    // the const cast below is a work around to fulfill the dense matrix interface.
-    auto tm = extract_dense_matrix(const_cast<mxArray*>(prhs[1]));
-    auto ae = foo->applyMEGTransfer(*tm, extract_dipoles(prhs[2]),
-                                    matlab_struct_to_parametertree(prhs[3]));
-    plhs[0] = mxCreateDoubleMatrix(tm->rows(), ae.size(), mxREAL);
-    auto pr = mxGetPr(plhs[0]);
-    for (const auto& a : ae) {
-      std::copy(a.begin(), a.end(), pr);
-      pr += a.size();
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    Dune::ParameterTree storage;
+    const auto& config = extract_config(prhs[3], storage);
+    plhs[0] = apply_transfer_to_matlab(
+        foo, TransferMatrixStore::Type::meg, prhs[1], prhs[2], false, config,
+        [&](const DenseMatrix<double>& tm, const std::vector<Dipole<double, 3>>& dipoles) {
+          return foo->applyMEGTransfer(tm, dipoles, config);
+        });
+  }
+
+  void CommandHandler::apply_meeg_transfer(int nlhs, mxArray* plhs[], int nrhs,
+                                           const mxArray* prhs[])
+  {
+    if (nrhs < 5) {
+      mexErrMsgTxt(
+          "please provide a handle to the object, the eeg and the meg transfer matrix, the dipoles "
+          "and a configuration struct");
+      return;
+    }
+    if (nlhs != 2) {
+      mexErrMsgTxt("the method returns two matrices");
+      return;
+    }
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    Dune::ParameterTree storage;
+    const auto& config = extract_config(prhs[4], storage);
+    TransferApplication applyEEG = [&](const DenseMatrix<double>& tm,
+                                       const std::vector<Dipole<double, 3>>& dipoles) {
+      return foo->applyEEGTransfer(tm, dipoles, config);
+    };
+    TransferApplication applyMEG = [&](const DenseMatrix<double>& tm,
+                                       const std::vector<Dipole<double, 3>>& dipoles) {
+      return foo->applyMEGTransfer(tm, dipoles, config);
+    };
+    if (!mxIsDouble(prhs[3]) || mxGetM(prhs[3]) != 6) {
+      mexErrMsgTxt("expected 6xN double matrix for dipoles");
+      return;
+    }
+    const TransferInput input{mxGetPr(prhs[3]), mxGetN(prhs[3]), false};
+    auto eegTm = extract_transfer_matrix(foo, TransferMatrixStore::Type::eeg, prhs[1], config);
+    auto megTm = extract_transfer_matrix(foo, TransferMatrixStore::Type::meg, prhs[2], config);
+    mxArray* eeg = mxCreateUninitNumericMatrix(eegTm->rows(), input.count, mxDOUBLE_CLASS, mxREAL);
+    mxArray* meg = mxCreateUninitNumericMatrix(megTm->rows(), input.count, mxDOUBLE_CLASS, mxREAL);
+    try {
+      apply_meeg_transfer_blocked(*eegTm, *megTm, input, config, mxGetPr(eeg), mxGetPr(meg),
+                                  applyEEG, applyMEG);
+    } catch (...) {
+      mxDestroyArray(eeg);
+      mxDestroyArray(meg);
+      throw;
+    }
+    plhs[0] = eeg;
+    plhs[1] = meg;
+  }
+
+  void CommandHandler::compute_leadfield(int nlhs, mxArray* plhs[], int nrhs,
+                                         const mxArray* prhs[])
+  {
+    if (nrhs < 4) {
+      mexErrMsgTxt(
+          "please provide a handle to the object, the transfer matrix, the positions and a "
+          "configuration struct");
+      return;
+    }
+    if (nlhs != 1) {
+      mexErrMsgTxt("the method returns a matrix");
+      return;
+    }
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    Dune::ParameterTree storage;
+    const auto& config = extract_config(prhs[3], storage);
+    const auto modality = config.get<std::string>("modality", "eeg");
+    if (modality != "eeg" && modality != "meg") {
+      mexErrMsgTxt("unknown modality, expected eeg or meg");
+      return;
     }
+    const auto type =
+        modality == "eeg" ? TransferMatrixStore::Type::eeg : TransferMatrixStore::Type::meg;
+    plhs[0] = apply_transfer_to_matlab(
+        foo, type, prhs[1], prhs[2], true, config,
+        [&](const DenseMatrix<double>& tm, const std::vector<Dipole<double, 3>>& dipoles) {
+          return type == TransferMatrixStore::Type::eeg
+                     ? foo->applyEEGTransfer(tm, dipoles, config)
+                     : foo->applyMEGTransfer(tm, dipoles, config);
+        });
   }
 
   void CommandHandler::get_projected_electrodes(int nlhs, mxArray* plhs[], int nrhs,
@@ -188,7 +549,8 @@ namespace duneuro
       mexErrMsgTxt("the method returns a matrix");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
     auto electrodes = foo->getProjectedElectrodes();
     plhs[0] = mxCreateDoubleMatrix(3, electrodes.size(), mxREAL);
     auto* pr = mxGetPr(plhs[0]);
@@ -208,8 +570,16 @@ namespace duneuro
       mexErrMsgTxt("the method does not return variables");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    foo->setElectrodes(extract_field_vectors(prhs[1]), matlab_struct_to_parametertree(prhs[2]));
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    DriverCache::Electrodes electrodes;
+    electrodes.positions = extract_field_vectors(prhs[1]);
+    electrodes.config = matlab_struct_to_parametertree(prhs[2]);
+    ContentHasher hasher;
+    digest_matlab_array(hasher, prhs[1]);
+    digest_parametertree(hasher, electrodes.config);
+    electrodes.digest = hasher.finish();
+    DriverCache::instance().set_electrodes(foo, std::move(electrodes));
   }
 
   void CommandHandler::set_coils_and_projections(int nlhs, mxArray* plhs[], int nrhs,
@@ -223,8 +593,20 @@ namespace duneuro
       mexErrMsgTxt("the method does not return variables");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    foo->setCoilsAndProjections(extract_field_vectors(prhs[1]), extract_projections(prhs[2]));
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    DriverCache::Coils coils;
+    coils.positions = extract_field_vectors(prhs[1]);
+    coils.projections = extract_projections(prhs[2], coils.projectionsPerCoil);
+    if (mxGetN(prhs[2]) != coils.positions.size()) {
+      mexErrMsgTxt("expected one column of projections per coil");
+      return;
+    }
+    ContentHasher hasher;
+    digest_matlab_array(hasher, prhs[1]);
+    digest_matlab_array(hasher, prhs[2]);
+    coils.digest = hasher.finish();
+    DriverCache::instance().set_coils(foo, std::move(coils));
   }
 
   void CommandHandler::evaluate_at_electrodes(int nlhs, mxArray* plhs[], int nrhs,
@@ -238,13 +620,54 @@ namespace duneuro
       mexErrMsgTxt("the method returns a matrix");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    auto* sol = convert_mat_to_ptr<Function>(prhs[1]);
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    auto* sol = extract_handle<Function>(prhs[1]);
     auto ae = foo->evaluateAtElectrodes(*sol);
     plhs[0] = mxCreateDoubleMatrix(ae.size(), 1, mxREAL);
     std::copy(ae.begin(), ae.end(), mxGetPr(plhs[0]));
   }
 
+  void CommandHandler::evaluate_at_electrodes_batch(int nlhs, mxArray* plhs[], int nrhs,
+                                                    const mxArray* prhs[])
+  {
+    if (nrhs < 2) {
+      mexErrMsgTxt("please provide a handle to the object and an array of function handles");
+      return;
+    }
+    if (nlhs != 1) {
+      mexErrMsgTxt("the method returns a matrix");
+      return;
+    }
+    auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(foo);
+    const auto functions = extract_handles<Function>(prhs[1]);
+    Dune::ParameterTree storage;
+    const auto& config = nrhs > 2 ? extract_config(prhs[2], storage) : storage;
+    const std::size_t electrodes = DriverCache::instance().electrodes(foo).positions.size();
+    mxArray* out =
+        mxCreateUninitNumericMatrix(electrodes, functions.size(), mxDOUBLE_CLASS, mxREAL);
+    try {
+      double* pr = mxGetPr(out);
+      parallel_for_blocks(functions.size(), 1,
+                          config.get<unsigned int>("threads", 1),
+                          [&](std::size_t begin, std::size_t end) {
+                            for (std::size_t i = begin; i < end; ++i) {
+                              auto ae = foo->evaluateAtElectrodes(*functions[i]);
+                              if (ae.size() != electrodes) {
+                                DUNE_THROW(Dune::Exception,
+                                           "unexpected number of electrode values");
+                              }
+                              std::copy(ae.begin(), ae.end(), pr + i * electrodes);
+                            }
+                          });
+    } catch (...) {
+      mxDestroyArray(out);
+      throw;
+    }
+    plhs[0] = out;
+  }
+
   void CommandHandler::print_citations(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
   {
     if (nlhs != 0) {
@@ -252,7 +675,8 @@ namespace duneuro
       return;
     }
     if (nrhs == 1) {
-        auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
+        auto* foo = extract_handle<DriverInterface<3>>(prhs[0]);
+        auto lock = DriverCache::instance().lock(foo);
         foo->print_citations();
     }
     else {
@@ -266,9 +690,30 @@ namespace duneuro
       mexErrMsgTxt("please provide a handle to the object");
       return;
     }
-    auto* foo = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
-    delete foo;
-    mexUnlock();
+    release_handle(prhs[0], HandleType::driver);
+  }
+
+  void CommandHandler::delete_transfer_matrix(int nlhs, mxArray* plhs[], int nrhs,
+                                              const mxArray* prhs[])
+  {
+    if (nrhs != 1 || nlhs != 0) {
+      mexErrMsgTxt("please provide a handle to a mapped transfer matrix");
+      return;
+    }
+    release_handle(prhs[0], HandleType::transfer_matrix);
+  }
+
+  void CommandHandler::transfer_matrix_size(int nlhs, mxArray* plhs[], int nrhs,
+                                            const mxArray* prhs[])
+  {
+    if (nrhs != 1 || nlhs != 1) {
+      mexErrMsgTxt("please provide a handle to a mapped transfer matrix");
+      return;
+    }
+    auto* matrix = extract_handle<MappedTransferMatrix>(prhs[0]);
+    plhs[0] = mxCreateDoubleMatrix(1, 2, mxREAL);
+    mxGetPr(plhs[0])[0] = matrix->cols();
+    mxGetPr(plhs[0])[1] = matrix->rows();
   }
 
   /**********************************************
@@ -285,10 +730,10 @@ namespace duneuro
       return;
     }
     
-    auto* driver_ptr = convert_mat_to_ptr<DriverInterface<3>>(prhs[0]);
+    auto* driver_ptr = extract_handle<DriverInterface<3>>(prhs[0]);
+    auto lock = DriverCache::instance().lock(driver_ptr);
     std::unique_ptr<VolumeConductorVTKWriterInterface> writer_ptr = driver_ptr->volumeConductorVTKWriter(matlab_struct_to_parametertree(prhs[1]));
-    plhs[0] = convert_ptr_to_mat(writer_ptr.release());
-    mexLock();
+    plhs[0] = make_handle(std::move(writer_ptr));
   }
   
   void CommandHandler::volume_writer_add_vertex_data(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -306,9 +751,9 @@ namespace duneuro
       return;
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<VolumeConductorVTKWriterInterface>(prhs[0]);
-    auto* function_ptr = convert_mat_to_ptr<Function>(prhs[1]);
-    writer_ptr->addVertexData(*function_ptr, std::string(mxArrayToString(prhs[2])));
+    auto* writer_ptr = extract_handle<VolumeConductorVTKWriterInterface>(prhs[0]);
+    auto* function_ptr = extract_handle<Function>(prhs[1]);
+    writer_ptr->addVertexData(*function_ptr, extract_string(prhs[2]));
   }
   
   void CommandHandler::volume_writer_add_vertex_data_gradient(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -326,9 +771,9 @@ namespace duneuro
       return;
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<VolumeConductorVTKWriterInterface>(prhs[0]);
-    auto* function_ptr = convert_mat_to_ptr<Function>(prhs[1]);
-    writer_ptr->addVertexDataGradient(*function_ptr, std::string(mxArrayToString(prhs[2])));
+    auto* writer_ptr = extract_handle<VolumeConductorVTKWriterInterface>(prhs[0]);
+    auto* function_ptr = extract_handle<Function>(prhs[1]);
+    writer_ptr->addVertexDataGradient(*function_ptr, extract_string(prhs[2]));
   }
   
   void CommandHandler::volume_writer_add_cell_data(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -346,9 +791,9 @@ namespace duneuro
       return;
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<VolumeConductorVTKWriterInterface>(prhs[0]);
-    auto* function_ptr = convert_mat_to_ptr<Function>(prhs[1]);
-    writer_ptr->addCellData(*function_ptr, std::string(mxArrayToString(prhs[2])));
+    auto* writer_ptr = extract_handle<VolumeConductorVTKWriterInterface>(prhs[0]);
+    auto* function_ptr = extract_handle<Function>(prhs[1]);
+    writer_ptr->addCellData(*function_ptr, extract_string(prhs[2]));
   }
   
   void CommandHandler::volume_writer_add_cell_data_gradient(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -366,9 +811,9 @@ namespace duneuro
       return;
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<VolumeConductorVTKWriterInterface>(prhs[0]);
-    auto* function_ptr = convert_mat_to_ptr<Function>(prhs[1]);
-    writer_ptr->addCellDataGradient(*function_ptr, std::string(mxArrayToString(prhs[2])));
+    auto* writer_ptr = extract_handle<VolumeConductorVTKWriterInterface>(prhs[0]);
+    auto* function_ptr = extract_handle<Function>(prhs[1]);
+    writer_ptr->addCellDataGradient(*function_ptr, extract_string(prhs[2]));
   }
   
   void CommandHandler::volume_writer_write(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -382,7 +827,7 @@ namespace duneuro
       return;
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<VolumeConductorVTKWriterInterface>(prhs[0]);
+    auto* writer_ptr = extract_handle<VolumeConductorVTKWriterInterface>(prhs[0]);
     writer_ptr->write(matlab_struct_to_parametertree(prhs[1]));
   }
   
@@ -393,9 +838,117 @@ namespace duneuro
       return;
     } 
     
-    auto* writer_ptr = convert_mat_to_ptr<VolumeConductorVTKWriterInterface>(prhs[0]);
-    delete writer_ptr;
-    mexUnlock();
+    release_handle(prhs[0], HandleType::volume_writer);
+  }
+
+  namespace
+  {
+    /**
+     * add the columns of a (vertices or cells x steps) matrix as time steps to a series writer,
+     * or one time step per function of an array of function handles
+     */
+    void add_series_data(int nlhs, int nrhs, const mxArray* prhs[], bool vertexData)
+    {
+      if (nrhs < 3 || nrhs > 4 || nlhs != 0) {
+        mexErrMsgTxt(
+            "please provide the writer, a (entities x steps) data matrix or function handles, a "
+            "name and optionally the time of each step");
+        return;
+      }
+      auto* writer = extract_handle<VTUSeriesWriter>(prhs[0]);
+      const mxArray* data = prhs[1];
+      if (mxGetClassID(data) == mxUINT64_CLASS) {
+        const auto functions = extract_handles<Function>(data);
+        writer->add_function_data(extract_string(prhs[2]),
+                                  std::vector<const Function*>(functions.begin(), functions.end()),
+                                  vertexData,
+                                  nrhs > 3 ? extract_vector(prhs[3]) : std::vector<double>());
+        return;
+      }
+      if (!writer->has_mesh()) {
+        mexErrMsgTxt("arrays are numbered like the nodes of the mesh, please set it first");
+        return;
+      }
+      const std::size_t entries =
+          vertexData ? writer->number_of_vertices() : writer->number_of_cells();
+      if (!mxIsDouble(data) || mxIsComplex(data)) {
+        mexErrMsgTxt("expected real double matrix for the data");
+        return;
+      }
+      // a row vector is a single step
+      const bool row = mxGetM(data) == 1 && mxGetN(data) == entries;
+      if (mxGetM(data) != entries && !row) {
+        std::stringstream sstr;
+        sstr << "expected " << entries << (vertexData ? " vertex" : " cell")
+             << " values per step, got a " << mxGetM(data) << "x" << mxGetN(data) << " matrix";
+        mexErrMsgTxt(sstr.str().c_str());
+        return;
+      }
+      const std::size_t steps = row ? 1 : mxGetN(data);
+      const auto name = extract_string(prhs[2]);
+      const auto times = nrhs > 3 ? extract_vector(prhs[3]) : std::vector<double>();
+      if (vertexData) {
+        writer->add_vertex_data(name, mxGetPr(data), steps, times);
+      } else {
+        writer->add_cell_data(name, mxGetPr(data), steps, times);
+      }
+    }
+  }
+
+  void CommandHandler::vtu_series_writer(int nlhs, mxArray* plhs[], int nrhs,
+                                         const mxArray* prhs[])
+  {
+    if (nrhs != 2 || nlhs != 1) {
+      mexErrMsgTxt("please provide a driver or the struct it was created from and a config struct");
+      return;
+    }
+    const auto config = matlab_struct_to_parametertree(prhs[1]);
+    if (!mxIsStruct(prhs[0])) {
+      // functions are written on the grid of the driver, the mesh is only set for arrays
+      plhs[0] = make_handle(
+          std::make_unique<VTUSeriesWriter>(share_handle<DriverInterface<3>>(prhs[0]), config));
+      return;
+    }
+    FittedDriverData<3> mesh;
+    extract_driver_mesh(prhs[0], extract_mesh_filename(prhs[0]), mesh,
+                        config.get<unsigned int>("threads", default_number_of_threads()));
+    plhs[0] = make_handle(std::make_unique<VTUSeriesWriter>(mesh, config));
+  }
+
+  void CommandHandler::series_writer_set_mesh(int nlhs, mxArray* plhs[], int nrhs,
+                                              const mxArray* prhs[])
+  {
+    if (nrhs != 2 || nlhs != 0) {
+      mexErrMsgTxt("please provide the writer and the struct the driver was created from");
+      return;
+    }
+    auto* writer = extract_handle<VTUSeriesWriter>(prhs[0]);
+    FittedDriverData<3> mesh;
+    extract_driver_mesh(prhs[1], extract_mesh_filename(prhs[1]), mesh,
+                        ingestion_threads(matlab_struct_to_parametertree(prhs[1])));
+    writer->set_mesh(mesh);
+  }
+
+  void CommandHandler::series_writer_add_vertex_data(int nlhs, mxArray* plhs[], int nrhs,
+                                                     const mxArray* prhs[])
+  {
+    add_series_data(nlhs, nrhs, prhs, true);
+  }
+
+  void CommandHandler::series_writer_add_cell_data(int nlhs, mxArray* plhs[], int nrhs,
+                                                   const mxArray* prhs[])
+  {
+    add_series_data(nlhs, nrhs, prhs, false);
+  }
+
+  void CommandHandler::series_writer_delete(int nlhs, mxArray* plhs[], int nrhs,
+                                            const mxArray* prhs[])
+  {
+    if (nrhs != 1 || nlhs != 0) {
+      mexErrMsgTxt("wrong number of input or output arguments");
+      return;
+    }
+    release_handle(prhs[0], HandleType::series_writer);
   }
 
   void CommandHandler::point_vtk_writer(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -418,20 +971,19 @@ namespace duneuro
       return;
     }
     
-    PointVTKWriter<double, 3>* point_writer;
+    std::unique_ptr<PointVTKWriter<double, 3>> point_writer;
     
     if(rows == 3) {
       auto points = extract_field_vectors(data);
-      point_writer = new PointVTKWriter<double, 3>(points);
+      point_writer = std::make_unique<PointVTKWriter<double, 3>>(points);
     }
     // dipole case
     else {
       auto dipole = extract_dipole(data);
-      point_writer = new PointVTKWriter<double, 3>(dipole);
+      point_writer = std::make_unique<PointVTKWriter<double, 3>>(dipole);
     }
     
-    plhs[0] = convert_ptr_to_mat(point_writer);
-    mexLock();
+    plhs[0] = make_handle(std::move(point_writer));
   }
 
   void CommandHandler::point_writer_add_scalar_data(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -440,7 +992,7 @@ namespace duneuro
       mexErrMsgTxt("wrong number of input arguments, please provide writer, scalar data array, and output name");
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<PointVTKWriter<double, 3>>(prhs[0]);
+    auto* writer_ptr = extract_handle<PointVTKWriter<double, 3>>(prhs[0]);
     const mxArray* data = prhs[1];
     int rows = mxGetM(data);
     int cols = mxGetN(data);
@@ -453,7 +1005,7 @@ namespace duneuro
       return;
     }
     
-    writer_ptr->addScalarData(std::string(mxArrayToString(prhs[2])), extract_vector(prhs[1]));
+    writer_ptr->addScalarData(extract_string(prhs[2]), extract_vector(prhs[1]));
   }
   
   void CommandHandler::point_writer_add_vector_data(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -462,7 +1014,7 @@ namespace duneuro
       mexErrMsgTxt("wrong number of input arguments (please provide writer, vector data array, and output name)");
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<PointVTKWriter<double, 3>>(prhs[0]);
+    auto* writer_ptr = extract_handle<PointVTKWriter<double, 3>>(prhs[0]);
     const mxArray* data = prhs[1];
     int rows = mxGetM(data);
     int cols = mxGetN(data);
@@ -475,7 +1027,7 @@ namespace duneuro
       return;
     }
     
-    writer_ptr->addVectorData(std::string(mxArrayToString(prhs[2])), extract_field_vectors(prhs[1]));
+    writer_ptr->addVectorData(extract_string(prhs[2]), extract_field_vectors(prhs[1]));
   }
 
   void CommandHandler::point_writer_write(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -489,8 +1041,8 @@ namespace duneuro
       return;
     }
     
-    auto* writer_ptr = convert_mat_to_ptr<PointVTKWriter<double, 3>>(prhs[0]);
-    writer_ptr->write(std::string(mxArrayToString(prhs[1])));
+    auto* writer_ptr = extract_handle<PointVTKWriter<double, 3>>(prhs[0]);
+    writer_ptr->write(extract_string(prhs[1]));
   }
 
   void CommandHandler::point_writer_delete(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
@@ -500,56 +1052,901 @@ namespace duneuro
       return;
     }
     
-    auto* point_writer_ptr = convert_mat_to_ptr<PointVTKWriter<double, 3>>(prhs[0]);
-    delete point_writer_ptr;
-    mexUnlock();
+    release_handle(prhs[0], HandleType::point_writer);
+  }
+
+  namespace
+  {
+    // append the {name, values, ...} pairs of a cell to arrays, referencing the matlab buffers
+    void extract_point_data(const mxArray* cell, std::size_t points, std::size_t components,
+                            std::vector<PointDataArray>& arrays)
+    {
+      if (!mxIsCell(cell) || mxGetNumberOfElements(cell) % 2 != 0) {
+        mexErrMsgTxt("expected point data as cell {name, values, name, values, ...}");
+        return;
+      }
+      for (std::size_t i = 0; i < mxGetNumberOfElements(cell); i += 2) {
+        const mxArray* name = mxGetCell(cell, i);
+        const mxArray* values = mxGetCell(cell, i + 1);
+        if (!name || !mxIsChar(name)) {
+          mexErrMsgTxt("expected the name of the point data as char array");
+          return;
+        }
+        if (!values || !mxIsDouble(values) || mxIsComplex(values)) {
+          mexErrMsgTxt("expected point data as real double array");
+          return;
+        }
+        const std::size_t numel = mxGetNumberOfElements(values);
+        const std::size_t rows = mxGetM(values);
+        // a vector of point values is a single step for any orientation, otherwise the leading
+        // dimensions have to match
+        const bool single = components == 1 && numel == points;
+        const bool matching = components == 1
+                                  ? rows == points
+                                  : rows == 3 && mxGetDimensions(values)[1] == points;
+        if ((!single && !matching) || numel % (components * points) != 0) {
+          std::stringstream sstr;
+          sstr << "point data \"" << extract_string(name) << "\" does not match " << points
+               << " points with " << components << " components";
+          mexErrMsgTxt(sstr.str().c_str());
+          return;
+        }
+        arrays.push_back(
+            {extract_string(name), mxGetPr(values), components, numel / (components * points)});
+      }
+    }
+  }
+
+  void CommandHandler::write_point_vtu(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nrhs < 5 || nrhs > 6 || nlhs != 0) {
+      mexErrMsgTxt("please provide a filename, a 3xN point matrix, scalar and vector data cells, a "
+                   "config struct and optionally the time of each step");
+      return;
+    }
+    if (!mxIsChar(prhs[0])) {
+      mexErrMsgTxt("expected the filename as char array");
+      return;
+    }
+    const mxArray* points = prhs[1];
+    if (!mxIsDouble(points) || mxIsComplex(points) || mxGetM(points) != 3) {
+      mexErrMsgTxt("expected points as real 3xN double matrix");
+      return;
+    }
+    const std::size_t count = mxGetN(points);
+    if (count == 0) {
+      mexErrMsgTxt("expected at least one point");
+      return;
+    }
+    std::vector<PointDataArray> arrays;
+    extract_point_data(prhs[2], count, 1, arrays);
+    extract_point_data(prhs[3], count, 3, arrays);
+    const auto times = nrhs > 5 ? extract_vector(prhs[5]) : std::vector<double>();
+    duneuro::write_point_vtu(extract_string(prhs[0]), mxGetPr(points), count, arrays, times,
+                             matlab_struct_to_parametertree(prhs[4]));
+  }
+
+  /**********************************************
+   * asynchronous execution
+   **********************************************/
+  namespace
+  {
+    // jobs which keep the mex module locked, see submit_async
+    std::vector<std::shared_ptr<AsyncJob>> lockingJobs;
+    std::mutex lockingJobsMutex;
+
+    /** unlock the mex module for every job which has stopped since the last call */
+    void unlock_stopped_jobs()
+    {
+      std::lock_guard<std::mutex> lock(lockingJobsMutex);
+      auto stopped = std::partition(
+          lockingJobs.begin(), lockingJobs.end(), [](const std::shared_ptr<AsyncJob>& job) {
+            const auto state = job->state();
+            return state == AsyncJob::State::pending || state == AsyncJob::State::running;
+          });
+      for (auto it = stopped; it != lockingJobs.end(); ++it) {
+        mexUnlock();
+      }
+      lockingJobs.erase(stopped, lockingJobs.end());
+    }
+
+    /**
+     * queue a job on the background worker and return a future handle for it
+     *
+     * the job owns its inputs, so deleting the future only cancels it without waiting for it to
+     * stop. The mex module stays locked until the job has stopped, so that clearing it never
+     * waits for a running job. The lock is released on the matlab thread by the next command.
+     */
+    mxArray* submit_async(AsyncJob::Work work)
+    {
+      auto job = std::make_shared<AsyncJob>(std::move(work));
+      auto future = std::make_unique<AsyncFuture>(AsyncFuture{job});
+      auto* handle = make_handle(HandleType::future, future.get(), [](void* ptr) {
+        auto* f = static_cast<AsyncFuture*>(ptr);
+        f->job->cancel();
+        delete f;
+      });
+      future.release();
+      {
+        std::lock_guard<std::mutex> lock(lockingJobsMutex);
+        lockingJobs.push_back(job);
+      }
+      mexLock();
+      AsyncExecutor::instance().submit(job);
+      return handle;
+    }
+
+    /**
+     * job computing a transfer matrix with entries of type T
+     *
+     * the matrix computed by the driver is kept until the result is retrieved and then copied
+     * into the matlab array, so that it is copied only once like in the synchronous case.
+     */
+    template <class T>
+    AsyncJob::Work compute_transfer_matrix_job(std::shared_ptr<DriverInterface<3>> foo,
+                                               const Dune::ParameterTree& config,
+                                               TransferMatrixStore::Type type)
+    {
+      return [foo, config, type](const AsyncJob&) -> AsyncJob::Marshal {
+        auto lock = DriverCache::instance().lock(foo.get());
+        auto result = std::make_shared<ComputedTransferMatrix>(
+            compute_or_load_transfer_matrix(foo.get(), config, type));
+        return [result](int nlhs, mxArray* plhs[]) {
+          if (nlhs != 1) {
+            mexErrMsgTxt("the job returns a matrix");
+            return;
+          }
+          if (result->mapped) {
+            plhs[0] = make_handle(std::move(result->stored));
+            return;
+          }
+          plhs[0] = mxCreateUninitNumericMatrix(
+              result->cols(), result->rows(),
+              std::is_same<T, float>::value ? mxSINGLE_CLASS : mxDOUBLE_CLASS, mxREAL);
+          ScopedPhase phase("copy_result", result->rows() * result->cols() * sizeof(T));
+          std::copy(result->data(), result->data() + result->rows() * result->cols(),
+                    static_cast<T*>(mxGetData(plhs[0])));
+        };
+      };
+    }
+
+    void compute_transfer_matrix_async(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[],
+                                       TransferMatrixStore::Type type)
+    {
+      if (nrhs < 2) {
+        mexErrMsgTxt("please provide a handle to the object and a configuration struct");
+        return;
+      }
+      if (nlhs != 1) {
+        mexErrMsgTxt("the method returns a future");
+        return;
+      }
+      auto foo = share_handle<DriverInterface<3>>(prhs[0]);
+      auto config = matlab_struct_to_parametertree(prhs[1]);
+      plhs[0] = submit_async(single_precision(config)
+                                 ? compute_transfer_matrix_job<float>(foo, config, type)
+                                 : compute_transfer_matrix_job<double>(foo, config, type));
+    }
+
+    /**
+     * an async apply of a matlab matrix holds a double copy of it until the job finishes. Copies
+     * larger than apply.async_copy_limit MiB (default 256) are rejected in favor of mapped
+     * transfer matrices, which the job shares.
+     */
+    void check_async_copy(const mxArray* matrix, const Dune::ParameterTree& config)
+    {
+      const std::size_t limit = config.get<std::size_t>("apply.async_copy_limit", 256);
+      const std::size_t bytes = mxGetNumberOfElements(matrix) * sizeof(double);
+      if (bytes > limit * (std::size_t(1) << 20)) {
+        std::stringstream sstr;
+        sstr << "an async apply copies the transfer matrix, which needs " << (bytes >> 20)
+             << " MiB and exceeds apply.async_copy_limit (" << limit << " MiB). compute it "
+             << "with transfer_matrix_store.mapped set to pass a duneuro_transfer_matrix, use "
+             << "the synchronous apply or raise the limit";
+        mexErrMsgTxt(sstr.str().c_str());
+      }
+    }
+
+    void apply_transfer_async(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[],
+                              TransferMatrixStore::Type type)
+    {
+      if (nrhs < 4) {
+        mexErrMsgTxt(
+            "please provide a handle to the object, the transfer matrix, the dipoles and a "
+            "configuration struct");
+        return;
+      }
+      if (nlhs != 1) {
+        mexErrMsgTxt("the method returns a future");
+        return;
+      }
+      if (!mxIsDouble(prhs[2]) || mxGetM(prhs[2]) != 6) {
+        mexErrMsgTxt("expected 6xN double matrix for dipoles");
+        return;
+      }
+      auto foo = share_handle<DriverInterface<3>>(prhs[0]);
+      auto config = matlab_struct_to_parametertree(prhs[3]);
+      // matlab arrays may be freed while the job runs, so their data is copied. Single matrices
+      // are widened right into the copy. Mapped transfer matrices are shared with the job.
+      if (!mxIsUint64(prhs[1])) {
+        check_async_copy(prhs[1], config);
+      }
+      auto storage = std::make_shared<std::vector<double>>();
+      std::shared_ptr<MappedTransferMatrix> mapped;
+      std::shared_ptr<const DenseMatrix<double>> tm;
+      if (mxIsUint64(prhs[1]) && mxGetNumberOfElements(prhs[1]) == 1) {
+        mapped = share_handle<MappedTransferMatrix>(prhs[1]);
+        tm = mapped->view();
+      } else if (mxIsSingle(prhs[1])) {
+        check_single_precision_apply(config);
+        tm = widen_transfer_matrix(
+            SingleTransferMatrix{static_cast<const float*>(mxGetData(prhs[1])), mxGetN(prhs[1]),
+                                 mxGetM(prhs[1])},
+            config);
+      } else {
+        if (!mxIsDouble(prhs[1])) {
+          mexErrMsgTxt("expected double or single matrix");
+          return;
+        }
+        const double* ptr = mxGetPr(prhs[1]);
+        storage->assign(ptr, ptr + mxGetNumberOfElements(prhs[1]));
+        tm = std::make_shared<DenseMatrix<double>>(mxGetN(prhs[1]), mxGetM(prhs[1]),
+                                                   storage->data());
+      }
+      const std::size_t ndipoles = mxGetN(prhs[2]);
+      auto dipoles = std::make_shared<std::vector<double>>(
+          mxGetPr(prhs[2]), mxGetPr(prhs[2]) + 6 * ndipoles);
+      plhs[0] = submit_async([foo, config, type, storage, mapped, tm, dipoles,
+                              ndipoles](const AsyncJob& job) -> AsyncJob::Marshal {
+        auto lock = DriverCache::instance().lock(foo.get());
+        const std::size_t sensors = tm->rows();
+        auto result = std::make_shared<std::vector<double>>(sensors * ndipoles);
+        auto apply = [&](const DenseMatrix<double>& blockMatrix,
+                         const std::vector<Dipole<double, 3>>& block) {
+          job.checkpoint();
+          return type == TransferMatrixStore::Type::eeg
+                     ? foo->applyEEGTransfer(blockMatrix, block, config)
+                     : foo->applyMEGTransfer(blockMatrix, block, config);
+        };
+        apply_transfer_blocked(*tm, TransferInput{dipoles->data(), ndipoles, false}, config,
+                               result->data(), apply);
+        return [result, sensors, ndipoles](int nlhs, mxArray* plhs[]) {
+          if (nlhs != 1) {
+            mexErrMsgTxt("the job returns a matrix");
+            return;
+          }
+          plhs[0] = mxCreateUninitNumericMatrix(sensors, ndipoles, mxDOUBLE_CLASS, mxREAL);
+          std::copy(result->begin(), result->end(), mxGetPr(plhs[0]));
+        };
+      });
+    }
+
+    /**
+     * the driver and the function a solve job works on. The function belongs to the driver and
+     * is thus released first.
+     */
+    struct SolveInputs {
+      std::shared_ptr<DriverInterface<3>> driver;
+      std::shared_ptr<Function> function;
+    };
+  }
+
+  void CommandHandler::create_driver_async(int nlhs, mxArray* plhs[], int nrhs,
+                                           const mxArray* prhs[])
+  {
+    if (nlhs != 1) {
+      mexErrMsgTxt("the method returns a future");
+      return;
+    }
+    if (nrhs != 1) {
+      mexErrMsgTxt("one input required");
+      return;
+    }
+    auto config = matlab_struct_to_parametertree(prhs[0]);
+    const auto meshFile = extract_mesh_filename(prhs[0]);
+    const auto digest = driver_digest_if_needed(prhs[0], meshFile, config);
+    auto data = std::make_shared<MEEGDriverData<3>>();
+    // a mesh file does not need the matlab thread and is read by the job
+    const auto threads = ingestion_threads(config);
+    if (meshFile.empty()) {
+      extract_fitted_driver_data_from_struct(prhs[0], data->fittedData, threads);
+    }
+    plhs[0] = submit_async([config, digest, data, meshFile, threads](const AsyncJob&)
+                               -> AsyncJob::Marshal {
+      if (!meshFile.empty()) {
+        read_mesh_file(meshFile, data->fittedData, threads);
+      }
+      auto driver = std::make_shared<std::unique_ptr<DriverInterface<3>>>(
+          DriverFactory<3>::make_driver(config, *data));
+      return [config, digest, driver](int nlhs, mxArray* plhs[]) {
+        if (nlhs != 1) {
+          mexErrMsgTxt("the job returns a handle");
+          return;
+        }
+        bool share = config.get<bool>("driver_cache.enable", false);
+        plhs[0] = make_driver_handle(
+            DriverCache::instance().acquire(digest, share, [&]() { return std::move(*driver); }));
+      };
+    });
+  }
+
+  void CommandHandler::solve_eeg_forward_async(int nlhs, mxArray* plhs[], int nrhs,
+                                               const mxArray* prhs[])
+  {
+    if (nrhs < 4) {
+      mexErrMsgTxt(
+          "please provide a handle to the object, the dipole, the solution function and a "
+          "configuration struct");
+      return;
+    }
+    if (nlhs != 1) {
+      mexErrMsgTxt("the method returns a future");
+      return;
+    }
+    auto inputs = std::make_shared<SolveInputs>(SolveInputs{
+        share_handle<DriverInterface<3>>(prhs[0]), share_handle<Function>(prhs[2])});
+    auto dipole = extract_dipole(prhs[1]);
+    auto config = matlab_struct_to_parametertree(prhs[3]);
+    plhs[0] = submit_async([inputs, dipole, config](const AsyncJob&) -> AsyncJob::Marshal {
+      auto lock = DriverCache::instance().lock(inputs->driver.get());
+      inputs->driver->solveEEGForward(dipole, *inputs->function, config);
+      return [](int nlhs, mxArray* plhs[]) {
+        if (nlhs != 0) {
+          mexErrMsgTxt("the job does not return variables");
+        }
+      };
+    });
+  }
+
+  void CommandHandler::solve_meg_forward_async(int nlhs, mxArray* plhs[], int nrhs,
+                                               const mxArray* prhs[])
+  {
+    if (nrhs < 3) {
+      mexErrMsgTxt(
+          "please provide a handle to the object, a handle to the eeg solution and a configuration "
+          "struct");
+      return;
+    }
+    if (nlhs != 1) {
+      mexErrMsgTxt("the method returns a future");
+      return;
+    }
+    auto inputs = std::make_shared<SolveInputs>(SolveInputs{
+        share_handle<DriverInterface<3>>(prhs[0]), share_handle<Function>(prhs[1])});
+    auto config = matlab_struct_to_parametertree(prhs[2]);
+    plhs[0] = submit_async([inputs, config](const AsyncJob&) -> AsyncJob::Marshal {
+      auto lock = DriverCache::instance().lock(inputs->driver.get());
+      auto ae = std::make_shared<std::vector<double>>(
+          inputs->driver->solveMEGForward(*inputs->function, config));
+      return [ae](int nlhs, mxArray* plhs[]) {
+        if (nlhs != 1) {
+          mexErrMsgTxt("the job returns a matrix");
+          return;
+        }
+        plhs[0] = mxCreateDoubleMatrix(ae->size(), 1, mxREAL);
+        std::copy(ae->begin(), ae->end(), mxGetPr(plhs[0]));
+      };
+    });
+  }
+
+  void CommandHandler::compute_eeg_transfer_matrix_async(int nlhs, mxArray* plhs[], int nrhs,
+                                                         const mxArray* prhs[])
+  {
+    compute_transfer_matrix_async(nlhs, plhs, nrhs, prhs, TransferMatrixStore::Type::eeg);
+  }
+
+  void CommandHandler::compute_meg_transfer_matrix_async(int nlhs, mxArray* plhs[], int nrhs,
+                                                         const mxArray* prhs[])
+  {
+    compute_transfer_matrix_async(nlhs, plhs, nrhs, prhs, TransferMatrixStore::Type::meg);
+  }
+
+  void CommandHandler::apply_eeg_transfer_async(int nlhs, mxArray* plhs[], int nrhs,
+                                                const mxArray* prhs[])
+  {
+    apply_transfer_async(nlhs, plhs, nrhs, prhs, TransferMatrixStore::Type::eeg);
+  }
+
+  void CommandHandler::apply_meg_transfer_async(int nlhs, mxArray* plhs[], int nrhs,
+                                                const mxArray* prhs[])
+  {
+    apply_transfer_async(nlhs, plhs, nrhs, prhs, TransferMatrixStore::Type::meg);
+  }
+
+  void CommandHandler::poll(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nrhs != 1 || nlhs != 1) {
+      mexErrMsgTxt("please provide a future handle");
+      return;
+    }
+    auto* future = extract_handle<AsyncFuture>(prhs[0]);
+    plhs[0] = mxCreateString(future->job->state_name().c_str());
+  }
+
+  void CommandHandler::wait(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nrhs != 1) {
+      mexErrMsgTxt("please provide a future handle");
+      return;
+    }
+    auto* future = extract_handle<AsyncFuture>(prhs[0]);
+    future->job->retrieve(nlhs, plhs);
+  }
+
+  void CommandHandler::cancel(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nrhs != 1 || nlhs != 0) {
+      mexErrMsgTxt("please provide a future handle");
+      return;
+    }
+    auto* future = extract_handle<AsyncFuture>(prhs[0]);
+    future->job->cancel();
+  }
+
+  void CommandHandler::delete_future(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nrhs != 1 || nlhs != 0) {
+      mexErrMsgTxt("please provide a future handle");
+      return;
+    }
+    release_handle(prhs[0], HandleType::future);
+    // a pending job is cancelled right away and does not need to keep the module locked
+    unlock_stopped_jobs();
+  }
+
+  /**********************************************
+   * instrumentation
+   **********************************************/
+  namespace
+  {
+    mxArray* statistics_entry_to_struct(const CommandStatistics::Entry& entry)
+    {
+      const char* fields[] = {"calls", "time", "bytes"};
+      mxArray* out = mxCreateStructMatrix(1, 1, 3, fields);
+      mxSetField(out, 0, "calls", mxCreateDoubleScalar(entry.calls));
+      mxSetField(out, 0, "time", mxCreateDoubleScalar(entry.seconds));
+      mxSetField(out, 0, "bytes", mxCreateDoubleScalar(entry.bytes));
+      return out;
+    }
+  }
+
+  void CommandHandler::stats(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 1 || nrhs != 0) {
+      mexErrMsgTxt("the method takes no arguments and returns a struct");
+      return;
+    }
+    plhs[0] = mxCreateStructMatrix(1, 1, 0, nullptr);
+    for (const auto& command : CommandStatistics::instance().commands()) {
+      mxArray* entry = statistics_entry_to_struct(command.second.total);
+      mxArray* phases = mxCreateStructMatrix(1, 1, 0, nullptr);
+      // the time not spent in any recorded phase is mostly spent within duneuro
+      double computeTime = command.second.total.seconds;
+      for (const auto& phase : command.second.phases) {
+        mxAddField(phases, phase.first.c_str());
+        mxSetField(phases, 0, phase.first.c_str(), statistics_entry_to_struct(phase.second));
+        computeTime -= phase.second.seconds;
+      }
+      mxAddField(entry, "compute_time");
+      mxSetField(entry, 0, "compute_time", mxCreateDoubleScalar(std::max(0.0, computeTime)));
+      mxAddField(entry, "phases");
+      mxSetField(entry, 0, "phases", phases);
+      mxAddField(plhs[0], command.first.c_str());
+      mxSetField(plhs[0], 0, command.first.c_str(), entry);
+    }
+  }
+
+  void CommandHandler::reset_stats(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 0 || nrhs != 0) {
+      mexErrMsgTxt("the method takes no arguments and does not return variables");
+      return;
+    }
+    CommandStatistics::instance().reset();
+  }
+
+  void CommandHandler::start_trace(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 0 || nrhs != 0) {
+      mexErrMsgTxt("the method takes no arguments and does not return variables");
+      return;
+    }
+    CommandStatistics::instance().start_trace();
+  }
+
+  void CommandHandler::stop_trace(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 0 || nrhs != 1 || !mxIsChar(prhs[0])) {
+      mexErrMsgTxt("please provide the name of the trace file");
+      return;
+    }
+    CommandStatistics::instance().stop_trace(extract_string(prhs[0]));
+  }
+
+  /**********************************************
+   * handles
+   **********************************************/
+  void CommandHandler::handles(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 1 || nrhs != 0) {
+      mexErrMsgTxt("the method takes no arguments and returns a struct");
+      return;
+    }
+    plhs[0] = mxCreateStructMatrix(1, 1, 0, nullptr);
+    for (std::size_t t = 1; t < numberOfHandleTypes; ++t) {
+      const auto type = static_cast<HandleType>(t);
+      const auto handles = HandleRegistry::instance().handles(type);
+      mxArray* array = mxCreateNumericMatrix(1, handles.size(), mxUINT64_CLASS, mxREAL);
+      std::copy(handles.begin(), handles.end(), static_cast<std::uint64_t*>(mxGetData(array)));
+      mxAddField(plhs[0], handle_type_name(type));
+      mxSetField(plhs[0], 0, handle_type_name(type), array);
+    }
+  }
+
+  void CommandHandler::release_all(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs > 1 || nrhs != 0) {
+      mexErrMsgTxt("the method takes no arguments");
+      return;
+    }
+    auto released = release_all_handles();
+    if (nlhs == 1) {
+      plhs[0] = mxCreateDoubleScalar(released);
+    }
+  }
+
+  /**********************************************
+   * compiled configs
+   **********************************************/
+  void CommandHandler::compile_config(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 1 || nrhs != 1 || !mxIsStruct(prhs[0])) {
+      mexErrMsgTxt("please provide a config struct");
+      return;
+    }
+    plhs[0] = make_handle(std::make_unique<Dune::ParameterTree>(
+        matlab_struct_to_parametertree(prhs[0])));
+  }
+
+  void CommandHandler::delete_config(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 0 || nrhs != 1) {
+      mexErrMsgTxt("please provide a config handle");
+      return;
+    }
+    release_handle(prhs[0], HandleType::config);
+  }
+
+  /**********************************************
+   * array files
+   **********************************************/
+  void CommandHandler::write_array(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 0 || nrhs != 2 || !mxIsChar(prhs[0])) {
+      mexErrMsgTxt("please provide a filename and an array");
+      return;
+    }
+    write_array_file(extract_string(prhs[0]), prhs[1]);
+  }
+
+  void CommandHandler::read_array(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 1 || nrhs != 1 || !mxIsChar(prhs[0])) {
+      mexErrMsgTxt("please provide a filename, the method returns an array");
+      return;
+    }
+    plhs[0] = read_array_file(extract_string(prhs[0]));
+  }
+
+  /**********************************************
+   * server mode
+   **********************************************/
+  void CommandHandler::connect_server(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 0 || nrhs < 1 || nrhs > 2 || !mxIsChar(prhs[0])) {
+      mexErrMsgTxt("please provide the socket path of the server and optionally a config");
+      return;
+    }
+    std::size_t threshold = std::size_t(1) << 20;
+    if (nrhs == 2) {
+      Dune::ParameterTree storage;
+      threshold = extract_config(prhs[1], storage)
+                      .get<std::size_t>("shared_memory_threshold", threshold);
+    }
+    ServerConnection::instance().connect(extract_string(prhs[0]), threshold);
+  }
+
+  void CommandHandler::disconnect_server(int nlhs, mxArray* plhs[], int nrhs,
+                                         const mxArray* prhs[])
+  {
+    if (nlhs != 0 || nrhs != 0) {
+      mexErrMsgTxt("the method takes no arguments");
+      return;
+    }
+    ServerConnection::instance().disconnect();
+  }
+
+  void CommandHandler::at_exit()
+  {
+    ServerConnection::instance().disconnect();
+    // the module is locked while jobs are running, so this only waits when matlab exits
+    AsyncExecutor::instance().shutdown();
+    // the module is unloaded, so the lock count does not have to be maintained anymore
+    HandleRegistry::instance().release_all();
+  }
+
+  namespace
+  {
+    using Command = void (*)(int, mxArray* [], int, const mxArray* []);
+
+    struct CommandEntry {
+      const char* name;
+      Command function;
+    };
+
+    // the opcode of a command is its position in this table, so new commands are appended
+    const CommandEntry commandTable[] = {
+        {"create", CommandHandler::create_driver},
+        {"make_domain_function", CommandHandler::make_domain_function},
+        {"delete_function", CommandHandler::delete_function},
+        {"solve_eeg_forward", CommandHandler::solve_eeg_forward},
+        {"solve_eeg_forward_batch", CommandHandler::solve_eeg_forward_batch},
+        {"solve_meg_forward", CommandHandler::solve_meg_forward},
+        {"compute_eeg_transfer_matrix", CommandHandler::compute_eeg_transfer_matrix},
+        {"compute_meg_transfer_matrix", CommandHandler::compute_meg_transfer_matrix},
+        {"apply_eeg_transfer", CommandHandler::apply_eeg_transfer},
+        {"apply_meg_transfer", CommandHandler::apply_meg_transfer},
+        {"set_electrodes", CommandHandler::set_electrodes},
+        {"get_projected_electrodes", CommandHandler::get_projected_electrodes},
+        {"set_coils_and_projections", CommandHandler::set_coils_and_projections},
+        {"evaluate_at_electrodes", CommandHandler::evaluate_at_electrodes},
+        {"print_citations", CommandHandler::print_citations},
+        {"delete", CommandHandler::delete_driver},
+        {"delete_transfer_matrix", CommandHandler::delete_transfer_matrix},
+        {"transfer_matrix_size", CommandHandler::transfer_matrix_size},
+        {"volume_conductor_vtk_writer", CommandHandler::volume_conductor_vtk_writer},
+        {"volume_writer_add_vertex_data", CommandHandler::volume_writer_add_vertex_data},
+        {"volume_writer_add_vertex_data_gradient",
+         CommandHandler::volume_writer_add_vertex_data_gradient},
+        {"volume_writer_add_cell_data", CommandHandler::volume_writer_add_cell_data},
+        {"volume_writer_add_cell_data_gradient",
+         CommandHandler::volume_writer_add_cell_data_gradient},
+        {"volume_writer_write", CommandHandler::volume_writer_write},
+        {"volume_writer_delete", CommandHandler::volume_writer_delete},
+        {"point_vtk_writer", CommandHandler::point_vtk_writer},
+        {"point_writer_add_scalar_data", CommandHandler::point_writer_add_scalar_data},
+        {"point_writer_add_vector_data", CommandHandler::point_writer_add_vector_data},
+        {"point_writer_write", CommandHandler::point_writer_write},
+        {"point_writer_delete", CommandHandler::point_writer_delete},
+        {"create_async", CommandHandler::create_driver_async},
+        {"solve_eeg_forward_async", CommandHandler::solve_eeg_forward_async},
+        {"solve_meg_forward_async", CommandHandler::solve_meg_forward_async},
+        {"compute_eeg_transfer_matrix_async", CommandHandler::compute_eeg_transfer_matrix_async},
+        {"compute_meg_transfer_matrix_async", CommandHandler::compute_meg_transfer_matrix_async},
+        {"apply_eeg_transfer_async", CommandHandler::apply_eeg_transfer_async},
+        {"apply_meg_transfer_async", CommandHandler::apply_meg_transfer_async},
+        {"poll", CommandHandler::poll},
+        {"wait", CommandHandler::wait},
+        {"cancel", CommandHandler::cancel},
+        {"delete_future", CommandHandler::delete_future},
+        {"stats", CommandHandler::stats},
+        {"reset_stats", CommandHandler::reset_stats},
+        {"start_trace", CommandHandler::start_trace},
+        {"stop_trace", CommandHandler::stop_trace},
+        {"batch", CommandHandler::batch},
+        {"opcodes", CommandHandler::opcodes},
+        {"handles", CommandHandler::handles},
+        {"release_all", CommandHandler::release_all},
+        {"compile_config", CommandHandler::compile_config},
+        {"delete_config", CommandHandler::delete_config},
+        {"compute_leadfield", CommandHandler::compute_leadfield},
+        {"apply_meeg_transfer", CommandHandler::apply_meeg_transfer},
+        {"evaluate_at_electrodes_batch", CommandHandler::evaluate_at_electrodes_batch},
+        {"vtu_series_writer", CommandHandler::vtu_series_writer},
+        {"series_writer_set_mesh", CommandHandler::series_writer_set_mesh},
+        {"series_writer_add_vertex_data", CommandHandler::series_writer_add_vertex_data},
+        {"series_writer_add_cell_data", CommandHandler::series_writer_add_cell_data},
+        {"series_writer_delete", CommandHandler::series_writer_delete},
+        {"write_point_vtu", CommandHandler::write_point_vtu},
+        {"save_snapshot", CommandHandler::save_snapshot},
+        {"load_snapshot", CommandHandler::load_snapshot},
+        {"connect_server", CommandHandler::connect_server},
+        {"disconnect_server", CommandHandler::disconnect_server},
+        {"write_array", CommandHandler::write_array},
+        {"read_array", CommandHandler::read_array}};
+
+    constexpr std::size_t numberOfCommands = sizeof(commandTable) / sizeof(CommandEntry);
+
+    // longer names can not denote a command, so they do not have to be read completely
+    constexpr std::size_t maxCommandNameLength = 64;
+
+    // upper bound for the number of inputs and outputs of a single command within a batch
+    constexpr std::size_t maxBatchArguments = 16;
+
+    // opcodes sorted by command name, used for the binary search by name
+    const std::array<std::uint16_t, numberOfCommands>& sorted_opcodes()
+    {
+      static const std::array<std::uint16_t, numberOfCommands> sorted = []() {
+        std::array<std::uint16_t, numberOfCommands> opcodes;
+        std::iota(opcodes.begin(), opcodes.end(), 0);
+        std::sort(opcodes.begin(), opcodes.end(), [](std::uint16_t a, std::uint16_t b) {
+          return std::strcmp(commandTable[a].name, commandTable[b].name) < 0;
+        });
+        return opcodes;
+      }();
+      return sorted;
+    }
+
+    const CommandEntry* find_command(const mxArray* arr)
+    {
+      if (mxIsChar(arr)) {
+        char name[maxCommandNameLength];
+        if (mxGetString(arr, name, maxCommandNameLength) != 0) {
+          return nullptr;
+        }
+        const auto& sorted = sorted_opcodes();
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), name,
+                                   [](std::uint16_t opcode, const char* n) {
+                                     return std::strcmp(commandTable[opcode].name, n) < 0;
+                                   });
+        if (it != sorted.end() && std::strcmp(commandTable[*it].name, name) == 0) {
+          return &commandTable[*it];
+        }
+        return nullptr;
+      }
+      if (mxIsNumeric(arr) && mxGetNumberOfElements(arr) == 1 && !mxIsComplex(arr)) {
+        const double opcode = mxGetScalar(arr);
+        if (opcode >= 0 && opcode < numberOfCommands && opcode == std::floor(opcode)) {
+          return &commandTable[static_cast<std::size_t>(opcode)];
+        }
+      }
+      return nullptr;
+    }
+
+    const CommandEntry& lookup_command(const mxArray* arr)
+    {
+      const CommandEntry* command = find_command(arr);
+      if (!command) {
+        std::stringstream sstr;
+        if (mxIsChar(arr)) {
+          sstr << "command \"" << extract_string(arr) << "\" not found";
+        } else {
+          sstr << "expected a command name or a scalar opcode";
+        }
+        mexErrMsgTxt(sstr.str().c_str());
+      }
+      return *command;
+    }
+
+    void dispatch(const CommandEntry& command, int nlhs, mxArray* plhs[], int nrhs,
+                  const mxArray* prhs[])
+    {
+      ScopedCommand timing(command.name);
+      command.function(nlhs, plhs, nrhs, prhs);
+    }
+  }
+
+  void CommandHandler::batch(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs > 1 || nrhs < 1 || nrhs > 2 || !mxIsCell(prhs[0])) {
+      mexErrMsgTxt("please provide a cell array of commands and optionally the number of outputs "
+                   "of each command");
+      return;
+    }
+    const std::size_t numberOfBatchCommands = mxGetNumberOfElements(prhs[0]);
+    const double* nargouts = nullptr;
+    if (nrhs == 2) {
+      if (!mxIsDouble(prhs[1]) || mxGetNumberOfElements(prhs[1]) != numberOfBatchCommands) {
+        mexErrMsgTxt("the number of outputs has to be a double vector with one entry per command");
+        return;
+      }
+      nargouts = mxGetPr(prhs[1]);
+    }
+    mxArray* results = nlhs == 1 ? mxCreateCellMatrix(numberOfBatchCommands, 1) : nullptr;
+    const mxArray* inputs[maxBatchArguments];
+    mxArray* outputs[maxBatchArguments];
+    int numberOfOutputs = 0;
+    // matlab never sees the results of a failed batch, so the handles created by its entries
+    // would be leaked
+    HandleRecording created;
+    auto discard = [&]() {
+      created.release_all();
+      for (int j = 0; j < numberOfOutputs; ++j) {
+        if (outputs[j]) {
+          mxDestroyArray(outputs[j]);
+        }
+      }
+      if (results) {
+        mxDestroyArray(results);
+      }
+    };
+    for (std::size_t i = 0; i < numberOfBatchCommands; ++i) {
+      numberOfOutputs = 0;
+      const mxArray* entry = mxGetCell(prhs[0], i);
+      const std::size_t numberOfInputs =
+          entry && mxIsCell(entry) ? mxGetNumberOfElements(entry) : 0;
+      const double nargout = nargouts ? nargouts[i] : 0.0;
+      std::stringstream error;
+      if (numberOfInputs == 0 || numberOfInputs > maxBatchArguments + 1 || nargout < 0
+          || nargout > maxBatchArguments || nargout != std::floor(nargout)) {
+        error << "batch entry " << i + 1 << " has to be a cell array {command, arguments...} with "
+              << "at most " << maxBatchArguments << " arguments and outputs";
+      } else if (nargout > 0 && !results) {
+        error << "commands with outputs require the batch to return its results";
+      } else {
+        const CommandEntry* command = find_command(mxGetCell(entry, 0));
+        if (!command) {
+          error << "batch entry " << i + 1 << ": ";
+          if (mxIsChar(mxGetCell(entry, 0))) {
+            error << "command \"" << extract_string(mxGetCell(entry, 0)) << "\" not found";
+          } else {
+            error << "expected a command name or a scalar opcode";
+          }
+        } else {
+          for (std::size_t j = 1; j < numberOfInputs; ++j) {
+            inputs[j - 1] = mxGetCell(entry, j);
+          }
+          numberOfOutputs = static_cast<int>(nargout);
+          std::fill(outputs, outputs + numberOfOutputs, nullptr);
+          try {
+            dispatch(*command, numberOfOutputs, outputs, numberOfInputs - 1, inputs);
+          } catch (Dune::Exception& ex) {
+            error << "batch entry " << i + 1 << " (" << command->name << "): " << ex.what();
+          } catch (std::exception& ex) {
+            error << "batch entry " << i + 1 << " (" << command->name << "): " << ex.what();
+          } catch (...) {
+            // errors the command raised through the mex api
+            discard();
+            throw;
+          }
+        }
+      }
+      if (!error.str().empty()) {
+        discard();
+        mexErrMsgTxt(error.str().c_str());
+        return;
+      }
+      if (results) {
+        mxArray* commandOutputs = mxCreateCellMatrix(1, numberOfOutputs);
+        for (int j = 0; j < numberOfOutputs; ++j) {
+          mxSetCell(commandOutputs, j, outputs[j]);
+        }
+        mxSetCell(results, i, commandOutputs);
+      }
+    }
+    if (results) {
+      plhs[0] = results;
+    }
+  }
+
+  void CommandHandler::opcodes(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (nlhs != 1 || nrhs != 0) {
+      mexErrMsgTxt("the method takes no arguments and returns a struct");
+      return;
+    }
+    plhs[0] = mxCreateStructMatrix(1, 1, 0, nullptr);
+    for (std::size_t i = 0; i < numberOfCommands; ++i) {
+      mxAddField(plhs[0], commandTable[i].name);
+      mxSetField(plhs[0], 0, commandTable[i].name, mxCreateDoubleScalar(i));
+    }
   }
 
   void CommandHandler::run_command(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
   {
-    static std::map<std::string, std::function<void(int, mxArray* [], int, const mxArray* [])>>
-        commands = {{"create", create_driver},
-                    {"make_domain_function", make_domain_function},
-                    {"delete_function", delete_function},
-                    {"solve_eeg_forward", solve_eeg_forward},
-                    {"solve_meg_forward", solve_meg_forward},
-                    {"compute_eeg_transfer_matrix", compute_eeg_transfer_matrix},
-                    {"compute_meg_transfer_matrix", compute_meg_transfer_matrix},
-                    {"apply_eeg_transfer", apply_eeg_transfer},
-                    {"apply_meg_transfer", apply_meg_transfer},
-                    {"set_electrodes", set_electrodes},
-                    {"get_projected_electrodes", get_projected_electrodes},
-                    {"set_coils_and_projections", set_coils_and_projections},
-                    {"evaluate_at_electrodes", evaluate_at_electrodes},
-                    {"print_citations", print_citations},
-                    {"delete", delete_driver},
-                    
-                    {"volume_conductor_vtk_writer", volume_conductor_vtk_writer},
-                    {"volume_writer_add_vertex_data", volume_writer_add_vertex_data},
-                    {"volume_writer_add_vertex_data_gradient", volume_writer_add_vertex_data_gradient},
-                    {"volume_writer_add_cell_data", volume_writer_add_cell_data},
-                    {"volume_writer_add_cell_data_gradient", volume_writer_add_cell_data_gradient},
-                    {"volume_writer_write", volume_writer_write},
-                    {"volume_writer_delete", volume_writer_delete},
-                    
-                    {"point_vtk_writer", point_vtk_writer},
-                    {"point_writer_add_scalar_data", point_writer_add_scalar_data},
-                    {"point_writer_add_vector_data", point_writer_add_vector_data},
-                    {"point_writer_write", point_writer_write},
-                    {"point_writer_delete", point_writer_delete}};
     if (nrhs == 0) {
       mexErrMsgTxt("please provide a command");
       return;
     }
-    auto cmd = commands.find(mxArrayToString(prhs[0]));
-    if (cmd == commands.end()) {
-      std::stringstream sstr;
-      sstr << "command \"" << mxArrayToString(prhs[0]) << "\" not found";
-      auto str = sstr.str();
-      mexErrMsgTxt(str.c_str());
+    const CommandEntry& command = lookup_command(prhs[0]);
+    unlock_stopped_jobs();
+    // while connected, everything but the connection itself is executed by the server
+    if (ServerConnection::instance().connected()
+        && command.function != CommandHandler::connect_server
+        && command.function != CommandHandler::disconnect_server) {
+      ServerConnection::instance().run(nlhs, plhs, nrhs, prhs);
       return;
-    } else {
-      cmd->second(nlhs, plhs, nrhs - 1, prhs + 1);
     }
+    dispatch(command, nlhs, plhs, nrhs - 1, prhs + 1);
   }
 }
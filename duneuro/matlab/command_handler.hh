@@ -7,14 +7,42 @@
 namespace duneuro
 {
   struct CommandHandler {
-    /** \TODO docme! */
+    /**
+     * \brief create a driver from a struct
+     *
+     * driver_cache.enable shares the driver with the other shared drivers created from the same
+     * struct, identified by a sha-256 digest of its content. Every handle to a shared driver keeps
+     * its own electrodes and coils. The digest is also required by the
+     * transfer matrix store and can be requested without sharing by driver_cache.digest.
+     * Otherwise it is not computed.
+     */
     static void create_driver(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief write the mesh, config, electrodes and coils of a driver to a binary snapshot file
+     *
+     * expects the driver, the struct it was created from and the filename. The struct is needed
+     * since the driver does not keep the mesh. It has to match the driver, which is checked if the
+     * driver was created with a digest, see create_driver.
+     */
+    static void save_snapshot(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief create a driver from a snapshot file, restoring its electrodes and coils */
+    static void load_snapshot(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
     static void make_domain_function(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
     static void delete_function(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
     static void solve_eeg_forward(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief solve the eeg forward problem for a 6xN dipole matrix and return the electrode
+     * potentials as an (electrodes x N) matrix
+     *
+     * the dipoles are solved one after another in a single call. Each solve is a full solve of
+     * the driver, the assembled system and preconditioner are reused only as far as the driver
+     * itself reuses them.
+     */
+    static void solve_eeg_forward_batch(int nlhs, mxArray* plhs[], int nrhs,
+                                        const mxArray* prhs[]);
     /** \TODO docme! */
     static void solve_meg_forward(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
@@ -27,6 +55,22 @@ namespace duneuro
     static void apply_eeg_transfer(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
     static void apply_meg_transfer(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief apply an eeg and a meg transfer matrix to the same dipoles
+     *
+     * takes the eeg and the meg transfer matrix, the dipoles and a config and returns the eeg and
+     * the meg result. The dipoles are extracted once and both transfers are applied block by block.
+     */
+    static void apply_meeg_transfer(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief leadfield of a grid of source positions
+     *
+     * takes a transfer matrix, a 3xN matrix of positions and a config, whose modality entry (eeg
+     * or meg, default eeg) selects the transfer. Returns the (sensors x 3N) leadfield, whose
+     * columns 3i+1, 3i+2 and 3i+3 (in matlab numbering) are the results of unit dipoles at position
+     * i in x, y and z direction.
+     */
+    static void compute_leadfield(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
     static void set_electrodes(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
@@ -37,12 +81,25 @@ namespace duneuro
                                           const mxArray* prhs[]);
     /** \TODO docme! */
     static void evaluate_at_electrodes(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief evaluate several functions at the electrodes within a single call
+     *
+     * takes a uint64 array of function handles and an optional config and returns an (electrodes x
+     * functions) matrix. config.threads (default 1) evaluates the functions on several threads,
+     * which is only safe if the driver is not shared and supports concurrent evaluations.
+     */
+    static void evaluate_at_electrodes_batch(int nlhs, mxArray* plhs[], int nrhs,
+                                             const mxArray* prhs[]);
     /** \TODO docme! */
     static void write(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
     static void print_citations(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     /** \TODO docme! */
     static void delete_driver(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief release a transfer matrix mapped from a transfer matrix store */
+    static void delete_transfer_matrix(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief size of a mapped transfer matrix as seen from matlab, i.e. [nodes sensors] */
+    static void transfer_matrix_size(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
    
     // visualization functionality
     static void volume_conductor_vtk_writer(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
@@ -52,14 +109,144 @@ namespace duneuro
     static void volume_writer_add_cell_data_gradient(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     static void volume_writer_write(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     static void volume_writer_delete(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief create a VTUSeriesWriter for a driver or the mesh of the struct it was created from
+     *
+     * the data added to the writer are (vertices x steps) or (cells x steps) matrices, each
+     * column is written as a time step of a .pvd collection. Writers created for a driver also
+     * take arrays of function handles, each written as a time step on the grid of the driver.
+     * Matrices are only accepted once series_writer_set_mesh set the mesh of their nodes.
+     */
+    static void vtu_series_writer(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    static void series_writer_set_mesh(int nlhs, mxArray* plhs[], int nrhs,
+                                       const mxArray* prhs[]);
+    static void series_writer_add_vertex_data(int nlhs, mxArray* plhs[], int nrhs,
+                                              const mxArray* prhs[]);
+    static void series_writer_add_cell_data(int nlhs, mxArray* plhs[], int nrhs,
+                                            const mxArray* prhs[]);
+    static void series_writer_delete(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     
     static void point_vtk_writer(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     static void point_writer_add_scalar_data(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     static void point_writer_add_vector_data(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     static void point_writer_write(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     static void point_writer_delete(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief write points and data on them as binary vtu files without copying the arrays
+     *
+     * scalar and vector data are given as cells {name, values, name, values, ...}. Scalar values
+     * are (N x steps) and vector values (3 x N x steps), data with more than one step is written as
+     * a .pvd collection. See write_point_vtu.
+     */
+    static void write_point_vtu(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
     
-    /** \TODO docme! */
+    // asynchronous execution. The *_async commands extract their inputs on the matlab thread,
+    // queue the work on a background worker and return a future handle. The result is marshalled
+    // into matlab arrays by wait. Jobs share the drivers, functions and transfer matrices they use
+    // and hold the lock of their driver while they run, so commands on that driver wait for them.
+    // Async applies copy matlab transfer matrices as double matrices and reject copies above
+    // apply.async_copy_limit MiB (default 256), mapped transfer matrices are shared instead.
+    static void create_driver_async(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    static void solve_eeg_forward_async(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    static void solve_meg_forward_async(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    static void compute_eeg_transfer_matrix_async(int nlhs, mxArray* plhs[], int nrhs,
+                                                  const mxArray* prhs[]);
+    static void compute_meg_transfer_matrix_async(int nlhs, mxArray* plhs[], int nrhs,
+                                                  const mxArray* prhs[]);
+    static void apply_eeg_transfer_async(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    static void apply_meg_transfer_async(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief state of the job behind a future: pending, running, finished, failed or cancelled */
+    static void poll(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief block until the job is done and return its result */
+    static void wait(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief request cancellation of the job behind a future */
+    static void cancel(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief cancel the job and release the future without waiting for the job to stop */
+    static void delete_future(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    // instrumentation
+    /**
+     * \brief return calls, wall time and marshalled bytes per command as a struct
+     *
+     * each command additionally lists its phases (struct conversion, extraction of inputs, copies
+     * of results) and the remaining compute_time, which is mostly spent within duneuro.
+     */
+    static void stats(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    static void reset_stats(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief start recording every command and phase as a trace event */
+    static void start_trace(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief stop recording and write the events to a chrome trace json file */
+    static void stop_trace(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    // dispatch
+    /**
+     * \brief run a cell array of commands within a single call
+     *
+     * every entry is a cell array {command, arguments...}, where the command is given by its name
+     * or its opcode. An optional vector holds the number of outputs of each command (default 0).
+     * The outputs are returned as a cell array with one cell array of outputs per command. If an
+     * entry fails, the error names the entry and the handles created by earlier entries are
+     * released.
+     */
+    static void batch(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief return a struct mapping each command name to its opcode */
+    static void opcodes(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    // handles
+    /** \brief return a struct listing the live handles of each type as uint64 vectors */
+    static void handles(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /**
+     * \brief destroy all drivers, functions, writers, transfer matrices and futures
+     *
+     * returns the number of released handles. The matlab objects holding them become invalid, their
+     * destructors ignore the released handles.
+     */
+    static void release_all(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    // compiled configs
+    /**
+     * \brief convert a config struct once and return a handle to it
+     *
+     * the handle (or a duneuro_config object) can be passed wherever a config struct is expected.
+     */
+    static void compile_config(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    static void delete_config(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    // array files
+    /**
+     * \brief write an array to a binary file, see write_array_file
+     *
+     * takes the filename and the array. Used to exchange inputs and results with
+     * duneuro_matlab_runner.
+     */
+    static void write_array(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief read an array written by write_array or duneuro_matlab_runner */
+    static void read_array(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    // server mode
+    /**
+     * \brief execute all further commands in a duneuro_matlab_server
+     *
+     * takes the path of the socket the server listens on and an optional config, whose
+     * shared_memory_threshold (default 1 MiB) gives the size in bytes from which arrays are passed
+     * through shared memory instead of the socket. Handles created while connected refer to
+     * objects in the server. Drivers created from the same struct with driver_cache.enable are
+     * shared by all clients through the DriverCache, each keeping its own electrodes and coils.
+     * The handles of a client are released when it disconnects.
+     */
+    static void connect_server(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+    /** \brief close the connection to the server and execute commands locally again */
+    static void disconnect_server(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    /** \brief release resources which must not outlive the mex module, see mexAtExit */
+    static void at_exit();
+
+    /**
+     * \brief run the command given by its name or opcode in prhs[0]
+     *
+     * the lookup does not allocate, so that the overhead of short commands stays small. While
+     * connected to a server, the command is forwarded to it, see connect_server.
+     */
     static void run_command(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
   };
 }
@@ -0,0 +1,167 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/command_statistics.hh>
+
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <thread>
+
+#include <dune/common/exceptions.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    // phases recorded outside of a command, e.g. in background jobs, are attributed to this name
+    thread_local const char* currentCommand = "background";
+
+    double seconds_between(CommandStatistics::Clock::time_point begin,
+                           CommandStatistics::Clock::time_point end)
+    {
+      return std::chrono::duration<double>(end - begin).count();
+    }
+
+    template <class Map>
+    typename Map::mapped_type& find_or_insert(Map& map, const char* key)
+    {
+      auto it = map.find(key);
+      if (it == map.end()) {
+        it = map.emplace(key, typename Map::mapped_type()).first;
+      }
+      return it->second;
+    }
+
+    // names are identifiers chosen by us, but we escape them anyway to produce valid json
+    std::string json_escape(const std::string& str)
+    {
+      std::string out;
+      for (char c : str) {
+        if (c == '"' || c == '\\') {
+          out += '\\';
+        }
+        out += c;
+      }
+      return out;
+    }
+  }
+
+  CommandStatistics& CommandStatistics::instance()
+  {
+    static CommandStatistics statistics;
+    return statistics;
+  }
+
+  void CommandStatistics::record_command(const char* command, Clock::time_point begin,
+                                         Clock::time_point end)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = find_or_insert(commands_, command).total;
+    entry.calls++;
+    entry.seconds += seconds_between(begin, end);
+    record_event(command, "command", begin, end, 0);
+  }
+
+  void CommandStatistics::record_phase(const char* command, const char* phase,
+                                       Clock::time_point begin, Clock::time_point end,
+                                       std::size_t bytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& commandEntry = find_or_insert(commands_, command);
+    auto& entry = find_or_insert(commandEntry.phases, phase);
+    entry.calls++;
+    entry.seconds += seconds_between(begin, end);
+    entry.bytes += bytes;
+    commandEntry.total.bytes += bytes;
+    record_event(phase, command, begin, end, bytes);
+  }
+
+  CommandStatistics::CommandMap CommandStatistics::commands() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return commands_;
+  }
+
+  void CommandStatistics::reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    commands_.clear();
+  }
+
+  void CommandStatistics::start_trace()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+    traceStart_ = Clock::now();
+    tracing_ = true;
+  }
+
+  void CommandStatistics::stop_trace(const std::string& filename)
+  {
+    std::vector<TraceEvent> events;
+    Clock::time_point traceStart;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tracing_ = false;
+      events.swap(events_);
+      traceStart = traceStart_;
+    }
+    std::ofstream stream(filename);
+    // nanosecond resolution regardless of the length of the trace
+    stream << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      const auto& e = events[i];
+      const auto ts = std::chrono::duration<double, std::micro>(e.begin - traceStart).count();
+      const auto dur = std::chrono::duration<double, std::micro>(e.end - e.begin).count();
+      stream << (i > 0 ? "," : "") << "\n{\"name\":\"" << json_escape(e.name) << "\",\"cat\":\""
+             << json_escape(e.category) << "\",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << dur
+             << ",\"pid\":1,\"tid\":" << e.thread << ",\"args\":{\"bytes\":" << e.bytes << "}}";
+    }
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    if (!stream) {
+      DUNE_THROW(Dune::IOError, "could not write trace to \"" << filename << "\"");
+    }
+  }
+
+  void CommandStatistics::record_event(const char* name, const char* category,
+                                       Clock::time_point begin, Clock::time_point end,
+                                       std::size_t bytes)
+  {
+    if (!tracing_) {
+      return;
+    }
+    // small thread ids keep the trace viewer readable
+    const std::size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id()) % 100000;
+    events_.push_back(TraceEvent{name, category, begin, end, thread, bytes});
+  }
+
+  ScopedCommand::ScopedCommand(const char* name)
+      : name_(name), previous_(currentCommand), begin_(CommandStatistics::Clock::now())
+  {
+    currentCommand = name_;
+  }
+
+  ScopedCommand::~ScopedCommand()
+  {
+    CommandStatistics::instance().record_command(name_, begin_, CommandStatistics::Clock::now());
+    currentCommand = previous_;
+  }
+
+  const char* ScopedCommand::current()
+  {
+    return currentCommand;
+  }
+
+  ScopedPhase::ScopedPhase(const char* name, std::size_t bytes)
+      : name_(name), bytes_(bytes), begin_(CommandStatistics::Clock::now())
+  {
+  }
+
+  ScopedPhase::~ScopedPhase()
+  {
+    CommandStatistics::instance().record_phase(ScopedCommand::current(), name_, begin_,
+                                               CommandStatistics::Clock::now(), bytes_);
+  }
+}
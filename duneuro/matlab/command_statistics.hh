@@ -0,0 +1,122 @@
+#ifndef DUNEURO_MATLAB_COMMAND_STATISTICS_HH
+#define DUNEURO_MATLAB_COMMAND_STATISTICS_HH
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace duneuro
+{
+  /**
+   * \brief wall time, call counts and marshalled bytes per command and phase
+   *
+   * A command is a single call dispatched by CommandHandler::run_command. Phases are parts of a
+   * command, e.g. the conversion of a matlab struct or the copy of the result into a matlab array.
+   * Optionally, every command and phase is recorded as an event which can be written as a chrome
+   * trace (chrome://tracing or https://ui.perfetto.dev).
+   */
+  class CommandStatistics
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+      std::size_t calls = 0;
+      double seconds = 0.0;
+      std::size_t bytes = 0;
+    };
+
+    struct CommandEntry {
+      Entry total;
+      std::map<std::string, Entry, std::less<>> phases;
+    };
+
+    // transparent comparison, so that recording a known command or phase does not allocate
+    using CommandMap = std::map<std::string, CommandEntry, std::less<>>;
+
+    static CommandStatistics& instance();
+
+    void record_command(const char* command, Clock::time_point begin, Clock::time_point end);
+
+    void record_phase(const char* command, const char* phase, Clock::time_point begin,
+                      Clock::time_point end, std::size_t bytes);
+
+    /** \brief copy of the statistics gathered so far */
+    CommandMap commands() const;
+
+    void reset();
+
+    /** \brief start recording trace events, discarding previously recorded ones */
+    void start_trace();
+
+    /** \brief stop recording trace events and write them in the chrome trace json format */
+    void stop_trace(const std::string& filename);
+
+  private:
+    CommandStatistics() = default;
+
+    struct TraceEvent {
+      std::string name;
+      std::string category;
+      Clock::time_point begin;
+      Clock::time_point end;
+      std::size_t thread;
+      std::size_t bytes;
+    };
+
+    void record_event(const char* name, const char* category, Clock::time_point begin,
+                      Clock::time_point end, std::size_t bytes);
+
+    CommandMap commands_;
+    bool tracing_ = false;
+    Clock::time_point traceStart_;
+    std::vector<TraceEvent> events_;
+    mutable std::mutex mutex_;
+  };
+
+  /** \brief records the wall time of a command for its lifetime */
+  class ScopedCommand
+  {
+  public:
+    explicit ScopedCommand(const char* name);
+    ~ScopedCommand();
+
+    ScopedCommand(const ScopedCommand&) = delete;
+    ScopedCommand& operator=(const ScopedCommand&) = delete;
+
+    /** \brief name of the command currently executed on this thread, "background" if none */
+    static const char* current();
+
+  private:
+    const char* name_;
+    const char* previous_;
+    CommandStatistics::Clock::time_point begin_;
+  };
+
+  /** \brief records the wall time and marshalled bytes of a phase of the current command */
+  class ScopedPhase
+  {
+  public:
+    explicit ScopedPhase(const char* name, std::size_t bytes = 0);
+    ~ScopedPhase();
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+    void add_bytes(std::size_t bytes)
+    {
+      bytes_ += bytes;
+    }
+
+  private:
+    const char* name_;
+    std::size_t bytes_;
+    CommandStatistics::Clock::time_point begin_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_COMMAND_STATISTICS_HH
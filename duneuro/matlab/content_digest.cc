@@ -0,0 +1,197 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/content_digest.hh>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <duneuro/matlab/parallel.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    const std::uint32_t roundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+        0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+        0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+        0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+        0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+        0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+        0xc67178f2};
+
+    // ranges of update_parallel are hashed in chunks of this many bytes
+    const std::size_t chunkSize = std::size_t(4) << 20;
+
+    std::uint32_t rotate(std::uint32_t x, int n)
+    {
+      return (x >> n) | (x << (32 - n));
+    }
+  }
+
+  std::uint64_t ContentDigest::short_hash() const
+  {
+    std::uint64_t h = 0;
+    for (std::size_t i = 0; i < 8; ++i) {
+      h = (h << 8) | sha256[i];
+    }
+    return h;
+  }
+
+  std::string ContentDigest::hex() const
+  {
+    const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(2 * sha256.size());
+    for (auto byte : sha256) {
+      out += digits[byte >> 4];
+      out += digits[byte & 15];
+    }
+    return out;
+  }
+
+  bool operator==(const ContentDigest& a, const ContentDigest& b)
+  {
+    return a.bytes == b.bytes && a.sha256 == b.sha256;
+  }
+
+  bool operator!=(const ContentDigest& a, const ContentDigest& b)
+  {
+    return !(a == b);
+  }
+
+  ContentHasher::ContentHasher()
+      : state_{{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+                0x1f83d9ab, 0x5be0cd19}}
+      , buffered_(0)
+      , length_(0)
+      , bytes_(0)
+  {
+  }
+
+  void ContentHasher::update(const void* data, std::size_t size)
+  {
+    append(static_cast<const std::uint8_t*>(data), size);
+    bytes_ += size;
+  }
+
+  void ContentHasher::update_parallel(const void* data, std::size_t size, unsigned int threads)
+  {
+    if (size <= chunkSize) {
+      update(data, size);
+      return;
+    }
+    const auto* ptr = static_cast<const std::uint8_t*>(data);
+    const std::size_t chunks = (size + chunkSize - 1) / chunkSize;
+    std::vector<ContentDigest> digests(chunks);
+    parallel_for_blocks(chunks, 1, threads, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i) {
+        ContentHasher chunk;
+        chunk.update(ptr + i * chunkSize, std::min(chunkSize, size - i * chunkSize));
+        digests[i] = chunk.finish();
+      }
+    });
+    for (const auto& digest : digests) {
+      append(digest.sha256.data(), digest.sha256.size());
+    }
+    bytes_ += size;
+  }
+
+  void ContentHasher::update_string(const std::string& str)
+  {
+    update_value(static_cast<std::uint64_t>(str.size()));
+    update(str.data(), str.size());
+  }
+
+  void ContentHasher::update_digest(const ContentDigest& digest)
+  {
+    update(digest.sha256.data(), digest.sha256.size());
+    update_value(digest.bytes);
+  }
+
+  ContentDigest ContentHasher::finish()
+  {
+    const std::uint64_t bits = length_ * 8;
+    const std::uint8_t pad = 0x80;
+    append(&pad, 1);
+    const std::uint8_t zero = 0;
+    while (buffered_ != 56) {
+      append(&zero, 1);
+    }
+    std::uint8_t length[8];
+    for (int i = 0; i < 8; ++i) {
+      length[i] = static_cast<std::uint8_t>(bits >> (56 - 8 * i));
+    }
+    append(length, 8);
+    ContentDigest digest;
+    for (std::size_t i = 0; i < 8; ++i) {
+      for (std::size_t j = 0; j < 4; ++j) {
+        digest.sha256[4 * i + j] = static_cast<std::uint8_t>(state_[i] >> (24 - 8 * j));
+      }
+    }
+    digest.bytes = bytes_;
+    return digest;
+  }
+
+  void ContentHasher::append(const std::uint8_t* data, std::size_t size)
+  {
+    length_ += size;
+    if (buffered_ > 0) {
+      const std::size_t n = std::min(size, buffer_.size() - buffered_);
+      std::memcpy(buffer_.data() + buffered_, data, n);
+      buffered_ += n;
+      data += n;
+      size -= n;
+      if (buffered_ < buffer_.size()) {
+        return;
+      }
+      compress(buffer_.data());
+      buffered_ = 0;
+    }
+    for (; size >= buffer_.size(); data += buffer_.size(), size -= buffer_.size()) {
+      compress(data);
+    }
+    std::memcpy(buffer_.data(), data, size);
+    buffered_ = size;
+  }
+
+  void ContentHasher::compress(const std::uint8_t* block)
+  {
+    std::uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+      w[i] = (std::uint32_t(block[4 * i]) << 24) | (std::uint32_t(block[4 * i + 1]) << 16)
+             | (std::uint32_t(block[4 * i + 2]) << 8) | std::uint32_t(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+      const std::uint32_t s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const std::uint32_t s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    auto s = state_;
+    for (int i = 0; i < 64; ++i) {
+      const std::uint32_t s1 = rotate(s[4], 6) ^ rotate(s[4], 11) ^ rotate(s[4], 25);
+      const std::uint32_t ch = (s[4] & s[5]) ^ (~s[4] & s[6]);
+      const std::uint32_t t1 = s[7] + s1 + ch + roundConstants[i] + w[i];
+      const std::uint32_t s0 = rotate(s[0], 2) ^ rotate(s[0], 13) ^ rotate(s[0], 22);
+      const std::uint32_t maj = (s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]);
+      const std::uint32_t t2 = s0 + maj;
+      s[7] = s[6];
+      s[6] = s[5];
+      s[5] = s[4];
+      s[4] = s[3] + t1;
+      s[3] = s[2];
+      s[2] = s[1];
+      s[1] = s[0];
+      s[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; ++i) {
+      state_[i] += s[i];
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef DUNEURO_MATLAB_CONTENT_DIGEST_HH
+#define DUNEURO_MATLAB_CONTENT_DIGEST_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace duneuro
+{
+  /**
+   * \brief sha-256 digest of some content together with the number of bytes it covers
+   *
+   * used to identify drivers, sensors and stored transfer matrices by their content. Two digests
+   * are only equal if both the hash and the size match. A default constructed digest is empty and
+   * identifies nothing.
+   */
+  struct ContentDigest {
+    std::array<std::uint8_t, 32> sha256 = {};
+    std::uint64_t bytes = 0;
+
+    bool empty() const
+    {
+      return bytes == 0;
+    }
+
+    /** \brief the first 64 bits of the hash, e.g. for hash tables and file names */
+    std::uint64_t short_hash() const;
+
+    /** \brief the hash as 64 hexadecimal digits */
+    std::string hex() const;
+  };
+
+  bool operator==(const ContentDigest& a, const ContentDigest& b);
+  bool operator!=(const ContentDigest& a, const ContentDigest& b);
+
+  struct ContentDigestHash {
+    std::size_t operator()(const ContentDigest& digest) const
+    {
+      return static_cast<std::size_t>(digest.short_hash());
+    }
+  };
+
+  /**
+   * \brief incremental sha-256 of a sequence of byte ranges
+   *
+   * Does not use the mex api.
+   */
+  class ContentHasher
+  {
+  public:
+    ContentHasher();
+
+    void update(const void* data, std::size_t size);
+
+    /**
+     * \brief digest a large range on several threads
+     *
+     * ranges of more than 4MB are split into chunks of 4MB, which are hashed in parallel, and the
+     * hashes of the chunks are appended to the content instead of the chunks. The result only
+     * depends on the data, not on the number of threads.
+     */
+    void update_parallel(const void* data, std::size_t size, unsigned int threads);
+
+    /** \brief append a string prefixed by its size, so that consecutive strings are unambiguous */
+    void update_string(const std::string& str);
+
+    /** \brief append another digest, including its size */
+    void update_digest(const ContentDigest& digest);
+
+    template <class T>
+    void update_value(const T& value)
+    {
+      update(&value, sizeof(value));
+    }
+
+    /** \brief the digest of everything appended so far, the hasher must not be used afterwards */
+    ContentDigest finish();
+
+  private:
+    void append(const std::uint8_t* data, std::size_t size);
+    void compress(const std::uint8_t* block);
+
+    std::array<std::uint32_t, 8> state_;
+    std::array<std::uint8_t, 64> buffer_;
+    std::size_t buffered_;
+    // bytes passed to compress, and bytes of content, which differ for parallel ranges
+    std::uint64_t length_;
+    std::uint64_t bytes_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_CONTENT_DIGEST_HH
@@ -0,0 +1,329 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/driver_cache.hh>
+
+#include <dune/common/exceptions.hh>
+
+namespace duneuro
+{
+  struct DriverCache::SharedDriver {
+    std::unique_ptr<Driver> driver;
+    std::mutex mutex;
+    // digests of the sensors currently set on the driver, empty if unknown
+    ContentDigest electrodes;
+    ContentDigest coils;
+  };
+
+  namespace
+  {
+    /**
+     * session of a shared driver, forwarding every call to it. Sensors set through a session are
+     * not known to the other sessions, see DriverCache::lock.
+     */
+    template <class SharedDriver>
+    class SharedDriverSession : public DriverInterface<3>
+    {
+    public:
+      explicit SharedDriverSession(SharedDriver& shared) : shared_(shared)
+      {
+      }
+
+      std::unique_ptr<Function> makeDomainFunction() const override
+      {
+        return driver().makeDomainFunction();
+      }
+
+      void solveEEGForward(const DipoleType& dipole, Function& solution,
+                           const Dune::ParameterTree& config, DataTree dataTree) override
+      {
+        driver().solveEEGForward(dipole, solution, config, dataTree);
+      }
+
+      std::vector<double> solveMEGForward(const Function& eegSolution,
+                                          const Dune::ParameterTree& config,
+                                          DataTree dataTree) override
+      {
+        return driver().solveMEGForward(eegSolution, config, dataTree);
+      }
+
+      void setElectrodes(const std::vector<CoordinateType>& electrodes,
+                         const Dune::ParameterTree& config) override
+      {
+        shared_.electrodes = ContentDigest();
+        driver().setElectrodes(electrodes, config);
+      }
+
+      std::vector<double> evaluateAtElectrodes(const Function& solution) const override
+      {
+        return driver().evaluateAtElectrodes(solution);
+      }
+
+      void
+      setCoilsAndProjections(const std::vector<CoordinateType>& coils,
+                             const std::vector<std::vector<CoordinateType>>& projections) override
+      {
+        shared_.coils = ContentDigest();
+        driver().setCoilsAndProjections(coils, projections);
+      }
+
+      std::unique_ptr<DenseMatrix<double>>
+      computeEEGTransferMatrix(const Dune::ParameterTree& config, DataTree dataTree) override
+      {
+        return driver().computeEEGTransferMatrix(config, dataTree);
+      }
+
+      std::unique_ptr<DenseMatrix<double>>
+      computeMEGTransferMatrix(const Dune::ParameterTree& config, DataTree dataTree) override
+      {
+        return driver().computeMEGTransferMatrix(config, dataTree);
+      }
+
+      std::vector<std::vector<double>>
+      applyEEGTransfer(const DenseMatrix<double>& transferMatrix,
+                       const std::vector<DipoleType>& dipoles, const Dune::ParameterTree& config,
+                       DataTree dataTree) override
+      {
+        return driver().applyEEGTransfer(transferMatrix, dipoles, config, dataTree);
+      }
+
+      std::vector<std::vector<double>>
+      applyMEGTransfer(const DenseMatrix<double>& transferMatrix,
+                       const std::vector<DipoleType>& dipoles, const Dune::ParameterTree& config,
+                       DataTree dataTree) override
+      {
+        return driver().applyMEGTransfer(transferMatrix, dipoles, config, dataTree);
+      }
+
+      std::vector<CoordinateType> getProjectedElectrodes() const override
+      {
+        return driver().getProjectedElectrodes();
+      }
+
+      void write(const Dune::ParameterTree& config, DataTree dataTree) const override
+      {
+        driver().write(config, dataTree);
+      }
+
+      void print_citations() override
+      {
+        driver().print_citations();
+      }
+
+      std::unique_ptr<VolumeConductorVTKWriterInterface>
+      volumeConductorVTKWriter(const Dune::ParameterTree& config) const override
+      {
+        return driver().volumeConductorVTKWriter(config);
+      }
+
+    private:
+      DriverInterface<3>& driver() const
+      {
+        return *shared_.driver;
+      }
+
+      SharedDriver& shared_;
+    };
+  }
+
+  DriverCache& DriverCache::instance()
+  {
+    static DriverCache cache;
+    return cache;
+  }
+
+  DriverCache::Driver* DriverCache::acquire(const ContentDigest& digest, bool share,
+                                            const Factory& factory)
+  {
+    if (share && digest.empty()) {
+      DUNE_THROW(Dune::Exception, "shared drivers require the digest of their content");
+    }
+    if (share) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (auto shared = find_shared(digest)) {
+        return add_session(digest, std::move(shared));
+      }
+    }
+    // the driver is assembled without holding the lock, as this may take a long time. If another
+    // thread assembled the same shared driver in the meantime, this one is destroyed afterwards
+    auto driver = factory();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (share) {
+      auto shared = find_shared(digest);
+      if (!shared) {
+        shared = std::make_shared<SharedDriver>();
+        shared->driver = std::move(driver);
+        shared_[digest] = shared;
+      }
+      return add_session(digest, std::move(shared));
+    }
+    auto* ptr = driver.get();
+    entries_[ptr] = Entry{std::move(driver), digest, nullptr, Electrodes(), Coils(),
+                          std::make_shared<std::mutex>()};
+    return ptr;
+  }
+
+  bool DriverCache::release(Driver* driver)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(driver);
+    if (it == entries_.end()) {
+      return false;
+    }
+    const auto digest = it->second.digest;
+    const bool shared = it->second.shared != nullptr;
+    entries_.erase(it);
+    if (shared) {
+      auto sharedIt = shared_.find(digest);
+      if (sharedIt != shared_.end() && sharedIt->second.expired()) {
+        shared_.erase(sharedIt);
+      }
+    }
+    return true;
+  }
+
+  std::unique_lock<std::mutex> DriverCache::lock(const Driver* driver)
+  {
+    std::mutex* mutex;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      mutex = entry(driver).mutex.get();
+    }
+    // the registry is not locked while waiting for the driver
+    std::unique_lock<std::mutex> lock(*mutex);
+    restore_session_sensors(driver);
+    return lock;
+  }
+
+  ContentDigest DriverCache::digest(const Driver* driver) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entry(driver).digest;
+  }
+
+  void DriverCache::set_electrodes(Driver* driver, Electrodes electrodes)
+  {
+    set_driver_electrodes(driver, electrodes);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& e = entry(driver);
+    if (e.shared) {
+      e.shared->electrodes = electrodes.digest;
+    }
+    e.electrodes = std::move(electrodes);
+  }
+
+  DriverCache::Electrodes DriverCache::electrodes(const Driver* driver) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entry(driver).electrodes;
+  }
+
+  void DriverCache::set_coils(Driver* driver, Coils coils)
+  {
+    set_driver_coils(driver, coils);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& e = entry(driver);
+    if (e.shared) {
+      e.shared->coils = coils.digest;
+    }
+    e.coils = std::move(coils);
+  }
+
+  DriverCache::Coils DriverCache::coils(const Driver* driver) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entry(driver).coils;
+  }
+
+  void DriverCache::set_driver_electrodes(Driver* driver, const Electrodes& electrodes)
+  {
+    driver->setElectrodes(electrodes.positions, electrodes.config);
+  }
+
+  void DriverCache::set_driver_coils(Driver* driver, const Coils& coils)
+  {
+    if (coils.projections.size() != coils.positions.size() * coils.projectionsPerCoil) {
+      DUNE_THROW(Dune::Exception, "number of projections does not match the number of coils");
+    }
+    std::vector<std::vector<Dune::FieldVector<double, 3>>> projections;
+    projections.reserve(coils.positions.size());
+    for (auto it = coils.projections.begin(); it != coils.projections.end();
+         it += coils.projectionsPerCoil) {
+      projections.emplace_back(it, it + coils.projectionsPerCoil);
+    }
+    driver->setCoilsAndProjections(coils.positions, projections);
+  }
+
+  std::size_t DriverCache::size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+  DriverCache::Entry& DriverCache::entry(const Driver* driver)
+  {
+    auto it = entries_.find(driver);
+    if (it == entries_.end()) {
+      DUNE_THROW(Dune::Exception, "driver is not registered in the driver cache");
+    }
+    return it->second;
+  }
+
+  const DriverCache::Entry& DriverCache::entry(const Driver* driver) const
+  {
+    auto it = entries_.find(driver);
+    if (it == entries_.end()) {
+      DUNE_THROW(Dune::Exception, "driver is not registered in the driver cache");
+    }
+    return it->second;
+  }
+
+  std::shared_ptr<DriverCache::SharedDriver> DriverCache::find_shared(const ContentDigest& digest)
+  {
+    auto it = shared_.find(digest);
+    return it == shared_.end() ? nullptr : it->second.lock();
+  }
+
+  DriverCache::Driver* DriverCache::add_session(const ContentDigest& digest,
+                                                std::shared_ptr<SharedDriver> shared)
+  {
+    auto session = std::make_unique<SharedDriverSession<SharedDriver>>(*shared);
+    auto* ptr = session.get();
+    std::shared_ptr<std::mutex> mutex(shared, &shared->mutex);
+    entries_[ptr] = Entry{std::move(session), digest, std::move(shared), Electrodes(), Coils(),
+                          std::move(mutex)};
+    return ptr;
+  }
+
+  void DriverCache::restore_session_sensors(const Driver* session)
+  {
+    Electrodes electrodes;
+    Coils coils;
+    Driver* driver;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& e = entry(session);
+      if (!e.shared) {
+        return;
+      }
+      driver = e.driver.get();
+      // empty digests are never equal to the digest of the sensors set on the driver
+      if (!e.electrodes.positions.empty()
+          && (e.electrodes.digest.empty() || e.electrodes.digest != e.shared->electrodes)) {
+        electrodes = e.electrodes;
+      }
+      if (!e.coils.positions.empty()
+          && (e.coils.digest.empty() || e.coils.digest != e.shared->coils)) {
+        coils = e.coils;
+      }
+    }
+    // the lock of the driver is held, so the digests of its sensors can not change meanwhile
+    if (!electrodes.positions.empty()) {
+      set_electrodes(driver, std::move(electrodes));
+    }
+    if (!coils.positions.empty()) {
+      set_coils(driver, std::move(coils));
+    }
+  }
+}
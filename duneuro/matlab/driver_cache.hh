@@ -0,0 +1,162 @@
+#ifndef DUNEURO_MATLAB_DRIVER_CACHE_HH
+#define DUNEURO_MATLAB_DRIVER_CACHE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <dune/common/fvector.hh>
+#include <dune/common/parametertree.hh>
+
+#include <duneuro/driver/driver_factory.hh>
+
+#include <duneuro/matlab/content_digest.hh>
+
+namespace duneuro
+{
+  /**
+   * \brief process-wide registry of the drivers handed out to matlab
+   *
+   * Every driver is stored together with the digest of the struct it was created from, if one was
+   * computed. If sharing is requested on creation and a shared driver with the same digest is
+   * alive, its assembled volume conductor and solver are reused instead of assembling new ones.
+   * Every acquisition of a shared driver returns a separate session forwarding to it, which keeps
+   * its own electrodes and coils: lock sets the sensors of the session on the driver again if
+   * another session replaced them. A session which never set sensors sees the ones set last. A
+   * driver is destroyed as soon as its last handle or session is released.
+   *
+   * The registry itself may be accessed from background jobs and is guarded by a mutex. In
+   * addition, every driver has a lock, which every command and background job using the driver
+   * holds while it runs, see lock. The sessions of a shared driver share its lock. Drivers are
+   * thus never used concurrently, and a command on a driver waits for a background job running
+   * on it.
+   */
+  class DriverCache
+  {
+  public:
+    using Driver = DriverInterface<3>;
+    using Factory = std::function<std::unique_ptr<Driver>()>;
+
+    static DriverCache& instance();
+
+    /**
+     * \brief return a driver for the given digest
+     *
+     * if share is true, a new session of the shared driver with the same digest is returned, and
+     * the driver is created using the factory if none exists. Otherwise a new driver is created
+     * using the factory. The digest may be empty for drivers which are not shared.
+     */
+    Driver* acquire(const ContentDigest& digest, bool share, const Factory& factory);
+
+    /**
+     * \brief release a driver or session, destroying the driver if it was the last session
+     *
+     * returns false if the driver is not known to the cache.
+     */
+    bool release(Driver* driver);
+
+    /**
+     * \brief exclusive access to the driver until the returned lock is destroyed
+     *
+     * the lock does not keep the driver alive, the caller has to hold a reference to it, e.g. a
+     * handle, while holding the lock. Shared drivers have a single lock, and the sensors recorded
+     * for the session are set on the driver before the lock is returned.
+     */
+    std::unique_lock<std::mutex> lock(const Driver* driver);
+
+    /** \brief digest of the struct the driver was created from, empty if none was computed */
+    ContentDigest digest(const Driver* driver) const;
+
+    /** \brief electrodes as last set on a driver */
+    struct Electrodes {
+      std::vector<Dune::FieldVector<double, 3>> positions;
+      Dune::ParameterTree config;
+      ContentDigest digest;
+    };
+
+    /**
+     * \brief coils and projections as last set on a driver
+     *
+     * every coil has the same number of projections. They are stored in a single flat array, the
+     * projections of coil i are projections[i * projectionsPerCoil, (i + 1) * projectionsPerCoil).
+     */
+    struct Coils {
+      std::vector<Dune::FieldVector<double, 3>> positions;
+      std::vector<Dune::FieldVector<double, 3>> projections;
+      std::size_t projectionsPerCoil = 0;
+      ContentDigest digest;
+    };
+
+    /** \brief set the electrodes on the driver and record them together with their digest */
+    void set_electrodes(Driver* driver, Electrodes electrodes);
+
+    /**
+     * \brief copy of the electrodes set on the driver, empty if none are set
+     *
+     * returned by value, as jobs on the driver may replace them at any time.
+     */
+    Electrodes electrodes(const Driver* driver) const;
+
+    /**
+     * \brief set the coils and projections on the driver and record them with their digest
+     *
+     * the driver expects the projections grouped by coil, so a nested copy of them only exists
+     * while they are passed to the driver.
+     */
+    void set_coils(Driver* driver, Coils coils);
+
+    /** \brief copy of the coils and projections set on the driver, empty if none are set */
+    Coils coils(const Driver* driver) const;
+
+    /**
+     * \brief set electrodes on the driver without recording them
+     *
+     * used to work on a subset of the recorded electrodes for a while. The caller has to hold the
+     * lock of the driver and to set the recorded electrodes again afterwards.
+     */
+    static void set_driver_electrodes(Driver* driver, const Electrodes& electrodes);
+
+    /** \brief set coils and projections on the driver without recording them, see above */
+    static void set_driver_coils(Driver* driver, const Coils& coils);
+
+    /** \brief number of drivers and sessions of shared drivers currently alive */
+    std::size_t size() const;
+
+  private:
+    DriverCache() = default;
+
+    // a driver shared by several sessions, defined in the implementation
+    struct SharedDriver;
+
+    struct Entry {
+      // the driver itself, or the session forwarding to the shared driver
+      std::unique_ptr<Driver> driver;
+      ContentDigest digest;
+      std::shared_ptr<SharedDriver> shared;
+      Electrodes electrodes;
+      Coils coils;
+      // held by the users of the driver, see lock
+      std::shared_ptr<std::mutex> mutex;
+    };
+
+    Entry& entry(const Driver* driver);
+    const Entry& entry(const Driver* driver) const;
+    // the shared driver with the given digest, nullptr if none is alive
+    std::shared_ptr<SharedDriver> find_shared(const ContentDigest& digest);
+    // register a new session of a shared driver
+    Driver* add_session(const ContentDigest& digest, std::shared_ptr<SharedDriver> shared);
+    // set the recorded sensors of a session on its shared driver if another session replaced them
+    void restore_session_sensors(const Driver* session);
+
+    std::unordered_map<const Driver*, Entry> entries_;
+    // the full digest is compared on lookup, not only its hash
+    std::unordered_map<ContentDigest, std::weak_ptr<SharedDriver>, ContentDigestHash> shared_;
+    mutable std::mutex mutex_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_DRIVER_CACHE_HH
@@ -0,0 +1,206 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/handle_registry.hh>
+
+#include <dune/common/exceptions.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    // layout of a handle: 8 bits type, 24 bits generation, 32 bits slot
+    constexpr std::uint32_t generationMask = 0xffffff;
+
+    // innermost recording of the current thread
+    thread_local HandleRecording* currentRecording = nullptr;
+  }
+
+  const char* handle_type_name(HandleType type)
+  {
+    switch (type) {
+    case HandleType::future: return "future";
+    case HandleType::point_writer: return "point_writer";
+    case HandleType::volume_writer: return "volume_writer";
+    case HandleType::series_writer: return "series_writer";
+    case HandleType::function: return "function";
+    case HandleType::transfer_matrix: return "transfer_matrix";
+    case HandleType::driver: return "driver";
+    case HandleType::config: return "config";
+    default: return "none";
+    }
+  }
+
+  HandleRegistry& HandleRegistry::instance()
+  {
+    static HandleRegistry registry;
+    return registry;
+  }
+
+  HandleRegistry::Handle HandleRegistry::insert(HandleType type, void* object, Deleter deleter)
+  {
+    if (type == HandleType::none || !object) {
+      DUNE_THROW(Dune::Exception, "can not register an empty object");
+    }
+    // the deleter is called if the shared state can not be allocated
+    std::shared_ptr<void> shared(object, deleter);
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uint32_t index;
+    if (freeSlots_.empty()) {
+      if (slots_.size() >= 0xffffffffu) {
+        DUNE_THROW(Dune::Exception, "too many handles");
+      }
+      index = slots_.size();
+      slots_.emplace_back();
+    } else {
+      index = freeSlots_.back();
+      freeSlots_.pop_back();
+    }
+    auto& slot = slots_[index];
+    slot.object = std::move(shared);
+    slot.type = type;
+    ++size_;
+    const Handle handle = encode(type, slot.generation, index);
+    for (auto* recording = currentRecording; recording; recording = recording->outer_) {
+      recording->handles_.push_back(handle);
+    }
+    return handle;
+  }
+
+  void* HandleRegistry::find(Handle handle, HandleType type) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Slot* slot = live_slot(handle);
+    return slot && slot->type == type ? slot->object.get() : nullptr;
+  }
+
+  std::shared_ptr<void> HandleRegistry::share(Handle handle, HandleType type) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Slot* slot = live_slot(handle);
+    return slot && slot->type == type ? slot->object : nullptr;
+  }
+
+  HandleType HandleRegistry::type(Handle handle) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Slot* slot = live_slot(handle);
+    return slot ? slot->type : HandleType::none;
+  }
+
+  HandleType HandleRegistry::encoded_type(Handle handle)
+  {
+    const auto type = static_cast<std::uint8_t>(handle >> 56);
+    return type < numberOfHandleTypes ? static_cast<HandleType>(type) : HandleType::none;
+  }
+
+  bool HandleRegistry::release(Handle handle)
+  {
+    std::shared_ptr<void> object;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!live_slot(handle)) {
+        return false;
+      }
+      object = free_slot(static_cast<std::uint32_t>(handle));
+    }
+    // destroys the object outside the lock, unless it is still shared by a job
+    object.reset();
+    return true;
+  }
+
+  std::size_t HandleRegistry::release_all()
+  {
+    std::vector<std::shared_ptr<void>> objects;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      objects.reserve(size_);
+      for (std::size_t t = 1; t < numberOfHandleTypes; ++t) {
+        for (std::uint32_t i = 0; i < slots_.size(); ++i) {
+          if (slots_[i].object && slots_[i].type == static_cast<HandleType>(t)) {
+            objects.push_back(free_slot(i));
+          }
+        }
+      }
+    }
+    const std::size_t released = objects.size();
+    for (auto& object : objects) {
+      object.reset();
+    }
+    return released;
+  }
+
+  std::vector<HandleRegistry::Handle> HandleRegistry::handles(HandleType type) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Handle> out;
+    for (std::uint32_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i].object && slots_[i].type == type) {
+        out.push_back(encode(type, slots_[i].generation, i));
+      }
+    }
+    return out;
+  }
+
+  std::size_t HandleRegistry::size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+  }
+
+  HandleRegistry::Handle HandleRegistry::encode(HandleType type, std::uint32_t generation,
+                                                std::uint32_t slot)
+  {
+    return (static_cast<Handle>(type) << 56)
+           | (static_cast<Handle>(generation & generationMask) << 32) | slot;
+  }
+
+  const HandleRegistry::Slot* HandleRegistry::live_slot(Handle handle) const
+  {
+    const auto index = static_cast<std::uint32_t>(handle);
+    if (index >= slots_.size()) {
+      return nullptr;
+    }
+    const Slot& slot = slots_[index];
+    if (!slot.object || encode(slot.type, slot.generation, index) != handle) {
+      return nullptr;
+    }
+    return &slot;
+  }
+
+  std::shared_ptr<void> HandleRegistry::free_slot(std::uint32_t index)
+  {
+    Slot& slot = slots_[index];
+    std::shared_ptr<void> object;
+    object.swap(slot.object);
+    slot.type = HandleType::none;
+    // generation 0 is skipped, so that no valid handle of slot 0 is equal to 0
+    slot.generation = (slot.generation + 1) & generationMask;
+    if (slot.generation == 0) {
+      slot.generation = 1;
+    }
+    freeSlots_.push_back(index);
+    --size_;
+    return object;
+  }
+
+  HandleRecording::HandleRecording() : outer_(currentRecording)
+  {
+    currentRecording = this;
+  }
+
+  HandleRecording::~HandleRecording()
+  {
+    currentRecording = outer_;
+  }
+
+  void HandleRecording::release_all()
+  {
+    // handles released in the meantime are stale and skipped by release
+    for (auto handle : handles_) {
+      HandleRegistry::instance().release(handle);
+    }
+    handles_.clear();
+  }
+}
@@ -0,0 +1,210 @@
+#ifndef DUNEURO_MATLAB_HANDLE_REGISTRY_HH
+#define DUNEURO_MATLAB_HANDLE_REGISTRY_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <dune/common/parametertree.hh>
+
+#include <duneuro/driver/driver_factory.hh>
+#include <duneuro/io/point_vtk_writer.hh>
+#include <duneuro/io/volume_conductor_vtk_writer.hh>
+
+#include <duneuro/matlab/async.hh>
+#include <duneuro/matlab/transfer_matrix_store.hh>
+#include <duneuro/matlab/vtu_series_writer.hh>
+
+namespace duneuro
+{
+  /** \brief kinds of objects handed out to matlab, in the order they are released in bulk */
+  enum class HandleType : std::uint8_t {
+    none = 0,
+    future,
+    point_writer,
+    volume_writer,
+    series_writer,
+    function,
+    transfer_matrix,
+    driver,
+    config
+  };
+
+  constexpr std::size_t numberOfHandleTypes = 9;
+
+  /** \brief name of the handle type as reported to matlab */
+  const char* handle_type_name(HandleType type);
+
+  /** \brief maps the c++ type of an object to its handle type */
+  template <class T>
+  struct HandleTraits;
+
+  template <>
+  struct HandleTraits<AsyncFuture> {
+    static constexpr HandleType type = HandleType::future;
+  };
+
+  template <>
+  struct HandleTraits<PointVTKWriter<double, 3>> {
+    static constexpr HandleType type = HandleType::point_writer;
+  };
+
+  template <>
+  struct HandleTraits<VolumeConductorVTKWriterInterface> {
+    static constexpr HandleType type = HandleType::volume_writer;
+  };
+
+  template <>
+  struct HandleTraits<VTUSeriesWriter> {
+    static constexpr HandleType type = HandleType::series_writer;
+  };
+
+  template <>
+  struct HandleTraits<Function> {
+    static constexpr HandleType type = HandleType::function;
+  };
+
+  template <>
+  struct HandleTraits<MappedTransferMatrix> {
+    static constexpr HandleType type = HandleType::transfer_matrix;
+  };
+
+  template <>
+  struct HandleTraits<DriverInterface<3>> {
+    static constexpr HandleType type = HandleType::driver;
+  };
+
+  template <>
+  struct HandleTraits<Dune::ParameterTree> {
+    static constexpr HandleType type = HandleType::config;
+  };
+
+  /**
+   * \brief process-wide registry of the objects handed out to matlab
+   *
+   * A handle encodes the type of the object, the slot it is stored in and the generation of that
+   * slot. The generation is incremented whenever a slot is freed, so stale handles and handles of
+   * the wrong type are detected in O(1) instead of dereferencing a dangling pointer.
+   *
+   * Objects are destroyed by the deleter given on insertion, which allows registering objects
+   * whose lifetime is managed elsewhere, e.g. drivers of the DriverCache. Deleters are called
+   * without holding the lock of the registry.
+   *
+   * Background jobs keep the objects they use alive with share. Releasing a handle invalidates it
+   * immediately, but its object is only destroyed once the last shared reference is dropped.
+   */
+  class HandleRegistry
+  {
+  public:
+    using Handle = std::uint64_t;
+    using Deleter = void (*)(void*);
+
+    static HandleRegistry& instance();
+
+    Handle insert(HandleType type, void* object, Deleter deleter);
+
+    template <class T>
+    Handle insert(std::unique_ptr<T> object)
+    {
+      return insert(HandleTraits<T>::type, object.release(),
+                    [](void* ptr) { delete static_cast<T*>(ptr); });
+    }
+
+    /** \brief the object of a live handle of the given type, nullptr otherwise */
+    void* find(Handle handle, HandleType type) const;
+
+    template <class T>
+    T* find(Handle handle) const
+    {
+      return static_cast<T*>(find(handle, HandleTraits<T>::type));
+    }
+
+    /** \brief shared reference to the object of a live handle, nullptr otherwise */
+    std::shared_ptr<void> share(Handle handle, HandleType type) const;
+
+    template <class T>
+    std::shared_ptr<T> share(Handle handle) const
+    {
+      return std::static_pointer_cast<T>(share(handle, HandleTraits<T>::type));
+    }
+
+    /** \brief type of a live handle, HandleType::none for stale or invalid handles */
+    HandleType type(Handle handle) const;
+
+    /** \brief type encoded in the handle, regardless of whether it is still alive */
+    static HandleType encoded_type(Handle handle);
+
+    /** \brief destroy the object of the handle, returns false if the handle is not alive */
+    bool release(Handle handle);
+
+    /**
+     * \brief destroy all objects, returns the number of released handles
+     *
+     * objects are released grouped by their type in the order of HandleType, so that e.g. futures
+     * are stopped before the drivers they use are destroyed.
+     */
+    std::size_t release_all();
+
+    /** \brief all live handles of the given type */
+    std::vector<Handle> handles(HandleType type) const;
+
+    /** \brief number of live handles */
+    std::size_t size() const;
+
+  private:
+    HandleRegistry() = default;
+
+    struct Slot {
+      std::shared_ptr<void> object;
+      HandleType type = HandleType::none;
+      std::uint32_t generation = 1;
+    };
+
+    static Handle encode(HandleType type, std::uint32_t generation, std::uint32_t slot);
+    // slot of a live handle, nullptr otherwise. requires the lock to be held
+    const Slot* live_slot(Handle handle) const;
+    // take the object out of the slot and free it. requires the lock to be held
+    std::shared_ptr<void> free_slot(std::uint32_t index);
+
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> freeSlots_;
+    std::size_t size_ = 0;
+    mutable std::mutex mutex_;
+  };
+
+  /**
+   * \brief records the handles inserted by the current thread while it is alive
+   *
+   * Recordings may be nested, handles are recorded by all recordings of the thread. Used to
+   * release the handles created by the entries of a batch that failed later on, and by the server
+   * to find the handles created by the commands of a client.
+   */
+  class HandleRecording
+  {
+  public:
+    HandleRecording();
+    ~HandleRecording();
+
+    HandleRecording(const HandleRecording&) = delete;
+    HandleRecording& operator=(const HandleRecording&) = delete;
+
+    /** \brief release all recorded handles which are still alive */
+    void release_all();
+
+    /** \brief the recorded handles, including the ones released in the meantime */
+    const std::vector<HandleRegistry::Handle>& handles() const
+    {
+      return handles_;
+    }
+
+  private:
+    friend class HandleRegistry;
+
+    HandleRecording* outer_;
+    std::vector<HandleRegistry::Handle> handles_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_HANDLE_REGISTRY_HH
@@ -0,0 +1,62 @@
+#ifndef DUNEURO_MATLAB_INDEX_VALIDATION_HH
+#define DUNEURO_MATLAB_INDEX_VALIDATION_HH
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace duneuro
+{
+  // validity of a single index entry, i.e. a non-negative integral value below bound
+  inline bool valid_index(std::uint64_t v, std::size_t bound)
+  {
+    return v < bound;
+  }
+  inline bool valid_index(std::int64_t v, std::size_t bound)
+  {
+    return v >= 0 && static_cast<std::uint64_t>(v) < bound;
+  }
+  inline bool valid_index(std::uint32_t v, std::size_t bound)
+  {
+    return v < bound;
+  }
+  inline bool valid_index(std::int32_t v, std::size_t bound)
+  {
+    return v >= 0 && static_cast<std::uint64_t>(v) < bound;
+  }
+  inline bool valid_index(double v, std::size_t bound)
+  {
+    return v >= 0.0 && v < static_cast<double>(bound) && v == std::floor(v);
+  }
+
+  /**
+   * \brief find the position of the first invalid entry in a flat index array
+   *
+   * The array is scanned in blocks without early exit, so that the check within a block can be
+   * vectorized. Only a block containing an invalid entry is searched again. Returns n if all
+   * entries are valid.
+   */
+  template <class T>
+  std::size_t find_first_invalid_index(const T* ptr, std::size_t n, std::size_t bound)
+  {
+    const std::size_t blockSize = 4096;
+    for (std::size_t begin = 0; begin < n; begin += blockSize) {
+      const std::size_t end = std::min(n, begin + blockSize);
+      bool valid = true;
+      for (std::size_t i = begin; i < end; ++i) {
+        valid &= valid_index(ptr[i], bound);
+      }
+      if (!valid) {
+        for (std::size_t i = begin; i < end; ++i) {
+          if (!valid_index(ptr[i], bound)) {
+            return i;
+          }
+        }
+      }
+    }
+    return n;
+  }
+}
+
+#endif // DUNEURO_MATLAB_INDEX_VALIDATION_HH
@@ -0,0 +1,36 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/mesh_conversion.hh>
+
+namespace duneuro
+{
+  void convert_nodes(const double* ptr, std::size_t count, FittedDriverData<3>& data,
+                     unsigned int threads)
+  {
+    data.nodes.resize(count);
+    parallel_for_blocks(count, 1 << 16, threads, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i) {
+        std::copy(ptr + 3 * i, ptr + 3 * (i + 1), data.nodes[i].begin());
+      }
+    });
+  }
+
+  void convert_tensors(const double* ptr, std::size_t count, FittedDriverData<3>& data,
+                       unsigned int threads)
+  {
+    data.tensors.resize(count);
+    parallel_for_blocks(count, 1 << 14, threads, [&](std::size_t begin, std::size_t end) {
+      const double* t = ptr + 9 * begin;
+      for (std::size_t i = begin; i < end; ++i, t += 9) {
+        auto& m = data.tensors[i];
+        for (int c = 0; c < 3; ++c) {
+          for (int r = 0; r < 3; ++r) {
+            m[r][c] = t[3 * c + r];
+          }
+        }
+      }
+    });
+  }
+}
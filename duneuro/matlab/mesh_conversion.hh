@@ -0,0 +1,135 @@
+#ifndef DUNEURO_MATLAB_MESH_CONVERSION_HH
+#define DUNEURO_MATLAB_MESH_CONVERSION_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#include <duneuro/common/fitted_driver_data.hh>
+
+#include <duneuro/matlab/index_validation.hh>
+#include <duneuro/matlab/parallel.hh>
+
+/*
+ * Conversion of the flat mesh arrays of the volume_conductor struct or a mesh file into
+ * FittedDriverData. Every stage is partitioned into blocks which are processed on several threads.
+ * The index arrays are validated and converted in the same pass. Invalid entries do not throw,
+ * instead the lowest invalid position is returned, so that the result does not depend on the
+ * scheduling of the blocks and the caller can report it in its own way.
+ *
+ * None of the functions use the mex api.
+ */
+
+namespace duneuro
+{
+  /**
+   * \brief lowest position reported by any thread
+   *
+   * blocks starting behind an already reported position can be skipped, as they cannot contain a
+   * lower one.
+   */
+  class FirstPosition
+  {
+  public:
+    explicit FirstPosition(std::size_t none) : position_(none)
+    {
+    }
+
+    void report(std::size_t position)
+    {
+      auto current = position_.load();
+      while (position < current && !position_.compare_exchange_weak(current, position)) {
+      }
+    }
+
+    bool before(std::size_t position) const
+    {
+      return position_.load(std::memory_order_relaxed) < position;
+    }
+
+    std::size_t get() const
+    {
+      return position_.load();
+    }
+
+  private:
+    std::atomic<std::size_t> position_;
+  };
+
+  /** \brief copy 3 x count column major coordinates into data.nodes */
+  void convert_nodes(const double* ptr, std::size_t count, FittedDriverData<3>& data,
+                     unsigned int threads);
+
+  /** \brief copy 9 x count column major tensors, each in column major order, into data.tensors */
+  void convert_tensors(const double* ptr, std::size_t count, FittedDriverData<3>& data,
+                       unsigned int threads);
+
+  /**
+   * \brief validate and convert a rows x cols column major array of node indices to data.elements
+   *
+   * returns the position of the first index that is not below the number of nodes in data, or
+   * rows * cols if all are valid. data.nodes has to be set before.
+   */
+  template <class T>
+  std::size_t convert_elements(const T* ptr, std::size_t rows, std::size_t cols,
+                               FittedDriverData<3>& data, unsigned int threads)
+  {
+    using Index = typename std::decay_t<decltype(data.elements)>::value_type::value_type;
+    const std::size_t n = rows * cols;
+    const std::size_t nodes = data.nodes.size();
+    FirstPosition first(n);
+    // the index vectors are allocated by the threads converting them
+    data.elements.clear();
+    data.elements.resize(cols);
+    parallel_for_blocks(cols, 1 << 14, threads, [&](std::size_t begin, std::size_t end) {
+      if (first.before(begin * rows)) {
+        return;
+      }
+      const T* block = ptr + begin * rows;
+      const std::size_t invalid = find_first_invalid_index(block, (end - begin) * rows, nodes);
+      if (invalid != (end - begin) * rows) {
+        first.report(begin * rows + invalid);
+        return;
+      }
+      for (std::size_t i = begin; i < end; ++i, block += rows) {
+        auto& element = data.elements[i];
+        element.resize(rows);
+        std::transform(block, block + rows, element.begin(),
+                       [](T v) { return static_cast<Index>(v); });
+      }
+    });
+    return first.get();
+  }
+
+  /**
+   * \brief validate and convert n labels into data.labels
+   *
+   * returns the position of the first label that is not a non-negative integer, or n.
+   */
+  template <class T>
+  std::size_t convert_labels(const T* ptr, std::size_t n, FittedDriverData<3>& data,
+                             unsigned int threads)
+  {
+    using Label = typename std::decay_t<decltype(data.labels)>::value_type;
+    FirstPosition first(n);
+    data.labels.resize(n);
+    parallel_for_blocks(n, 1 << 16, threads, [&](std::size_t begin, std::size_t end) {
+      if (first.before(begin)) {
+        return;
+      }
+      const std::size_t invalid =
+          find_first_invalid_index(ptr + begin, end - begin, std::numeric_limits<Label>::max());
+      if (invalid != end - begin) {
+        first.report(begin + invalid);
+        return;
+      }
+      std::transform(ptr + begin, ptr + end, data.labels.begin() + begin,
+                     [](T v) { return static_cast<Label>(v); });
+    });
+    return first.get();
+  }
+}
+
+#endif // DUNEURO_MATLAB_MESH_CONVERSION_HH
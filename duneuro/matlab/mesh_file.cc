@@ -0,0 +1,194 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/mesh_file.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/mesh_conversion.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    const char meshFileMagic[8] = {'D', 'U', 'N', 'E', 'U', 'R', 'M', 'S'};
+    const std::uint64_t meshFileVersion = 1;
+
+    // the header is padded to 128 bytes, so that the node coordinates are aligned
+    struct MeshFileHeader {
+      char magic[8];
+      std::uint64_t version;
+      std::uint64_t nodes;
+      std::uint64_t elements;
+      std::uint64_t cornersPerElement;
+      std::uint64_t indexBytes;
+      std::uint64_t labels;
+      std::uint64_t conductivities;
+      std::uint64_t tensors;
+      std::uint64_t reserved[7];
+    };
+    static_assert(sizeof(MeshFileHeader) == 128, "unexpected header size");
+
+    // read-only mapping of a whole file, unmapped on destruction
+    class FileMapping
+    {
+    public:
+      explicit FileMapping(const std::string& filename) : data_(nullptr), size_(0)
+      {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+          DUNE_THROW(Dune::IOError, "could not open mesh file \"" << filename << "\": "
+                                                                  << std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0
+            || static_cast<std::size_t>(st.st_size) < sizeof(MeshFileHeader)) {
+          ::close(fd);
+          DUNE_THROW(Dune::IOError, "mesh file \"" << filename << "\" is truncated");
+        }
+        size_ = st.st_size;
+        void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+          DUNE_THROW(Dune::IOError, "could not map mesh file \"" << filename << "\": "
+                                                                 << std::strerror(errno));
+        }
+        data_ = static_cast<const char*>(mapping);
+        // the sections are converted front to back
+        ::madvise(mapping, size_, MADV_SEQUENTIAL);
+      }
+
+      ~FileMapping()
+      {
+        ::munmap(const_cast<char*>(data_), size_);
+      }
+
+      FileMapping(const FileMapping&) = delete;
+      FileMapping& operator=(const FileMapping&) = delete;
+
+      const char* data() const
+      {
+        return data_;
+      }
+
+      std::size_t size() const
+      {
+        return size_;
+      }
+
+      // drop the pages of a converted range from the address space
+      void release(const char* begin, std::size_t bytes) const
+      {
+        const std::uintptr_t page = ::sysconf(_SC_PAGESIZE);
+        const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(begin) / page * page;
+        const std::uintptr_t last = reinterpret_cast<std::uintptr_t>(begin) + bytes;
+        ::madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+      }
+
+    private:
+      const char* data_;
+      std::size_t size_;
+    };
+
+    std::uint64_t padded(std::uint64_t bytes)
+    {
+      return (bytes + 7) / 8 * 8;
+    }
+
+    // size of the file described by the header in bytes, or 0 if it is invalid
+    std::uint64_t expected_size(const MeshFileHeader& h)
+    {
+      if (h.indexBytes != 4 && h.indexBytes != 8) {
+        return 0;
+      }
+      const std::uint64_t limit = std::uint64_t(1) << 56;
+      for (auto c : {h.nodes, h.elements, h.cornersPerElement, h.labels, h.conductivities,
+                     h.tensors}) {
+        if (c >= limit) {
+          return 0;
+        }
+      }
+      if (h.cornersPerElement > 0 && h.elements > limit / h.cornersPerElement) {
+        return 0;
+      }
+      return sizeof(MeshFileHeader) + 3 * h.nodes * sizeof(double)
+             + padded((h.elements * h.cornersPerElement + h.labels) * h.indexBytes)
+             + (h.conductivities + 9 * h.tensors) * sizeof(double);
+    }
+
+    template <class T>
+    void convert_indices(const T* ptr, const MeshFileHeader& header, const std::string& filename,
+                         FittedDriverData<3>& data, unsigned int threads)
+    {
+      const std::size_t rows = header.cornersPerElement;
+      auto first = convert_elements(ptr, rows, header.elements, data, threads);
+      if (first != rows * header.elements) {
+        DUNE_THROW(Dune::IOError, "mesh file \"" << filename << "\": node index " << ptr[first]
+                                                 << " of element " << first / rows
+                                                 << " out of bounds (" << header.nodes << ")");
+      }
+      // labels are unsigned and always valid
+      convert_labels(ptr + rows * header.elements, header.labels, data, threads);
+    }
+  }
+
+  void read_mesh_file(const std::string& filename, FittedDriverData<3>& data,
+                      unsigned int threads)
+  {
+    ScopedPhase phase("read_mesh_file");
+    FileMapping file(filename);
+    MeshFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, meshFileMagic, sizeof(meshFileMagic)) != 0) {
+      DUNE_THROW(Dune::IOError, "\"" << filename << "\" is not a mesh file");
+    }
+    if (header.version != meshFileVersion) {
+      DUNE_THROW(Dune::IOError, "mesh file \"" << filename << "\" has version " << header.version
+                                               << ", expected " << meshFileVersion);
+    }
+    if (expected_size(header) != file.size()) {
+      DUNE_THROW(Dune::IOError, "mesh file \"" << filename << "\" is invalid");
+    }
+    if (header.labels != 0 && header.labels != header.elements) {
+      DUNE_THROW(Dune::IOError, "mesh file \"" << filename << "\": number of labels ("
+                                               << header.labels << ") and number of elements ("
+                                               << header.elements << ") do not match");
+    }
+    phase.add_bytes(file.size());
+    const char* ptr = file.data() + sizeof(MeshFileHeader);
+
+    // the mapping is page aligned and all sections before the doubles are multiples of 8 bytes
+    const double* nodePtr = reinterpret_cast<const double*>(ptr);
+    convert_nodes(nodePtr, header.nodes, data, threads);
+    file.release(ptr, 3 * header.nodes * sizeof(double));
+    ptr += 3 * header.nodes * sizeof(double);
+
+    const std::size_t elementBytes = header.elements * header.cornersPerElement * header.indexBytes;
+    if (header.indexBytes == 4) {
+      convert_indices(reinterpret_cast<const std::uint32_t*>(ptr), header, filename, data, threads);
+    } else {
+      convert_indices(reinterpret_cast<const std::uint64_t*>(ptr), header, filename, data, threads);
+    }
+    const std::size_t indexBytes = padded(elementBytes + header.labels * header.indexBytes);
+    file.release(ptr, indexBytes);
+    ptr += indexBytes;
+
+    const double* cptr = reinterpret_cast<const double*>(ptr);
+    data.conductivities.assign(cptr, cptr + header.conductivities);
+    ptr += header.conductivities * sizeof(double);
+
+    convert_tensors(reinterpret_cast<const double*>(ptr), header.tensors, data, threads);
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef DUNEURO_MATLAB_MESH_FILE_HH
+#define DUNEURO_MATLAB_MESH_FILE_HH
+
+#include <string>
+
+#include <duneuro/common/fitted_driver_data.hh>
+
+#include <duneuro/matlab/parallel.hh>
+
+namespace duneuro
+{
+  /**
+   * \brief read a binary mesh file into the driver data
+   *
+   * The file consists of a 128 byte header (magic "DUNEURMS", version, number of nodes, elements,
+   * corners per element, bytes per index, labels, conductivities and tensors, all as uint64)
+   * followed by the sections in native byte order:
+   *   nodes: 3 x nodes doubles
+   *   elements: corners x elements indices of 4 or 8 bytes, zero based
+   *   labels: labels indices, then zero padding to a multiple of 8 bytes
+   *   conductivities: doubles
+   *   tensors: 9 x tensors doubles, each tensor in column major order
+   * i.e. the arrays of the volume_conductor struct accepted by create_driver. The file is memory
+   * mapped and converted section by section on threads threads, validating the indices on the
+   * way. Pages of a section are released once it is converted, so the file does not stay resident.
+   *
+   * Does not use the mex api.
+   */
+  void read_mesh_file(const std::string& filename, FittedDriverData<3>& data,
+                      unsigned int threads = default_number_of_threads());
+}
+
+#endif // DUNEURO_MATLAB_MESH_FILE_HH
@@ -0,0 +1,74 @@
+#ifndef DUNEURO_MATLAB_PARALLEL_HH
+#define DUNEURO_MATLAB_PARALLEL_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace duneuro
+{
+  /**
+   * \brief number of threads to use if the configuration does not specify it
+   */
+  inline unsigned int default_number_of_threads()
+  {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  /**
+   * \brief apply f(begin, end) to all blocks of the range [0, n) using a number of threads
+   *
+   * blocks are handed out dynamically, so that threads which finish early take over remaining
+   * blocks. If f throws, no further blocks are started and the exception of the failed block with
+   * the lowest index is rethrown on the calling thread. Note that f must not call any mex* or mx*
+   * functions, as matlab only allows these on its own thread.
+   */
+  template <class F>
+  void parallel_for_blocks(std::size_t n, std::size_t blockSize, unsigned int threads, F&& f)
+  {
+    blockSize = std::max<std::size_t>(blockSize, 1);
+    const std::size_t blocks = (n + blockSize - 1) / blockSize;
+    threads = std::max(1u, std::min<unsigned int>(threads, blocks));
+    std::atomic<std::size_t> nextBlock(0);
+    std::atomic<bool> failed(false);
+    std::mutex errorMutex;
+    std::size_t errorBlock = blocks;
+    std::exception_ptr error;
+    auto work = [&]() {
+      while (!failed) {
+        const std::size_t block = nextBlock++;
+        if (block >= blocks) {
+          break;
+        }
+        try {
+          const std::size_t begin = block * blockSize;
+          f(begin, std::min(n, begin + blockSize));
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(errorMutex);
+          if (block < errorBlock) {
+            errorBlock = block;
+            error = std::current_exception();
+          }
+          failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads; ++i) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (auto& w : workers) {
+      w.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+#endif // DUNEURO_MATLAB_PARALLEL_HH
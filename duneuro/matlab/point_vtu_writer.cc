@@ -0,0 +1,146 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/point_vtu_writer.hh>
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <sstream>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/parallel.hh>
+#include <duneuro/matlab/vtk_encoding.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    constexpr std::uint8_t vtkVertex = 1;
+
+    void data_array(std::stringstream& sstr, const PointDataArray& array, std::size_t offset)
+    {
+      sstr << "        <DataArray type=\"Float64\" Name=\"" << vtk_xml_escape(array.name)
+           << "\" NumberOfComponents=\"" << array.components << "\" format=\"appended\" offset=\""
+           << offset << "\"/>\n";
+    }
+  }
+
+  void write_point_vtu(const std::string& filename, const double* points, std::size_t count,
+                       const std::vector<PointDataArray>& arrays, const std::vector<double>& times,
+                       const Dune::ParameterTree& config)
+  {
+    const bool compress = config.get<bool>("compress", vtk_compression_available());
+    const int level = config.get<int>("compression_level", 1);
+    if (compress && !vtk_compression_available()) {
+      DUNE_THROW(Dune::Exception, "compressed output requires duneuro-matlab built with zlib");
+    }
+    if (level < 1 || level > 9) {
+      DUNE_THROW(Dune::Exception, "compression_level has to be between 1 and 9");
+    }
+    std::size_t steps = 1;
+    for (const auto& array : arrays) {
+      if (array.steps != 1 && steps != 1 && array.steps != steps) {
+        DUNE_THROW(Dune::Exception, "array \"" << array.name << "\" has " << array.steps
+                                               << " steps, expected 1 or " << steps);
+      }
+      steps = std::max(steps, array.steps);
+    }
+    if (!times.empty() && times.size() != steps) {
+      DUNE_THROW(Dune::Exception, "expected one time per step, got " << times.size()
+                                                                      << " times for " << steps
+                                                                      << " steps");
+    }
+    auto encode = [&](const void* data, std::size_t bytes) {
+      return encode_vtk_array(data, bytes, compress, level);
+    };
+    ScopedPhase phase("write_point_vtu", 3 * count * sizeof(double));
+    // everything shared by all steps is encoded once: the points, the vertex cells and the arrays
+    // with a single step. The encoded arrays are appended in this order after the step arrays.
+    std::vector<std::string> shared;
+    shared.push_back(encode(points, 3 * count * sizeof(double)));
+    {
+      std::vector<std::int64_t> connectivity(count);
+      std::iota(connectivity.begin(), connectivity.end(), 0);
+      shared.push_back(encode(connectivity.data(), count * sizeof(std::int64_t)));
+      std::iota(connectivity.begin(), connectivity.end(), 1);
+      shared.push_back(encode(connectivity.data(), count * sizeof(std::int64_t)));
+      std::vector<std::uint8_t> types(count, vtkVertex);
+      shared.push_back(encode(types.data(), count));
+    }
+    for (const auto& array : arrays) {
+      phase.add_bytes(array.steps * array.components * count * sizeof(double));
+      if (array.steps == 1) {
+        shared.push_back(encode(array.data, array.components * count * sizeof(double)));
+      }
+    }
+    const std::string basename = filename.substr(filename.find_last_of('/') + 1);
+    auto file_of = [&](const std::string& name, std::size_t step) {
+      return steps == 1 ? name + ".vtu" : vtk_step_name(name, step) + ".vtu";
+    };
+    parallel_for_blocks(
+        steps, 1, config.get<unsigned int>("threads", default_number_of_threads()),
+        [&](std::size_t begin, std::size_t end) {
+          for (std::size_t step = begin; step < end; ++step) {
+            std::vector<std::string> own;
+            for (const auto& array : arrays) {
+              if (array.steps > 1) {
+                const std::size_t size = array.components * count;
+                own.push_back(encode(array.data + step * size, size * sizeof(double)));
+              }
+            }
+            std::vector<const std::string*> appended;
+            std::vector<std::size_t> offsets;
+            std::size_t offset = 0;
+            for (const auto* list : {&own, &shared}) {
+              for (const auto& encoded : *list) {
+                appended.push_back(&encoded);
+                offsets.push_back(offset);
+                offset += encoded.size();
+              }
+            }
+            // offsets of the shared arrays, following the arrays of this step
+            const std::size_t* sharedOffsets = offsets.data() + own.size();
+            std::stringstream sstr;
+            sstr << vtk_xml_header("UnstructuredGrid", compress) << "  <UnstructuredGrid>\n"
+                 << "    <Piece NumberOfPoints=\"" << count << "\" NumberOfCells=\"" << count
+                 << "\">\n"
+                 << "      <PointData>\n";
+            std::size_t ownIndex = 0, sharedIndex = 4;
+            for (const auto& array : arrays) {
+              data_array(sstr, array, array.steps > 1 ? offsets[ownIndex++]
+                                                      : sharedOffsets[sharedIndex++]);
+            }
+            sstr << "      </PointData>\n"
+                 << "      <Points>\n"
+                 << "        <DataArray type=\"Float64\" NumberOfComponents=\"3\" "
+                 << "format=\"appended\" offset=\"" << sharedOffsets[0] << "\"/>\n"
+                 << "      </Points>\n"
+                 << "      <Cells>\n"
+                 << "        <DataArray type=\"Int64\" Name=\"connectivity\" format=\"appended\" "
+                 << "offset=\"" << sharedOffsets[1] << "\"/>\n"
+                 << "        <DataArray type=\"Int64\" Name=\"offsets\" format=\"appended\" "
+                 << "offset=\"" << sharedOffsets[2] << "\"/>\n"
+                 << "        <DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" "
+                 << "offset=\"" << sharedOffsets[3] << "\"/>\n"
+                 << "      </Cells>\n"
+                 << "    </Piece>\n"
+                 << "  </UnstructuredGrid>\n"
+                 << "  <AppendedData encoding=\"raw\">\n"
+                 << "_";
+            write_vtk_file(file_of(filename, step), sstr.str(), appended);
+          }
+        });
+    if (steps > 1) {
+      std::vector<VTKCollectionEntry> collection;
+      for (std::size_t step = 0; step < steps; ++step) {
+        collection.push_back(VTKCollectionEntry{
+            times.empty() ? static_cast<double>(step) : times[step], file_of(basename, step)});
+      }
+      write_vtk_collection(filename + ".pvd", collection);
+    }
+  }
+}
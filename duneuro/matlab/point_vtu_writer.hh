@@ -0,0 +1,48 @@
+#ifndef DUNEURO_MATLAB_POINT_VTU_WRITER_HH
+#define DUNEURO_MATLAB_POINT_VTU_WRITER_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <dune/common/parametertree.hh>
+
+namespace duneuro
+{
+  /**
+   * \brief data on the points of write_point_vtu, not owning its values
+   *
+   * the values of step s start at data + s * components * points, with the components of a
+   * point next to each other. Arrays with a single step are written to every step.
+   */
+  struct PointDataArray {
+    std::string name;
+    const double* data;
+    std::size_t components;
+    std::size_t steps;
+  };
+
+  /**
+   * \brief write points and data on them as binary vtu files, directly from the given buffers
+   *
+   * The points are given as 3xN column major doubles and written as vertex cells. Neither the
+   * points nor the data are copied, they are encoded straight from the buffers, so these only
+   * have to be alive during the call. If any array has more than one step, every step is written
+   * to <filename>_<step>.vtu and collected in <filename>.pvd, where the points and all arrays with
+   * a single step are encoded only once. Otherwise a single file <filename>.vtu is written.
+   *
+   * times contains the time of each step, if it is empty the index of the step is used.
+   *
+   * Configuration:
+   *   compress: whether to compress the data with zlib, default true if available
+   *   compression_level: zlib compression level from 1 (fast) to 9 (small), default 1
+   *   threads: number of threads the steps are encoded and written on, default all cores
+   *
+   * Does not use the mex api.
+   */
+  void write_point_vtu(const std::string& filename, const double* points, std::size_t count,
+                       const std::vector<PointDataArray>& arrays, const std::vector<double>& times,
+                       const Dune::ParameterTree& config);
+}
+
+#endif // DUNEURO_MATLAB_POINT_VTU_WRITER_HH
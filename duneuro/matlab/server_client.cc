@@ -0,0 +1,134 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/server_client.hh>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <unistd.h>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/server_protocol.hh>
+
+namespace duneuro
+{
+  ServerConnection& ServerConnection::instance()
+  {
+    static ServerConnection connection;
+    return connection;
+  }
+
+  void ServerConnection::connect(const std::string& path, std::size_t sharedMemoryThreshold)
+  {
+    if (disabled_) {
+      DUNE_THROW(Dune::Exception, "commands executed by a server can not connect to a server");
+    }
+    if (connected()) {
+      DUNE_THROW(Dune::Exception,
+                 "already connected to the server at \"" << path_ << "\", disconnect first");
+    }
+    int fd = connect_server_socket(path);
+    try {
+      MessageWriter hello;
+      hello.write(serverProtocolVersion);
+      send_message(fd, hello.buffer());
+      std::string response;
+      if (!receive_message(fd, response)) {
+        DUNE_THROW(Dune::IOError, "the server at \"" << path << "\" closed the connection");
+      }
+      MessageReader reader(response);
+      if (reader.read<std::uint8_t>() != 0) {
+        DUNE_THROW(Dune::IOError, "the server at \"" << path << "\" refused the connection: "
+                                                     << reader.read_string());
+      }
+    } catch (...) {
+      ::close(fd);
+      throw;
+    }
+    fd_ = fd;
+    lost_ = false;
+    sharedMemoryThreshold_ = sharedMemoryThreshold;
+    path_ = path;
+  }
+
+  void ServerConnection::disconnect()
+  {
+    if (connected()) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+    lost_ = false;
+  }
+
+  void ServerConnection::run(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
+  {
+    if (lost_) {
+      DUNE_THROW(Dune::IOError, "the connection to the server at \""
+                                    << path_ << "\" was lost, please disconnect and reconnect");
+    }
+    std::string error;
+    try {
+      error = exchange(nlhs, plhs, nrhs, prhs);
+    } catch (Dune::IOError&) {
+      // the stream may be out of sync, so no further requests are sent
+      lost_ = true;
+      throw;
+    }
+    if (!error.empty()) {
+      mexErrMsgTxt(error.c_str());
+    }
+  }
+
+  std::string ServerConnection::exchange(int nlhs, mxArray* plhs[], int nrhs,
+                                         const mxArray* prhs[])
+  {
+    SharedMemorySegments segments(sharedMemoryThreshold_);
+    MessageWriter request;
+    request.write<std::uint32_t>(nlhs);
+    request.write<std::uint32_t>(nrhs);
+    for (int i = 0; i < nrhs; ++i) {
+      request.write_array(prhs[i], segments);
+    }
+    send_message(fd_, request.buffer());
+    std::string response;
+    if (!receive_message(fd_, response)) {
+      DUNE_THROW(Dune::IOError, "the server at \"" << path_ << "\" closed the connection");
+    }
+    // the server has read the request segments before answering
+    segments.clear();
+
+    MessageReader reader(response);
+    if (reader.read<std::uint8_t>() != 0) {
+      return reader.read_string();
+    }
+    const auto responseSegments = reader.read<std::uint32_t>();
+    const auto outputs = reader.read<std::uint32_t>();
+    std::vector<mxArray*> arrays;
+    try {
+      if (outputs > static_cast<std::uint32_t>(std::max(nlhs, 1))) {
+        DUNE_THROW(Dune::IOError, "unexpected number of outputs in server response");
+      }
+      for (std::uint32_t i = 0; i < outputs; ++i) {
+        arrays.push_back(reader.read_array());
+      }
+    } catch (...) {
+      for (auto* arr : arrays) {
+        mxDestroyArray(arr);
+      }
+      if (responseSegments > 0) {
+        send_message(fd_, std::string());
+      }
+      throw;
+    }
+    // let the server unlink the segments of the response
+    if (responseSegments > 0) {
+      send_message(fd_, std::string());
+    }
+    std::copy(arrays.begin(), arrays.end(), plhs);
+    return std::string();
+  }
+}
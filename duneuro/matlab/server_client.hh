@@ -0,0 +1,66 @@
+#ifndef DUNEURO_MATLAB_SERVER_CLIENT_HH
+#define DUNEURO_MATLAB_SERVER_CLIENT_HH
+
+#include <mex.h>
+
+#include <cstddef>
+#include <string>
+
+namespace duneuro
+{
+  /**
+   * \brief connection of the mex module to a duneuro_matlab_server
+   *
+   * while connected, commands are executed by the server and all handles refer to objects living
+   * in the server process, see server_protocol.hh. Calls are made from the matlab thread only.
+   */
+  class ServerConnection
+  {
+  public:
+    static ServerConnection& instance();
+
+    /**
+     * \brief connect to the server listening on the unix domain socket path
+     *
+     * arrays of at least sharedMemoryThreshold bytes are passed through shared memory, 0 passes
+     * all arrays through the socket.
+     */
+    void connect(const std::string& path, std::size_t sharedMemoryThreshold);
+
+    /**
+     * \brief refuse all further connections
+     *
+     * called by the server, whose commands must not be forwarded to another server.
+     */
+    void disable()
+    {
+      disabled_ = true;
+    }
+
+    /** \brief close the connection, the objects of this client are released by the server */
+    void disconnect();
+
+    bool connected() const
+    {
+      return fd_ >= 0;
+    }
+
+    /** \brief run the command given in prhs[0] on the server */
+    void run(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+  private:
+    ServerConnection() = default;
+
+    // exchange a request with the server, returns the error reported by the server or an empty
+    // string on success
+    std::string exchange(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]);
+
+    int fd_ = -1;
+    bool lost_ = false;
+    bool disabled_ = false;
+    std::size_t sharedMemoryThreshold_ = 0;
+    std::string path_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_SERVER_CLIENT_HH
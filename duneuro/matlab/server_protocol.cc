@@ -0,0 +1,473 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/server_protocol.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace duneuro
+{
+  namespace
+  {
+    enum class ArrayTag : std::uint8_t { none = 0, data, shared_data, structure, cell };
+
+    using ArrayPtr = std::unique_ptr<mxArray, void (*)(mxArray*)>;
+
+    // arrays whose content is a flat buffer
+    bool is_data_class(mxClassID classID)
+    {
+      switch (classID) {
+      case mxLOGICAL_CLASS:
+      case mxCHAR_CLASS:
+      case mxDOUBLE_CLASS:
+      case mxSINGLE_CLASS:
+      case mxINT8_CLASS:
+      case mxUINT8_CLASS:
+      case mxINT16_CLASS:
+      case mxUINT16_CLASS:
+      case mxINT32_CLASS:
+      case mxUINT32_CLASS:
+      case mxINT64_CLASS:
+      case mxUINT64_CLASS: return true;
+      default: return false;
+      }
+    }
+
+    std::size_t element_size(mxClassID classID)
+    {
+      switch (classID) {
+      case mxLOGICAL_CLASS: return sizeof(mxLogical);
+      case mxCHAR_CLASS: return sizeof(mxChar);
+      case mxDOUBLE_CLASS:
+      case mxINT64_CLASS:
+      case mxUINT64_CLASS: return 8;
+      case mxSINGLE_CLASS:
+      case mxINT32_CLASS:
+      case mxUINT32_CLASS: return 4;
+      case mxINT16_CLASS:
+      case mxUINT16_CLASS: return 2;
+      default: return 1;
+      }
+    }
+
+    std::size_t number_of_elements(const std::vector<mwSize>& dims)
+    {
+      std::size_t n = 1;
+      for (auto d : dims) {
+        if (d != 0 && n > (std::size_t(1) << 56) / d) {
+          DUNE_THROW(Dune::IOError, "invalid array dimensions in message");
+        }
+        n *= d;
+      }
+      return n;
+    }
+
+    // map a segment of at least bytes bytes. Private mappings may be written without changing it
+    void* map_shared_memory(const std::string& name, std::size_t bytes, bool writablePrivate)
+    {
+      int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+      if (fd < 0) {
+        DUNE_THROW(Dune::IOError, "could not open shared memory segment \"" << name << "\": "
+                                                                           << std::strerror(errno));
+      }
+      struct stat st;
+      if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < bytes) {
+        ::close(fd);
+        DUNE_THROW(Dune::IOError, "shared memory segment \"" << name << "\" is truncated");
+      }
+      void* mapping =
+          writablePrivate ? ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+                          : ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (mapping == MAP_FAILED) {
+        DUNE_THROW(Dune::IOError, "could not map shared memory segment \"" << name << "\": "
+                                                                          << std::strerror(errno));
+      }
+      return mapping;
+    }
+
+#ifdef DUNEURO_MATLAB_STANDALONE_MEX
+    // context of the arrays whose data is a segment, see SharedMemoryAllocation
+    struct SegmentData {
+      std::string name;
+    };
+
+    void release_mapping(void* data, std::size_t bytes, void* context)
+    {
+      ::munmap(data, bytes);
+      delete static_cast<SegmentData*>(context);
+    }
+
+    void* allocate_segment(std::size_t bytes, void* state, void** context)
+    {
+      auto& segments = *static_cast<SharedMemorySegments*>(state);
+      if (!segments.use_for(bytes)) {
+        return nullptr;
+      }
+      auto data = std::make_unique<SegmentData>();
+      try {
+        void* mapping = segments.create_mapped(bytes, data->name);
+        *context = data.release();
+        return mapping;
+      } catch (Dune::IOError&) {
+        // e.g. if shared memory is exhausted, the array is allocated as usual and copied later
+        return nullptr;
+      }
+    }
+#endif
+
+    mxArray* create_data_array(mxClassID classID, const std::vector<mwSize>& dims)
+    {
+      switch (classID) {
+      case mxCHAR_CLASS: return mxCreateCharArray(dims.size(), dims.data());
+      case mxLOGICAL_CLASS: return mxCreateLogicalArray(dims.size(), dims.data());
+      default: return mxCreateNumericArray(dims.size(), dims.data(), classID, mxREAL);
+      }
+    }
+
+    sockaddr_un socket_address(const std::string& path)
+    {
+      sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        DUNE_THROW(Dune::IOError, "invalid socket path \"" << path << "\"");
+      }
+      std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+      return address;
+    }
+
+    int create_socket()
+    {
+      int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        DUNE_THROW(Dune::IOError, "could not create socket: " << std::strerror(errno));
+      }
+      return fd;
+    }
+
+    // read exactly bytes bytes, returns false if the peer closed the connection before the first
+    bool receive_all(int fd, void* data, std::size_t bytes)
+    {
+      char* ptr = static_cast<char*>(data);
+      std::size_t received = 0;
+      while (received < bytes) {
+        ssize_t n = ::recv(fd, ptr + received, bytes - received, 0);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n == 0 && received == 0) {
+          return false;
+        }
+        if (n <= 0) {
+          DUNE_THROW(Dune::IOError, "connection to the server lost: "
+                                        << (n == 0 ? "unexpected end of message"
+                                                   : std::strerror(errno)));
+        }
+        received += n;
+      }
+      return true;
+    }
+  }
+
+  SharedMemorySegments::SharedMemorySegments(std::size_t threshold) : threshold_(threshold)
+  {
+  }
+
+  SharedMemorySegments::~SharedMemorySegments()
+  {
+    clear();
+  }
+
+  std::string SharedMemorySegments::create(const void* data, std::size_t bytes)
+  {
+    std::string name;
+    void* mapping = create_mapped(bytes, name);
+    std::memcpy(mapping, data, bytes);
+    ::munmap(mapping, bytes);
+    return name;
+  }
+
+  void* SharedMemorySegments::create_mapped(std::size_t bytes, std::string& name)
+  {
+    static std::atomic<std::uint64_t> counter(0);
+    name = "/duneuro_" + std::to_string(::getpid()) + "_" + std::to_string(counter++);
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      DUNE_THROW(Dune::IOError, "could not create shared memory segment \"" << name << "\": "
+                                                                           << std::strerror(errno));
+    }
+    names_.push_back(name);
+    void* mapping = MAP_FAILED;
+    if (::ftruncate(fd, bytes) == 0) {
+      mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      DUNE_THROW(Dune::IOError, "could not map shared memory segment \"" << name << "\": "
+                                                                        << std::strerror(errno));
+    }
+    return mapping;
+  }
+
+  bool SharedMemorySegments::contains(const std::string& name) const
+  {
+    return std::find(names_.begin(), names_.end(), name) != names_.end();
+  }
+
+  void SharedMemorySegments::clear()
+  {
+    for (const auto& name : names_) {
+      ::shm_unlink(name.c_str());
+    }
+    names_.clear();
+  }
+
+#ifdef DUNEURO_MATLAB_STANDALONE_MEX
+  SharedMemoryAllocation::SharedMemoryAllocation(SharedMemorySegments& segments)
+      : allocator_{allocate_segment, release_mapping, &segments}
+  {
+    mxStandaloneSetAllocator(&allocator_);
+  }
+
+  SharedMemoryAllocation::~SharedMemoryAllocation()
+  {
+    mxStandaloneSetAllocator(nullptr);
+  }
+#endif
+
+  void MessageWriter::write_array(const mxArray* arr, SharedMemorySegments& segments)
+  {
+    if (!arr) {
+      write(ArrayTag::none);
+      return;
+    }
+    const mxClassID classID = mxGetClassID(arr);
+    if (!mxIsStruct(arr) && !mxIsCell(arr) && !is_data_class(classID)) {
+      // objects are represented by their handle on the server
+      mxArray* handle =
+          mxGetNumberOfElements(arr) == 1 ? mxGetProperty(arr, 0, "cpp_handle") : nullptr;
+      if (!handle || !mxIsUint64(handle)) {
+        mxDestroyArray(handle);
+        DUNE_THROW(Dune::Exception, "only numeric, logical, char, struct and cell arrays and "
+                                    "objects with a cpp_handle can be passed to the server");
+      }
+      write_array(handle, segments);
+      mxDestroyArray(handle);
+      return;
+    }
+    if (mxIsComplex(arr) || mxIsSparse(arr)) {
+      DUNE_THROW(Dune::Exception, "complex and sparse arrays can not be passed to the server");
+    }
+    const std::size_t n = mxGetNumberOfElements(arr);
+    const std::size_t bytes = is_data_class(classID) ? n * mxGetElementSize(arr) : 0;
+    const bool shared = bytes > 0 && segments.use_for(bytes);
+    write(mxIsStruct(arr) ? ArrayTag::structure
+                          : mxIsCell(arr) ? ArrayTag::cell
+                                          : shared ? ArrayTag::shared_data : ArrayTag::data);
+    write<std::uint32_t>(classID);
+    const std::size_t ndims = mxGetNumberOfDimensions(arr);
+    const mwSize* dims = mxGetDimensions(arr);
+    write<std::uint64_t>(ndims);
+    for (std::size_t i = 0; i < ndims; ++i) {
+      write<std::uint64_t>(dims[i]);
+    }
+    if (mxIsStruct(arr)) {
+      const int fields = mxGetNumberOfFields(arr);
+      write<std::uint32_t>(fields);
+      for (int f = 0; f < fields; ++f) {
+        write_string(mxGetFieldNameByNumber(arr, f));
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        for (int f = 0; f < fields; ++f) {
+          write_array(mxGetFieldByNumber(arr, i, f), segments);
+        }
+      }
+    } else if (mxIsCell(arr)) {
+      for (std::size_t i = 0; i < n; ++i) {
+        write_array(mxGetCell(arr, i), segments);
+      }
+    } else {
+      write<std::uint64_t>(bytes);
+#ifdef DUNEURO_MATLAB_STANDALONE_MEX
+      auto* segment = static_cast<const SegmentData*>(
+          mxStandaloneGetDataContext(arr, release_mapping));
+      if (shared && segment && segments.contains(segment->name)) {
+        write_string(segment->name);
+        return;
+      }
+#endif
+      if (shared) {
+        write_string(segments.create(mxGetData(arr), bytes));
+      } else if (bytes > 0) {
+        write_bytes(mxGetData(arr), bytes);
+      }
+    }
+  }
+
+  std::string MessageReader::read_string()
+  {
+    const auto size = read<std::uint64_t>();
+    if (size > size_ - position_) {
+      DUNE_THROW(Dune::IOError, "truncated message");
+    }
+    std::string str(data_ + position_, size);
+    position_ += size;
+    return str;
+  }
+
+  mxArray* MessageReader::read_array()
+  {
+    const auto tag = read<ArrayTag>();
+    if (tag == ArrayTag::none) {
+      return nullptr;
+    }
+    const auto classID = static_cast<mxClassID>(read<std::uint32_t>());
+    const auto ndims = read<std::uint64_t>();
+    if (ndims < 2 || ndims > 64) {
+      DUNE_THROW(Dune::IOError, "invalid array dimensions in message");
+    }
+    std::vector<mwSize> dims(ndims);
+    for (auto& d : dims) {
+      d = read<std::uint64_t>();
+    }
+    const std::size_t n = number_of_elements(dims);
+    switch (tag) {
+    case ArrayTag::structure: {
+      const auto fields = read<std::uint32_t>();
+      std::vector<std::string> names(fields);
+      std::vector<const char*> pointers(fields);
+      for (std::size_t f = 0; f < fields; ++f) {
+        names[f] = read_string();
+        pointers[f] = names[f].c_str();
+      }
+      ArrayPtr arr(mxCreateStructArray(ndims, dims.data(), fields, pointers.data()),
+                   mxDestroyArray);
+      for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t f = 0; f < fields; ++f) {
+          mxSetFieldByNumber(arr.get(), i, f, read_array());
+        }
+      }
+      return arr.release();
+    }
+    case ArrayTag::cell: {
+      ArrayPtr arr(mxCreateCellArray(ndims, dims.data()), mxDestroyArray);
+      for (std::size_t i = 0; i < n; ++i) {
+        mxSetCell(arr.get(), i, read_array());
+      }
+      return arr.release();
+    }
+    case ArrayTag::data:
+    case ArrayTag::shared_data: {
+      if (!is_data_class(classID)) {
+        DUNE_THROW(Dune::IOError, "invalid array class in message");
+      }
+      const auto bytes = read<std::uint64_t>();
+      if (bytes != n * element_size(classID)) {
+        DUNE_THROW(Dune::IOError, "invalid array size in message");
+      }
+      const std::string name = tag == ArrayTag::shared_data ? read_string() : std::string();
+#ifdef DUNEURO_MATLAB_STANDALONE_MEX
+      if (tag == ArrayTag::shared_data && bytes > 0) {
+        return mxStandaloneCreateArrayWithData(classID, ndims, dims.data(),
+                                               map_shared_memory(name, bytes, true),
+                                               release_mapping, nullptr);
+      }
+#endif
+      ArrayPtr arr(create_data_array(classID, dims), mxDestroyArray);
+      if (tag == ArrayTag::shared_data) {
+        void* mapping = map_shared_memory(name, bytes, false);
+        std::memcpy(mxGetData(arr.get()), mapping, bytes);
+        ::munmap(mapping, bytes);
+      } else if (bytes > 0) {
+        read_bytes(mxGetData(arr.get()), bytes);
+      }
+      return arr.release();
+    }
+    default: DUNE_THROW(Dune::IOError, "invalid array in message");
+    }
+  }
+
+  void send_message(int fd, const std::string& message)
+  {
+    const std::uint64_t size = message.size();
+    for (auto part : {std::make_pair(reinterpret_cast<const char*>(&size), sizeof(size)),
+                      std::make_pair(message.data(), message.size())}) {
+      std::size_t sent = 0;
+      while (sent < part.second) {
+        // MSG_NOSIGNAL turns a closed peer into an error instead of SIGPIPE
+        ssize_t n = ::send(fd, part.first + sent, part.second - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n < 0) {
+          DUNE_THROW(Dune::IOError, "connection to the server lost: " << std::strerror(errno));
+        }
+        sent += n;
+      }
+    }
+  }
+
+  bool receive_message(int fd, std::string& message)
+  {
+    std::uint64_t size;
+    if (!receive_all(fd, &size, sizeof(size))) {
+      return false;
+    }
+    message.resize(size);
+    if (size > 0 && !receive_all(fd, &message[0], size)) {
+      DUNE_THROW(Dune::IOError, "connection to the server lost: unexpected end of message");
+    }
+    return true;
+  }
+
+  int connect_server_socket(const std::string& path)
+  {
+    const auto address = socket_address(path);
+    int fd = create_socket();
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+      const int error = errno;
+      ::close(fd);
+      DUNE_THROW(Dune::IOError, "could not connect to the server at \"" << path << "\": "
+                                                                        << std::strerror(error));
+    }
+    return fd;
+  }
+
+  int listen_server_socket(const std::string& path)
+  {
+    const auto address = socket_address(path);
+    int probe = create_socket();
+    const bool running =
+        ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    ::close(probe);
+    if (running) {
+      DUNE_THROW(Dune::IOError, "a server is already listening at \"" << path << "\"");
+    }
+    ::unlink(path.c_str());
+    int fd = create_socket();
+    // only the user running the server may connect
+    const mode_t mask = ::umask(0077);
+    const bool bound =
+        ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    ::umask(mask);
+    if (!bound || ::listen(fd, 64) != 0) {
+      const int error = errno;
+      ::close(fd);
+      DUNE_THROW(Dune::IOError, "could not listen at \"" << path << "\": "
+                                                         << std::strerror(error));
+    }
+    return fd;
+  }
+}
@@ -0,0 +1,223 @@
+#ifndef DUNEURO_MATLAB_SERVER_PROTOCOL_HH
+#define DUNEURO_MATLAB_SERVER_PROTOCOL_HH
+
+#include <mex.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <dune/common/exceptions.hh>
+
+/*
+ * Messages exchanged between the mex module and a duneuro_matlab_server over a local socket.
+ *
+ * Every message is a 64 bit length followed by the payload. A connection starts with a hello
+ * carrying the protocol version, afterwards the client sends requests (nlhs followed by the
+ * arrays of prhs, the first one being the command) and the server answers with either an error
+ * message or the nlhs output arrays. Numeric, logical and char payloads of at least a threshold
+ * size are passed through shared memory segments. A segment is unlinked by the side that created
+ * it, once the peer has answered: request segments after the response, response segments after
+ * an acknowledgement of the client.
+ *
+ * Built against the stand-in for the mex api, as in duneuro_matlab_server, arrays are not copied
+ * out of or into segments at all: arrays read from segments map them, and large arrays created
+ * while a SharedMemoryAllocation is alive are allocated in segments, which write_array passes on
+ * as they are. Each payload is thus copied once, by the matlab side.
+ *
+ * Errors are thrown as exceptions, so that temporary segments are unlinked by their destructors
+ * before the error reaches matlab. Broken connections and malformed messages are reported as
+ * Dune::IOError, arrays that can not be passed to the server as Dune::Exception.
+ */
+
+namespace duneuro
+{
+  /** \brief version of the protocol, client and server have to agree on it */
+  constexpr std::uint64_t serverProtocolVersion = 1;
+
+  /** \brief shared memory segments created for the arrays of a single message */
+  class SharedMemorySegments
+  {
+  public:
+    /** \brief payloads of at least threshold bytes are placed in segments, 0 disables them */
+    explicit SharedMemorySegments(std::size_t threshold);
+    ~SharedMemorySegments();
+
+    SharedMemorySegments(const SharedMemorySegments&) = delete;
+    SharedMemorySegments& operator=(const SharedMemorySegments&) = delete;
+
+    bool use_for(std::size_t bytes) const
+    {
+      return threshold_ > 0 && bytes >= threshold_;
+    }
+
+    /** \brief create a segment holding a copy of the bytes and return its name */
+    std::string create(const void* data, std::size_t bytes);
+
+    /**
+     * \brief create a segment of the given size and map it
+     *
+     * the caller has to unmap the returned mapping, the segment stays valid until it is unlinked.
+     */
+    void* create_mapped(std::size_t bytes, std::string& name);
+
+    /** \brief whether the segment was created by this object and is not unlinked yet */
+    bool contains(const std::string& name) const;
+
+    /** \brief unlink all segments created so far */
+    void clear();
+
+    std::size_t size() const
+    {
+      return names_.size();
+    }
+
+  private:
+    std::size_t threshold_;
+    std::vector<std::string> names_;
+  };
+
+#ifdef DUNEURO_MATLAB_STANDALONE_MEX
+  /**
+   * \brief allocate large arrays created by the current thread in shared memory segments
+   *
+   * while the object is alive, numeric, logical and char arrays of at least the threshold of the
+   * segments are placed in new segments, so that write_array passes them without a copy. Arrays
+   * outliving the segments keep their data, but are copied if they are written later on.
+   */
+  class SharedMemoryAllocation
+  {
+  public:
+    explicit SharedMemoryAllocation(SharedMemorySegments& segments);
+    ~SharedMemoryAllocation();
+
+    SharedMemoryAllocation(const SharedMemoryAllocation&) = delete;
+    SharedMemoryAllocation& operator=(const SharedMemoryAllocation&) = delete;
+
+  private:
+    mxStandaloneAllocator allocator_;
+  };
+#endif
+
+  /**
+   * \brief append values, strings and matlab arrays to a message
+   *
+   * the message is collected in a buffer or, if a stream is given, written to the stream
+   * directly, so that large arrays are not copied.
+   */
+  class MessageWriter
+  {
+  public:
+    MessageWriter() : stream_(nullptr)
+    {
+    }
+
+    explicit MessageWriter(std::ostream& stream) : stream_(&stream)
+    {
+    }
+
+    template <class T>
+    void write(T value)
+    {
+      write_bytes(&value, sizeof(T));
+    }
+
+    void write_bytes(const void* data, std::size_t bytes)
+    {
+      if (stream_) {
+        stream_->write(static_cast<const char*>(data), bytes);
+      } else {
+        buffer_.append(static_cast<const char*>(data), bytes);
+      }
+    }
+
+    void write_string(const std::string& str)
+    {
+      write<std::uint64_t>(str.size());
+      write_bytes(str.data(), str.size());
+    }
+
+    /**
+     * \brief append an array, which may be nullptr
+     *
+     * matlab objects are written as the value of their cpp_handle property, so that e.g. a
+     * duneuro_config can be passed wherever a compiled config is accepted. Complex and sparse
+     * arrays, function handles and other objects are rejected.
+     */
+    void write_array(const mxArray* arr, SharedMemorySegments& segments);
+
+    const std::string& buffer() const
+    {
+      return buffer_;
+    }
+
+  private:
+    std::ostream* stream_;
+    std::string buffer_;
+  };
+
+  /** \brief read the content of a message written by a MessageWriter */
+  class MessageReader
+  {
+  public:
+    // the data is referenced, not copied
+    MessageReader(const char* data, std::size_t size) : data_(data), size_(size), position_(0)
+    {
+    }
+
+    explicit MessageReader(const std::string& buffer) : MessageReader(buffer.data(), buffer.size())
+    {
+    }
+
+    explicit MessageReader(std::string&&) = delete;
+
+    template <class T>
+    T read()
+    {
+      T value;
+      read_bytes(&value, sizeof(T));
+      return value;
+    }
+
+    void read_bytes(void* data, std::size_t bytes)
+    {
+      if (bytes > size_ - position_) {
+        DUNE_THROW(Dune::IOError, "truncated message");
+      }
+      std::memcpy(data, data_ + position_, bytes);
+      position_ += bytes;
+    }
+
+    std::string read_string();
+
+    /**
+     * \brief create the next array of the message, which may be nullptr
+     *
+     * data passed through shared memory is copied into the array, or mapped privately when built
+     * against the stand-in for the mex api. The segment is left to its creator.
+     */
+    mxArray* read_array();
+
+  private:
+    const char* data_;
+    std::size_t size_;
+    std::size_t position_;
+  };
+
+  /** \brief write a message to a socket, a closed peer is reported as an error */
+  void send_message(int fd, const std::string& message);
+
+  /** \brief read a message from a socket, returns false if the peer closed the connection */
+  bool receive_message(int fd, std::string& message);
+
+  /** \brief connect to the server listening on a unix domain socket */
+  int connect_server_socket(const std::string& path);
+
+  /** \brief create a unix domain socket listening on path, a stale socket file is replaced */
+  int listen_server_socket(const std::string& path);
+}
+
+#endif // DUNEURO_MATLAB_SERVER_PROTOCOL_HH
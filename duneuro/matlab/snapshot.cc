@@ -0,0 +1,393 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/snapshot.hh>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/temporary_file.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    const char snapshotMagic[8] = {'D', 'U', 'N', 'E', 'U', 'R', 'S', 'N'};
+    const std::uint64_t snapshotVersion = 2;
+
+    struct DigestRecord {
+      std::uint8_t sha256[32];
+      std::uint64_t bytes;
+    };
+
+    DigestRecord to_record(const ContentDigest& digest)
+    {
+      DigestRecord record;
+      std::copy(digest.sha256.begin(), digest.sha256.end(), record.sha256);
+      record.bytes = digest.bytes;
+      return record;
+    }
+
+    ContentDigest from_record(const DigestRecord& record)
+    {
+      ContentDigest digest;
+      std::copy(record.sha256, record.sha256 + 32, digest.sha256.begin());
+      digest.bytes = record.bytes;
+      return digest;
+    }
+
+    // number of entries of each section and the digests of the content, padded to 256 bytes
+    struct SnapshotHeader {
+      char magic[8];
+      std::uint64_t version;
+      std::uint64_t configBytes;
+      std::uint64_t nodes;
+      std::uint64_t elements;
+      std::uint64_t cornersPerElement;
+      std::uint64_t labels;
+      std::uint64_t conductivities;
+      std::uint64_t tensors;
+      std::uint64_t electrodes;
+      std::uint64_t electrodeConfigBytes;
+      std::uint64_t coils;
+      std::uint64_t projectionsPerCoil;
+      DigestRecord digest;
+      DigestRecord electrodesDigest;
+      DigestRecord coilsDigest;
+      std::uint64_t reserved[4];
+    };
+    static_assert(sizeof(SnapshotHeader) == 256, "unexpected header size");
+
+    using Coordinate = Dune::FieldVector<double, 3>;
+    using Tensor = Dune::FieldMatrix<double, 3, 3>;
+    // coordinates and tensors are written straight from the vectors holding them
+    static_assert(sizeof(Coordinate) == 3 * sizeof(double), "unexpected field vector layout");
+    static_assert(sizeof(Tensor) == 9 * sizeof(double), "unexpected field matrix layout");
+
+    // indices are converted in blocks of this many entries
+    const std::size_t conversionBlockSize = 1 << 16;
+
+    std::uint64_t padded(std::uint64_t bytes)
+    {
+      return (bytes + 7) / 8 * 8;
+    }
+
+    void flatten(const Dune::ParameterTree& tree, const std::string& prefix,
+                 std::vector<std::pair<std::string, std::string>>& entries)
+    {
+      for (const auto& key : tree.getValueKeys()) {
+        entries.emplace_back(prefix + key, tree[key]);
+      }
+      for (const auto& key : tree.getSubKeys()) {
+        flatten(tree.sub(key), prefix + key + ".", entries);
+      }
+    }
+
+    void append_string(std::string& out, const std::string& str)
+    {
+      const std::uint64_t size = str.size();
+      out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+      out.append(str);
+    }
+
+    // the tree as a sequence of (key, value) pairs with full keys, each string prefixed by its size
+    std::string encode_config(const Dune::ParameterTree& tree)
+    {
+      std::vector<std::pair<std::string, std::string>> entries;
+      flatten(tree, "", entries);
+      std::string out;
+      for (const auto& entry : entries) {
+        append_string(out, entry.first);
+        append_string(out, entry.second);
+      }
+      return out;
+    }
+
+    void decode_config(const std::string& bytes, const std::string& filename,
+                       Dune::ParameterTree& tree)
+    {
+      std::size_t pos = 0;
+      auto next = [&]() {
+        std::uint64_t size;
+        if (bytes.size() - pos < sizeof(size)) {
+          DUNE_THROW(Dune::IOError, "snapshot file \"" << filename << "\" is invalid");
+        }
+        std::memcpy(&size, bytes.data() + pos, sizeof(size));
+        pos += sizeof(size);
+        if (bytes.size() - pos < size) {
+          DUNE_THROW(Dune::IOError, "snapshot file \"" << filename << "\" is invalid");
+        }
+        pos += size;
+        return bytes.substr(pos - size, size);
+      };
+      while (pos < bytes.size()) {
+        auto key = next();
+        tree[key] = next();
+      }
+    }
+
+    class SnapshotWriter
+    {
+    public:
+      explicit SnapshotWriter(const std::string& filename)
+          : stream_(filename, std::ios::binary), bytes_(0)
+      {
+      }
+
+      void write(const void* data, std::size_t bytes)
+      {
+        stream_.write(static_cast<const char*>(data), bytes);
+        bytes_ += bytes;
+      }
+
+      void write_padded(const std::string& str)
+      {
+        const char zeros[8] = {};
+        write(str.data(), str.size());
+        write(zeros, padded(str.size()) - str.size());
+      }
+
+      // write count entries as 64 bit integers, converting them in blocks
+      template <class F>
+      void write_indices(std::size_t count, F&& index)
+      {
+        std::vector<std::uint64_t> buffer;
+        buffer.reserve(std::min(count, conversionBlockSize));
+        for (std::size_t begin = 0; begin < count; begin += conversionBlockSize) {
+          const std::size_t end = std::min(count, begin + conversionBlockSize);
+          buffer.clear();
+          for (std::size_t i = begin; i < end; ++i) {
+            buffer.push_back(static_cast<std::uint64_t>(index(i)));
+          }
+          write(buffer.data(), buffer.size() * sizeof(std::uint64_t));
+        }
+      }
+
+      bool good() const
+      {
+        return static_cast<bool>(stream_);
+      }
+
+      std::size_t bytes() const
+      {
+        return bytes_;
+      }
+
+    private:
+      std::ofstream stream_;
+      std::size_t bytes_;
+    };
+
+    class SnapshotReader
+    {
+    public:
+      explicit SnapshotReader(const std::string& filename)
+          : filename_(filename), stream_(filename, std::ios::binary)
+      {
+        if (!stream_) {
+          DUNE_THROW(Dune::IOError, "could not open snapshot file \"" << filename << "\"");
+        }
+      }
+
+      void read(void* data, std::size_t bytes)
+      {
+        stream_.read(static_cast<char*>(data), bytes);
+        if (!stream_) {
+          DUNE_THROW(Dune::IOError, "snapshot file \"" << filename_ << "\" is truncated");
+        }
+      }
+
+      std::string read_padded(std::size_t size)
+      {
+        std::string str(padded(size), '\0');
+        read(&str[0], str.size());
+        str.resize(size);
+        return str;
+      }
+
+      // read count 64 bit integers in blocks, passing each to store together with its position
+      template <class F>
+      void read_indices(std::size_t count, F&& store)
+      {
+        std::vector<std::uint64_t> buffer(std::min(count, conversionBlockSize));
+        for (std::size_t begin = 0; begin < count; begin += conversionBlockSize) {
+          const std::size_t end = std::min(count, begin + conversionBlockSize);
+          read(buffer.data(), (end - begin) * sizeof(std::uint64_t));
+          for (std::size_t i = begin; i < end; ++i) {
+            store(i, buffer[i - begin]);
+          }
+        }
+      }
+
+    private:
+      std::string filename_;
+      std::ifstream stream_;
+    };
+
+    // size of the file described by the header in bytes, or 0 if the sizes overflow
+    std::uint64_t expected_size(const SnapshotHeader& h)
+    {
+      const std::uint64_t limit = std::uint64_t(1) << 56;
+      const std::uint64_t counts[] = {h.configBytes, h.nodes, h.elements, h.cornersPerElement,
+                                      h.labels, h.conductivities, h.tensors, h.electrodes,
+                                      h.electrodeConfigBytes, h.coils, h.projectionsPerCoil};
+      for (auto c : counts) {
+        if (c >= limit) {
+          return 0;
+        }
+      }
+      if (h.cornersPerElement > 0 && h.elements > limit / h.cornersPerElement) {
+        return 0;
+      }
+      if (h.projectionsPerCoil > 0 && h.coils > limit / h.projectionsPerCoil) {
+        return 0;
+      }
+      const std::uint64_t words = 3 * h.nodes + h.elements * h.cornersPerElement + h.labels
+                                  + h.conductivities + 9 * h.tensors + 3 * h.electrodes
+                                  + 3 * h.coils + 3 * h.coils * h.projectionsPerCoil;
+      return sizeof(SnapshotHeader) + padded(h.configBytes) + padded(h.electrodeConfigBytes)
+             + words * sizeof(double);
+    }
+  }
+
+  void write_snapshot(const std::string& filename, const DriverSnapshot& snapshot)
+  {
+    ScopedPhase phase("write_snapshot");
+    const auto& mesh = snapshot.mesh;
+    const std::size_t corners = mesh.elements.empty() ? 0 : mesh.elements.front().size();
+    for (const auto& element : mesh.elements) {
+      if (element.size() != corners) {
+        DUNE_THROW(Dune::Exception, "snapshots require all elements to have the same number of "
+                                    "corners");
+      }
+    }
+    const auto config = encode_config(snapshot.config);
+    const auto electrodeConfig = encode_config(snapshot.electrodes.config);
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.digest = to_record(snapshot.digest);
+    header.configBytes = config.size();
+    header.nodes = mesh.nodes.size();
+    header.elements = mesh.elements.size();
+    header.cornersPerElement = corners;
+    header.labels = mesh.labels.size();
+    header.conductivities = mesh.conductivities.size();
+    header.tensors = mesh.tensors.size();
+    header.electrodes = snapshot.electrodes.positions.size();
+    header.electrodeConfigBytes = electrodeConfig.size();
+    header.electrodesDigest = to_record(snapshot.electrodes.digest);
+    header.coils = snapshot.coils.positions.size();
+    header.projectionsPerCoil = snapshot.coils.projectionsPerCoil;
+    header.coilsDigest = to_record(snapshot.coils.digest);
+    if (snapshot.coils.projections.size() != header.coils * header.projectionsPerCoil) {
+      DUNE_THROW(Dune::Exception, "number of projections does not match the number of coils");
+    }
+
+    const auto tmpname = temporary_filename(filename);
+    {
+      SnapshotWriter writer(tmpname);
+      writer.write(&header, sizeof(header));
+      writer.write_padded(config);
+      writer.write(mesh.nodes.data(), mesh.nodes.size() * sizeof(Coordinate));
+      writer.write_indices(mesh.elements.size() * corners, [&](std::size_t i) {
+        return mesh.elements[i / corners][i % corners];
+      });
+      writer.write_indices(mesh.labels.size(), [&](std::size_t i) { return mesh.labels[i]; });
+      writer.write(mesh.conductivities.data(), mesh.conductivities.size() * sizeof(double));
+      writer.write(mesh.tensors.data(), mesh.tensors.size() * sizeof(Tensor));
+      writer.write(snapshot.electrodes.positions.data(),
+                   snapshot.electrodes.positions.size() * sizeof(Coordinate));
+      writer.write_padded(electrodeConfig);
+      writer.write(snapshot.coils.positions.data(),
+                   snapshot.coils.positions.size() * sizeof(Coordinate));
+      writer.write(snapshot.coils.projections.data(),
+                   snapshot.coils.projections.size() * sizeof(Coordinate));
+      phase.add_bytes(writer.bytes());
+      if (!writer.good()) {
+        std::remove(tmpname.c_str());
+        DUNE_THROW(Dune::IOError, "could not write snapshot file \"" << tmpname << "\"");
+      }
+    }
+    if (std::rename(tmpname.c_str(), filename.c_str()) != 0) {
+      std::remove(tmpname.c_str());
+      DUNE_THROW(Dune::IOError, "could not move snapshot file to \"" << filename << "\"");
+    }
+  }
+
+  DriverSnapshot read_snapshot(const std::string& filename)
+  {
+    ScopedPhase phase("read_snapshot");
+    SnapshotReader reader(filename);
+    SnapshotHeader header;
+    reader.read(&header, sizeof(header));
+    if (std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0) {
+      DUNE_THROW(Dune::IOError, "\"" << filename << "\" is not a snapshot file");
+    }
+    if (header.version != snapshotVersion) {
+      DUNE_THROW(Dune::IOError, "snapshot file \"" << filename << "\" has version "
+                                                   << header.version << ", expected "
+                                                   << snapshotVersion);
+    }
+    // validate the sizes before allocating anything
+    const std::uint64_t size = expected_size(header);
+    {
+      std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+      if (size == 0 || static_cast<std::uint64_t>(stream.tellg()) != size) {
+        DUNE_THROW(Dune::IOError, "snapshot file \"" << filename << "\" is invalid");
+      }
+    }
+    phase.add_bytes(size);
+
+    DriverSnapshot snapshot;
+    auto& mesh = snapshot.mesh;
+    snapshot.digest = from_record(header.digest);
+    decode_config(reader.read_padded(header.configBytes), filename, snapshot.config);
+    mesh.nodes.resize(header.nodes);
+    reader.read(mesh.nodes.data(), mesh.nodes.size() * sizeof(Coordinate));
+
+    using Element = typename std::decay_t<decltype(mesh.elements)>::value_type;
+    using Index = typename Element::value_type;
+    const std::size_t corners = header.cornersPerElement;
+    mesh.elements.assign(header.elements, Element(corners));
+    reader.read_indices(header.elements * corners, [&](std::size_t i, std::uint64_t v) {
+      if (v >= header.nodes) {
+        DUNE_THROW(Dune::IOError, "snapshot file \"" << filename << "\" is invalid");
+      }
+      mesh.elements[i / corners][i % corners] = static_cast<Index>(v);
+    });
+    mesh.labels.resize(header.labels);
+    reader.read_indices(header.labels, [&](std::size_t i, std::uint64_t v) {
+      mesh.labels[i] = static_cast<typename decltype(mesh.labels)::value_type>(v);
+    });
+    mesh.conductivities.resize(header.conductivities);
+    reader.read(mesh.conductivities.data(), mesh.conductivities.size() * sizeof(double));
+    mesh.tensors.resize(header.tensors);
+    reader.read(mesh.tensors.data(), mesh.tensors.size() * sizeof(Tensor));
+
+    auto& electrodes = snapshot.electrodes;
+    electrodes.positions.resize(header.electrodes);
+    reader.read(electrodes.positions.data(), electrodes.positions.size() * sizeof(Coordinate));
+    decode_config(reader.read_padded(header.electrodeConfigBytes), filename, electrodes.config);
+    electrodes.digest = from_record(header.electrodesDigest);
+
+    auto& coils = snapshot.coils;
+    coils.positions.resize(header.coils);
+    reader.read(coils.positions.data(), coils.positions.size() * sizeof(Coordinate));
+    coils.projectionsPerCoil = header.projectionsPerCoil;
+    coils.projections.resize(header.coils * header.projectionsPerCoil);
+    reader.read(coils.projections.data(), coils.projections.size() * sizeof(Coordinate));
+    coils.digest = from_record(header.coilsDigest);
+    return snapshot;
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef DUNEURO_MATLAB_SNAPSHOT_HH
+#define DUNEURO_MATLAB_SNAPSHOT_HH
+
+#include <cstdint>
+#include <string>
+
+#include <dune/common/parametertree.hh>
+
+#include <duneuro/common/fitted_driver_data.hh>
+
+#include <duneuro/matlab/content_digest.hh>
+#include <duneuro/matlab/driver_cache.hh>
+
+namespace duneuro
+{
+  /**
+   * \brief everything needed to recreate a driver without the matlab struct it was created from
+   *
+   * digest is the digest of the struct, so that a restored driver can be shared with drivers
+   * created from the same struct. Empty electrodes or coils were not set on the driver.
+   */
+  struct DriverSnapshot {
+    Dune::ParameterTree config;
+    ContentDigest digest;
+    FittedDriverData<3> mesh;
+    DriverCache::Electrodes electrodes;
+    DriverCache::Coils coils;
+  };
+
+  /**
+   * \brief write a snapshot to a versioned binary file
+   *
+   * the file consists of a fixed size header with magic, version and the size of every section,
+   * followed by the sections in native byte order, with all indices stored as 64 bit integers. It
+   * is written to a temporary name and renamed afterwards, so that readers never see partially
+   * written snapshots.
+   */
+  void write_snapshot(const std::string& filename, const DriverSnapshot& snapshot);
+
+  /** \brief read a snapshot written by write_snapshot, validating it against the file size */
+  DriverSnapshot read_snapshot(const std::string& filename);
+}
+
+#endif // DUNEURO_MATLAB_SNAPSHOT_HH
@@ -0,0 +1,75 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/spatial_order.hh>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace duneuro
+{
+  namespace
+  {
+    constexpr unsigned int bitsPerDirection = 21;
+    constexpr std::uint32_t maxCoordinate = (std::uint32_t(1) << bitsPerDirection) - 1;
+
+    // spread the lower 21 bits of x such that there are two zero bits between each of them
+    std::uint64_t spread_bits(std::uint64_t x)
+    {
+      x &= 0x1fffff;
+      x = (x | x << 32) & 0x1f00000000ffffULL;
+      x = (x | x << 16) & 0x1f0000ff0000ffULL;
+      x = (x | x << 8) & 0x100f00f00f00f00fULL;
+      x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+      x = (x | x << 2) & 0x1249249249249249ULL;
+      return x;
+    }
+  }
+
+  std::uint64_t morton_code(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+  {
+    return spread_bits(x) | spread_bits(y) << 1 | spread_bits(z) << 2;
+  }
+
+  std::vector<std::size_t> morton_order(const double* coordinates, std::size_t count,
+                                        std::size_t stride)
+  {
+    std::array<double, 3> lower, upper;
+    lower.fill(std::numeric_limits<double>::max());
+    upper.fill(std::numeric_limits<double>::lowest());
+    for (std::size_t i = 0; i < count; ++i) {
+      for (unsigned int d = 0; d < 3; ++d) {
+        const double c = coordinates[i * stride + d];
+        if (std::isfinite(c)) {
+          lower[d] = std::min(lower[d], c);
+          upper[d] = std::max(upper[d], c);
+        }
+      }
+    }
+    std::array<double, 3> scale;
+    for (unsigned int d = 0; d < 3; ++d) {
+      const double extent = upper[d] - lower[d];
+      scale[d] = extent > 0 ? maxCoordinate / extent : 0.0;
+    }
+    std::vector<std::pair<std::uint64_t, std::size_t>> keys(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      std::array<std::uint32_t, 3> q;
+      for (unsigned int d = 0; d < 3; ++d) {
+        const double c = (coordinates[i * stride + d] - lower[d]) * scale[d];
+        // the negated comparison also catches nan
+        q[d] = !(c > 0) ? 0 : c >= maxCoordinate ? maxCoordinate : static_cast<std::uint32_t>(c);
+      }
+      keys[i] = {morton_code(q[0], q[1], q[2]), i};
+    }
+    // sorting the pairs keeps points with equal codes in their original order
+    std::sort(keys.begin(), keys.end());
+    std::vector<std::size_t> order(count);
+    std::transform(keys.begin(), keys.end(), order.begin(),
+                   [](const std::pair<std::uint64_t, std::size_t>& k) { return k.second; });
+    return order;
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef DUNEURO_MATLAB_SPATIAL_ORDER_HH
+#define DUNEURO_MATLAB_SPATIAL_ORDER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace duneuro
+{
+  /**
+   * \brief interleave the lower 21 bits of the three coordinates to a 63 bit morton code
+   */
+  std::uint64_t morton_code(std::uint32_t x, std::uint32_t y, std::uint32_t z);
+
+  /**
+   * \brief order of points along a morton (z-order) curve
+   *
+   * The coordinates of point i are stored at coordinates + i * stride. The points are quantized
+   * to 21 bits per direction within their bounding box, and the indices of the points are returned
+   * sorted by the morton code of the quantized positions, so that points close to each other in
+   * the result are mostly close in space. Points with equal codes keep their relative order. Nan
+   * coordinates are mapped to the lower boundary of the box, infinite ones to the nearest one.
+   */
+  std::vector<std::size_t> morton_order(const double* coordinates, std::size_t count,
+                                        std::size_t stride);
+}
+
+#endif // DUNEURO_MATLAB_SPATIAL_ORDER_HH
@@ -0,0 +1,648 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <mex.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+struct mxArray_tag {
+  mxClassID classID;
+  std::vector<mwSize> dims;
+  bool complex;
+  // numeric, logical and char data
+  void* data;
+  // releases data provided by an allocator, std::free is used if not set
+  mxStandaloneRelease release;
+  void* releaseContext;
+  // field names of structs, children of structs (element major) and cells
+  std::vector<std::string> fields;
+  std::vector<mxArray*> children;
+};
+
+namespace
+{
+  std::size_t element_size(mxClassID classID)
+  {
+    switch (classID) {
+    case mxLOGICAL_CLASS: return sizeof(mxLogical);
+    case mxCHAR_CLASS: return sizeof(mxChar);
+    case mxDOUBLE_CLASS: return sizeof(double);
+    case mxSINGLE_CLASS: return sizeof(float);
+    case mxINT8_CLASS:
+    case mxUINT8_CLASS: return 1;
+    case mxINT16_CLASS:
+    case mxUINT16_CLASS: return 2;
+    case mxINT32_CLASS:
+    case mxUINT32_CLASS: return 4;
+    case mxINT64_CLASS:
+    case mxUINT64_CLASS: return 8;
+    case mxCELL_CLASS:
+    case mxSTRUCT_CLASS: return sizeof(mxArray*);
+    default: return 0;
+    }
+  }
+
+  mwSize number_of_elements(const std::vector<mwSize>& dims)
+  {
+    mwSize n = 1;
+    for (auto d : dims) {
+      n *= d;
+    }
+    return n;
+  }
+
+  thread_local const mxStandaloneAllocator* currentAllocator = nullptr;
+
+  // data of an array of the given size from the allocator of the thread, nullptr if there is none
+  void* allocate_data(mxArray* arr, std::size_t bytes, bool initialize)
+  {
+    if (!currentAllocator) {
+      return nullptr;
+    }
+    void* context = nullptr;
+    void* data = currentAllocator->allocate(bytes, currentAllocator->state, &context);
+    if (data) {
+      arr->release = currentAllocator->release;
+      arr->releaseContext = context;
+      if (initialize) {
+        std::memset(data, 0, bytes);
+      }
+    }
+    return data;
+  }
+
+  mxArray* create_array(mxClassID classID, std::vector<mwSize> dims, bool initialize)
+  {
+    auto* arr = new mxArray;
+    arr->classID = classID;
+    arr->dims = std::move(dims);
+    arr->complex = false;
+    arr->data = nullptr;
+    arr->release = nullptr;
+    arr->releaseContext = nullptr;
+    const mwSize n = number_of_elements(arr->dims);
+    if (classID == mxCELL_CLASS) {
+      arr->children.assign(n, nullptr);
+    } else if (classID != mxSTRUCT_CLASS && n > 0) {
+      arr->data = allocate_data(arr, n * element_size(classID), initialize);
+      if (!arr->data) {
+        arr->data = initialize ? std::calloc(n, element_size(classID))
+                               : std::malloc(n * element_size(classID));
+      }
+      if (!arr->data) {
+        delete arr;
+        mexErrMsgTxt("out of memory");
+      }
+    }
+    return arr;
+  }
+
+  mxArray*& struct_slot(const mxArray* arr, mwIndex index, int number)
+  {
+    return const_cast<mxArray*>(arr)->children[index * arr->fields.size() + number];
+  }
+
+  int field_number(const mxArray* arr, const char* name)
+  {
+    auto it = std::find(arr->fields.begin(), arr->fields.end(), name);
+    return it == arr->fields.end() ? -1 : static_cast<int>(it - arr->fields.begin());
+  }
+
+  const char* class_name(mxClassID classID)
+  {
+    switch (classID) {
+    case mxLOGICAL_CLASS: return "logical";
+    case mxCHAR_CLASS: return "char";
+    case mxDOUBLE_CLASS: return "double";
+    case mxSINGLE_CLASS: return "single";
+    case mxINT8_CLASS: return "int8";
+    case mxUINT8_CLASS: return "uint8";
+    case mxINT16_CLASS: return "int16";
+    case mxUINT16_CLASS: return "uint16";
+    case mxINT32_CLASS: return "int32";
+    case mxUINT32_CLASS: return "uint32";
+    case mxINT64_CLASS: return "int64";
+    case mxUINT64_CLASS: return "uint64";
+    case mxCELL_CLASS: return "cell";
+    case mxSTRUCT_CLASS: return "struct";
+    default: return "unknown";
+    }
+  }
+
+  std::atomic<int> lockCount(0);
+  void (*atExitFunction)(void) = nullptr;
+}
+
+mxArray* mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID classid, mxComplexity flag)
+{
+  if (flag == mxCOMPLEX) {
+    mexErrMsgTxt("complex arrays are not supported by the standalone mex api");
+  }
+  return create_array(classid, {m, n}, true);
+}
+
+mxArray* mxCreateUninitNumericMatrix(mwSize m, mwSize n, mxClassID classid, mxComplexity flag)
+{
+  if (flag == mxCOMPLEX) {
+    mexErrMsgTxt("complex arrays are not supported by the standalone mex api");
+  }
+  return create_array(classid, {m, n}, false);
+}
+
+mxArray* mxCreateNumericArray(mwSize ndim, const mwSize* dims, mxClassID classid,
+                              mxComplexity flag)
+{
+  if (flag == mxCOMPLEX) {
+    mexErrMsgTxt("complex arrays are not supported by the standalone mex api");
+  }
+  return create_array(classid, std::vector<mwSize>(dims, dims + ndim), true);
+}
+
+mxArray* mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity flag)
+{
+  return mxCreateNumericMatrix(m, n, mxDOUBLE_CLASS, flag);
+}
+
+mxArray* mxCreateDoubleScalar(double value)
+{
+  auto* arr = mxCreateDoubleMatrix(1, 1, mxREAL);
+  *mxGetPr(arr) = value;
+  return arr;
+}
+
+mxArray* mxCreateLogicalScalar(bool value)
+{
+  auto* arr = create_array(mxLOGICAL_CLASS, {1, 1}, true);
+  *mxGetLogicals(arr) = value;
+  return arr;
+}
+
+mxArray* mxCreateString(const char* str)
+{
+  const std::size_t n = std::strlen(str);
+  auto* arr = create_array(mxCHAR_CLASS, {n > 0 ? 1u : 0u, n}, false);
+  std::copy(str, str + n, mxGetChars(arr));
+  return arr;
+}
+
+mxArray* mxCreateStructMatrix(mwSize m, mwSize n, int nfields, const char** fieldnames)
+{
+  auto* arr = create_array(mxSTRUCT_CLASS, {m, n}, true);
+  arr->fields.assign(fieldnames, fieldnames + nfields);
+  arr->children.assign(m * n * nfields, nullptr);
+  return arr;
+}
+
+mxArray* mxCreateCellMatrix(mwSize m, mwSize n)
+{
+  return create_array(mxCELL_CLASS, {m, n}, true);
+}
+
+mxArray* mxCreateCharArray(mwSize ndim, const mwSize* dims)
+{
+  return create_array(mxCHAR_CLASS, std::vector<mwSize>(dims, dims + ndim), true);
+}
+
+mxArray* mxCreateLogicalArray(mwSize ndim, const mwSize* dims)
+{
+  return create_array(mxLOGICAL_CLASS, std::vector<mwSize>(dims, dims + ndim), true);
+}
+
+mxArray* mxCreateStructArray(mwSize ndim, const mwSize* dims, int nfields,
+                             const char** fieldnames)
+{
+  auto* arr = create_array(mxSTRUCT_CLASS, std::vector<mwSize>(dims, dims + ndim), true);
+  arr->fields.assign(fieldnames, fieldnames + nfields);
+  arr->children.assign(mxGetNumberOfElements(arr) * nfields, nullptr);
+  return arr;
+}
+
+mxArray* mxCreateCellArray(mwSize ndim, const mwSize* dims)
+{
+  return create_array(mxCELL_CLASS, std::vector<mwSize>(dims, dims + ndim), true);
+}
+
+mxArray* mxDuplicateArray(const mxArray* arr)
+{
+  auto* copy = create_array(arr->classID, arr->dims, false);
+  if (arr->data) {
+    std::memcpy(copy->data, arr->data, mxGetNumberOfElements(arr) * mxGetElementSize(arr));
+  }
+  copy->fields = arr->fields;
+  copy->children.resize(arr->children.size());
+  for (std::size_t i = 0; i < arr->children.size(); ++i) {
+    copy->children[i] = arr->children[i] ? mxDuplicateArray(arr->children[i]) : nullptr;
+  }
+  return copy;
+}
+
+void mxDestroyArray(mxArray* arr)
+{
+  if (!arr) {
+    return;
+  }
+  for (auto* child : arr->children) {
+    mxDestroyArray(child);
+  }
+  if (arr->release) {
+    arr->release(arr->data, mxGetNumberOfElements(arr) * mxGetElementSize(arr),
+                 arr->releaseContext);
+  } else {
+    std::free(arr->data);
+  }
+  delete arr;
+}
+
+void* mxGetData(const mxArray* arr)
+{
+  return arr->data;
+}
+
+double* mxGetPr(const mxArray* arr)
+{
+  return static_cast<double*>(arr->data);
+}
+
+mxLogical* mxGetLogicals(const mxArray* arr)
+{
+  return static_cast<mxLogical*>(arr->data);
+}
+
+mxChar* mxGetChars(const mxArray* arr)
+{
+  return static_cast<mxChar*>(arr->data);
+}
+
+double mxGetScalar(const mxArray* arr)
+{
+  if (mxGetNumberOfElements(arr) == 0 || !arr->data) {
+    return 0.0;
+  }
+  switch (arr->classID) {
+  case mxLOGICAL_CLASS: return *mxGetLogicals(arr);
+  case mxCHAR_CLASS: return *mxGetChars(arr);
+  case mxDOUBLE_CLASS: return *mxGetPr(arr);
+  case mxSINGLE_CLASS: return *static_cast<const float*>(arr->data);
+  case mxINT8_CLASS: return *static_cast<const std::int8_t*>(arr->data);
+  case mxUINT8_CLASS: return *static_cast<const std::uint8_t*>(arr->data);
+  case mxINT16_CLASS: return *static_cast<const std::int16_t*>(arr->data);
+  case mxUINT16_CLASS: return *static_cast<const std::uint16_t*>(arr->data);
+  case mxINT32_CLASS: return *static_cast<const std::int32_t*>(arr->data);
+  case mxUINT32_CLASS: return *static_cast<const std::uint32_t*>(arr->data);
+  case mxINT64_CLASS: return *static_cast<const std::int64_t*>(arr->data);
+  case mxUINT64_CLASS: return *static_cast<const std::uint64_t*>(arr->data);
+  default: return 0.0;
+  }
+}
+
+char* mxArrayToString(const mxArray* arr)
+{
+  if (!mxIsChar(arr)) {
+    return nullptr;
+  }
+  const mwSize n = mxGetNumberOfElements(arr);
+  char* out = static_cast<char*>(mxMalloc(n + 1));
+  const mxChar* chars = mxGetChars(arr);
+  for (mwSize i = 0; i < n; ++i) {
+    out[i] = static_cast<char>(chars[i]);
+  }
+  out[n] = '\0';
+  return out;
+}
+
+int mxGetString(const mxArray* arr, char* buffer, mwSize buflen)
+{
+  if (!mxIsChar(arr) || buflen == 0) {
+    return 1;
+  }
+  const mwSize n = mxGetNumberOfElements(arr);
+  const mwSize copied = std::min(n, buflen - 1);
+  const mxChar* chars = mxGetChars(arr);
+  for (mwSize i = 0; i < copied; ++i) {
+    buffer[i] = static_cast<char>(chars[i]);
+  }
+  buffer[copied] = '\0';
+  return copied == n ? 0 : 1;
+}
+
+mwSize mxGetM(const mxArray* arr)
+{
+  return arr->dims[0];
+}
+
+mwSize mxGetN(const mxArray* arr)
+{
+  mwSize n = 1;
+  for (std::size_t i = 1; i < arr->dims.size(); ++i) {
+    n *= arr->dims[i];
+  }
+  return n;
+}
+
+mwSize mxGetNumberOfElements(const mxArray* arr)
+{
+  return number_of_elements(arr->dims);
+}
+
+mwSize mxGetNumberOfDimensions(const mxArray* arr)
+{
+  return arr->dims.size();
+}
+
+const mwSize* mxGetDimensions(const mxArray* arr)
+{
+  return arr->dims.data();
+}
+
+std::size_t mxGetElementSize(const mxArray* arr)
+{
+  return element_size(arr->classID);
+}
+
+mxClassID mxGetClassID(const mxArray* arr)
+{
+  return arr->classID;
+}
+
+bool mxIsComplex(const mxArray* arr)
+{
+  return arr->complex;
+}
+
+bool mxIsDouble(const mxArray* arr)
+{
+  return arr->classID == mxDOUBLE_CLASS;
+}
+
+bool mxIsSingle(const mxArray* arr)
+{
+  return arr->classID == mxSINGLE_CLASS;
+}
+
+bool mxIsInt32(const mxArray* arr)
+{
+  return arr->classID == mxINT32_CLASS;
+}
+
+bool mxIsUint32(const mxArray* arr)
+{
+  return arr->classID == mxUINT32_CLASS;
+}
+
+bool mxIsInt64(const mxArray* arr)
+{
+  return arr->classID == mxINT64_CLASS;
+}
+
+bool mxIsUint64(const mxArray* arr)
+{
+  return arr->classID == mxUINT64_CLASS;
+}
+
+bool mxIsNumeric(const mxArray* arr)
+{
+  return arr->classID >= mxDOUBLE_CLASS && arr->classID <= mxUINT64_CLASS;
+}
+
+bool mxIsChar(const mxArray* arr)
+{
+  return arr->classID == mxCHAR_CLASS;
+}
+
+bool mxIsLogical(const mxArray* arr)
+{
+  return arr->classID == mxLOGICAL_CLASS;
+}
+
+bool mxIsStruct(const mxArray* arr)
+{
+  return arr->classID == mxSTRUCT_CLASS;
+}
+
+bool mxIsCell(const mxArray* arr)
+{
+  return arr->classID == mxCELL_CLASS;
+}
+
+bool mxIsEmpty(const mxArray* arr)
+{
+  return mxGetNumberOfElements(arr) == 0;
+}
+
+bool mxIsScalar(const mxArray* arr)
+{
+  return mxGetNumberOfElements(arr) == 1;
+}
+
+bool mxIsLogicalScalar(const mxArray* arr)
+{
+  return mxIsLogical(arr) && mxIsScalar(arr);
+}
+
+bool mxIsLogicalScalarTrue(const mxArray* arr)
+{
+  return mxIsLogicalScalar(arr) && *mxGetLogicals(arr);
+}
+
+bool mxIsSparse(const mxArray*)
+{
+  return false;
+}
+
+bool mxIsClass(const mxArray* arr, const char* name)
+{
+  return std::strcmp(class_name(arr->classID), name) == 0;
+}
+
+mxArray* mxGetProperty(const mxArray*, mwIndex, const char*)
+{
+  return nullptr;
+}
+
+int mxGetNumberOfFields(const mxArray* arr)
+{
+  return arr->fields.size();
+}
+
+const char* mxGetFieldNameByNumber(const mxArray* arr, int number)
+{
+  if (number < 0 || number >= mxGetNumberOfFields(arr)) {
+    return nullptr;
+  }
+  return arr->fields[number].c_str();
+}
+
+mxArray* mxGetField(const mxArray* arr, mwIndex index, const char* name)
+{
+  if (!mxIsStruct(arr)) {
+    return nullptr;
+  }
+  int number = field_number(arr, name);
+  return number < 0 ? nullptr : mxGetFieldByNumber(arr, index, number);
+}
+
+mxArray* mxGetFieldByNumber(const mxArray* arr, mwIndex index, int number)
+{
+  if (!mxIsStruct(arr) || index >= mxGetNumberOfElements(arr) || number < 0
+      || number >= mxGetNumberOfFields(arr)) {
+    return nullptr;
+  }
+  return struct_slot(arr, index, number);
+}
+
+void mxSetField(mxArray* arr, mwIndex index, const char* name, mxArray* value)
+{
+  int number = field_number(arr, name);
+  if (number < 0) {
+    mexErrMsgTxt("unknown field");
+  }
+  mxSetFieldByNumber(arr, index, number, value);
+}
+
+void mxSetFieldByNumber(mxArray* arr, mwIndex index, int number, mxArray* value)
+{
+  auto& slot = struct_slot(arr, index, number);
+  if (slot != value) {
+    mxDestroyArray(slot);
+  }
+  slot = value;
+}
+
+int mxAddField(mxArray* arr, const char* name)
+{
+  if (!mxIsStruct(arr)) {
+    return -1;
+  }
+  int number = field_number(arr, name);
+  if (number >= 0) {
+    return number;
+  }
+  const std::size_t nfields = arr->fields.size();
+  const mwSize n = mxGetNumberOfElements(arr);
+  std::vector<mxArray*> children(n * (nfields + 1), nullptr);
+  for (mwSize e = 0; e < n; ++e) {
+    std::copy(arr->children.begin() + e * nfields, arr->children.begin() + (e + 1) * nfields,
+              children.begin() + e * (nfields + 1));
+  }
+  arr->children.swap(children);
+  arr->fields.push_back(name);
+  return nfields;
+}
+
+mxArray* mxGetCell(const mxArray* arr, mwIndex index)
+{
+  if (!mxIsCell(arr) || index >= arr->children.size()) {
+    return nullptr;
+  }
+  return arr->children[index];
+}
+
+void mxSetCell(mxArray* arr, mwIndex index, mxArray* value)
+{
+  auto& slot = arr->children[index];
+  if (slot != value) {
+    mxDestroyArray(slot);
+  }
+  slot = value;
+}
+
+void* mxMalloc(mwSize n)
+{
+  return std::malloc(n);
+}
+
+void* mxCalloc(mwSize n, mwSize size)
+{
+  return std::calloc(n, size);
+}
+
+void mxFree(void* ptr)
+{
+  std::free(ptr);
+}
+
+void mexErrMsgTxt(const char* message)
+{
+  throw MexError(message);
+}
+
+void mexWarnMsgTxt(const char* message)
+{
+  std::cerr << "Warning: " << message << std::endl;
+}
+
+int mexPrintf(const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int result = std::vprintf(format, args);
+  va_end(args);
+  return result;
+}
+
+void mexLock()
+{
+  ++lockCount;
+}
+
+void mexUnlock()
+{
+  --lockCount;
+}
+
+bool mexIsLocked()
+{
+  return lockCount > 0;
+}
+
+int mexAtExit(void (*function)(void))
+{
+  atExitFunction = function;
+  return 0;
+}
+
+void mexMakeArrayPersistent(mxArray*)
+{
+}
+
+void mexStandaloneRunAtExit()
+{
+  if (atExitFunction) {
+    atExitFunction();
+  }
+}
+
+void mxStandaloneSetAllocator(const mxStandaloneAllocator* allocator)
+{
+  currentAllocator = allocator;
+}
+
+mxArray* mxStandaloneCreateArrayWithData(mxClassID classid, mwSize ndim, const mwSize* dims,
+                                         void* data, mxStandaloneRelease release, void* context)
+{
+  if (classid == mxCELL_CLASS || classid == mxSTRUCT_CLASS || element_size(classid) == 0) {
+    mexErrMsgTxt("only numeric, logical and char arrays can own external data");
+  }
+  auto* arr = new mxArray;
+  arr->classID = classid;
+  arr->dims.assign(dims, dims + ndim);
+  arr->complex = false;
+  arr->data = data;
+  arr->release = release;
+  arr->releaseContext = context;
+  return arr;
+}
+
+void* mxStandaloneGetDataContext(const mxArray* arr, mxStandaloneRelease release)
+{
+  return arr->release == release ? arr->releaseContext : nullptr;
+}
@@ -0,0 +1,174 @@
+#ifndef DUNEURO_MATLAB_STANDALONE_MEX_H
+#define DUNEURO_MATLAB_STANDALONE_MEX_H
+
+/**
+ * \file
+ * \brief minimal stand-in for the matlab mx and mex api
+ *
+ * Provides the subset of the mx* and mex* functions used by duneuro-matlab, so that the command
+ * layer can be built and exercised without a matlab installation, e.g. for benchmarks. Putting the
+ * directory of this file in front of the include path makes <mex.h> resolve to it. Errors raised
+ * through mexErrMsgTxt are thrown as MexError.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+typedef std::size_t mwSize;
+typedef std::size_t mwIndex;
+typedef bool mxLogical;
+typedef char16_t mxChar;
+
+typedef struct mxArray_tag mxArray;
+
+enum mxClassID {
+  mxUNKNOWN_CLASS = 0,
+  mxCELL_CLASS,
+  mxSTRUCT_CLASS,
+  mxLOGICAL_CLASS,
+  mxCHAR_CLASS,
+  mxVOID_CLASS,
+  mxDOUBLE_CLASS,
+  mxSINGLE_CLASS,
+  mxINT8_CLASS,
+  mxUINT8_CLASS,
+  mxINT16_CLASS,
+  mxUINT16_CLASS,
+  mxINT32_CLASS,
+  mxUINT32_CLASS,
+  mxINT64_CLASS,
+  mxUINT64_CLASS,
+  mxFUNCTION_CLASS
+};
+
+enum mxComplexity { mxREAL = 0, mxCOMPLEX };
+
+/** \brief exception thrown by mexErrMsgTxt */
+struct MexError : public std::runtime_error {
+  explicit MexError(const std::string& message) : std::runtime_error(message)
+  {
+  }
+};
+
+// creation and destruction
+mxArray* mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID classid, mxComplexity flag);
+mxArray* mxCreateUninitNumericMatrix(mwSize m, mwSize n, mxClassID classid, mxComplexity flag);
+mxArray* mxCreateNumericArray(mwSize ndim, const mwSize* dims, mxClassID classid,
+                              mxComplexity flag);
+mxArray* mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity flag);
+mxArray* mxCreateDoubleScalar(double value);
+mxArray* mxCreateLogicalScalar(bool value);
+mxArray* mxCreateString(const char* str);
+mxArray* mxCreateStructMatrix(mwSize m, mwSize n, int nfields, const char** fieldnames);
+mxArray* mxCreateCellMatrix(mwSize m, mwSize n);
+mxArray* mxCreateCharArray(mwSize ndim, const mwSize* dims);
+mxArray* mxCreateLogicalArray(mwSize ndim, const mwSize* dims);
+mxArray* mxCreateStructArray(mwSize ndim, const mwSize* dims, int nfields,
+                             const char** fieldnames);
+mxArray* mxCreateCellArray(mwSize ndim, const mwSize* dims);
+mxArray* mxDuplicateArray(const mxArray* arr);
+void mxDestroyArray(mxArray* arr);
+
+// data access
+void* mxGetData(const mxArray* arr);
+double* mxGetPr(const mxArray* arr);
+mxLogical* mxGetLogicals(const mxArray* arr);
+mxChar* mxGetChars(const mxArray* arr);
+double mxGetScalar(const mxArray* arr);
+char* mxArrayToString(const mxArray* arr);
+int mxGetString(const mxArray* arr, char* buffer, mwSize buflen);
+
+// size and type queries
+mwSize mxGetM(const mxArray* arr);
+mwSize mxGetN(const mxArray* arr);
+mwSize mxGetNumberOfElements(const mxArray* arr);
+mwSize mxGetNumberOfDimensions(const mxArray* arr);
+const mwSize* mxGetDimensions(const mxArray* arr);
+std::size_t mxGetElementSize(const mxArray* arr);
+mxClassID mxGetClassID(const mxArray* arr);
+bool mxIsComplex(const mxArray* arr);
+bool mxIsDouble(const mxArray* arr);
+bool mxIsSingle(const mxArray* arr);
+bool mxIsInt32(const mxArray* arr);
+bool mxIsUint32(const mxArray* arr);
+bool mxIsInt64(const mxArray* arr);
+bool mxIsUint64(const mxArray* arr);
+bool mxIsNumeric(const mxArray* arr);
+bool mxIsChar(const mxArray* arr);
+bool mxIsLogical(const mxArray* arr);
+bool mxIsStruct(const mxArray* arr);
+bool mxIsCell(const mxArray* arr);
+bool mxIsEmpty(const mxArray* arr);
+bool mxIsScalar(const mxArray* arr);
+bool mxIsLogicalScalar(const mxArray* arr);
+bool mxIsLogicalScalarTrue(const mxArray* arr);
+bool mxIsSparse(const mxArray* arr);
+bool mxIsClass(const mxArray* arr, const char* name);
+/* matlab objects are not supported, so no object has properties */
+mxArray* mxGetProperty(const mxArray* arr, mwIndex index, const char* name);
+
+// structs and cells
+int mxGetNumberOfFields(const mxArray* arr);
+const char* mxGetFieldNameByNumber(const mxArray* arr, int number);
+mxArray* mxGetField(const mxArray* arr, mwIndex index, const char* name);
+mxArray* mxGetFieldByNumber(const mxArray* arr, mwIndex index, int number);
+void mxSetField(mxArray* arr, mwIndex index, const char* name, mxArray* value);
+void mxSetFieldByNumber(mxArray* arr, mwIndex index, int number, mxArray* value);
+int mxAddField(mxArray* arr, const char* name);
+mxArray* mxGetCell(const mxArray* arr, mwIndex index);
+void mxSetCell(mxArray* arr, mwIndex index, mxArray* value);
+
+// memory
+void* mxMalloc(mwSize n);
+void* mxCalloc(mwSize n, mwSize size);
+void mxFree(void* ptr);
+
+// mex functions
+void mexErrMsgTxt(const char* message);
+void mexWarnMsgTxt(const char* message);
+int mexPrintf(const char* format, ...);
+void mexLock();
+void mexUnlock();
+bool mexIsLocked();
+int mexAtExit(void (*function)(void));
+void mexMakeArrayPersistent(mxArray* arr);
+
+/** \brief call the function registered through mexAtExit, if any. Not part of the matlab api */
+void mexStandaloneRunAtExit();
+
+/*
+ * The functions below are not part of the matlab api either. They let the data of numeric,
+ * logical and char arrays live in memory provided by the caller, e.g. in shared memory, see
+ * duneuro/matlab/server_protocol.hh. Code using them checks for this macro.
+ */
+#define DUNEURO_MATLAB_STANDALONE_MEX 1
+
+/** \brief releases data provided by the caller when its array is destroyed */
+typedef void (*mxStandaloneRelease)(void* data, std::size_t bytes, void* context);
+
+/**
+ * \brief provides the data of arrays created by the current thread
+ *
+ * allocate returns the data for an array of the given number of bytes, or nullptr to fall back to
+ * the default allocation, and sets the context passed to release. The data does not have to be
+ * initialized.
+ */
+struct mxStandaloneAllocator {
+  void* (*allocate)(std::size_t bytes, void* state, void** context);
+  mxStandaloneRelease release;
+  void* state;
+};
+
+/** \brief set the allocator of the current thread, nullptr restores the default allocation */
+void mxStandaloneSetAllocator(const mxStandaloneAllocator* allocator);
+
+/** \brief create a numeric, logical or char array owning the given data through release */
+mxArray* mxStandaloneCreateArrayWithData(mxClassID classid, mwSize ndim, const mwSize* dims,
+                                         void* data, mxStandaloneRelease release, void* context);
+
+/** \brief context of the data of the array if it is released by release, nullptr otherwise */
+void* mxStandaloneGetDataContext(const mxArray* arr, mxStandaloneRelease release);
+
+#endif // DUNEURO_MATLAB_STANDALONE_MEX_H
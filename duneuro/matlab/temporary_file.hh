@@ -0,0 +1,25 @@
+#ifndef DUNEURO_MATLAB_TEMPORARY_FILE_HH
+#define DUNEURO_MATLAB_TEMPORARY_FILE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <unistd.h>
+
+namespace duneuro
+{
+  /**
+   * \brief name to write a file to before renaming it to filename
+   *
+   * the name contains the process id and a counter, so that concurrent writers of the same file
+   * in any thread of any process never write to the same temporary file.
+   */
+  inline std::string temporary_filename(const std::string& filename)
+  {
+    static std::atomic<std::uint64_t> counter(0);
+    return filename + ".tmp" + std::to_string(::getpid()) + "_" + std::to_string(counter++);
+  }
+}
+
+#endif // DUNEURO_MATLAB_TEMPORARY_FILE_HH
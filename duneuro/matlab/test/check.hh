@@ -0,0 +1,54 @@
+#ifndef DUNEURO_MATLAB_TEST_CHECK_HH
+#define DUNEURO_MATLAB_TEST_CHECK_HH
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace duneuro
+{
+  /** \brief collects failed checks of a test, main returns exit_code() */
+  class TestResult
+  {
+  public:
+    void check(bool condition, const std::string& what)
+    {
+      if (!condition) {
+        std::cerr << "check failed: " << what << std::endl;
+        ++failures_;
+      }
+    }
+
+    /** \brief check that both ranges have the same size and agree up to a relative tolerance */
+    template <class A, class B>
+    void check_close(const A& actual, const B& expected, double tolerance, const std::string& what)
+    {
+      if (actual.size() != expected.size()) {
+        check(false, what + ": size " + std::to_string(actual.size()) + " instead of "
+                         + std::to_string(expected.size()));
+        return;
+      }
+      for (std::size_t i = 0; i < actual.size(); ++i) {
+        const double a = actual[i];
+        const double e = expected[i];
+        if (!(std::abs(a - e) <= tolerance * (1.0 + std::abs(e)))) {
+          check(false, what + ": entry " + std::to_string(i) + " is " + std::to_string(a)
+                           + " instead of " + std::to_string(e));
+          return;
+        }
+      }
+    }
+
+    int exit_code() const
+    {
+      return failures_ == 0 ? 0 : 1;
+    }
+
+  private:
+    std::size_t failures_ = 0;
+  };
+}
+
+#endif // DUNEURO_MATLAB_TEST_CHECK_HH
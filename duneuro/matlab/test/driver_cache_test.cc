@@ -0,0 +1,153 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <duneuro/matlab/driver_cache.hh>
+
+#include "check.hh"
+#include "fake_driver.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  ContentDigest digest_of(const std::string& content)
+  {
+    ContentHasher hasher;
+    hasher.update_string(content);
+    return hasher.finish();
+  }
+
+  // factory counting the drivers it creates
+  struct CountingFactory {
+    std::atomic<std::size_t> created{0};
+
+    DriverCache::Factory factory()
+    {
+      return [this]() {
+        ++created;
+        return std::unique_ptr<DriverCache::Driver>(std::make_unique<FakeDriver>());
+      };
+    }
+  };
+
+  DriverCache::Electrodes electrodes(std::size_t count, double offset)
+  {
+    DriverCache::Electrodes result;
+    ContentHasher hasher;
+    for (std::size_t i = 0; i < count; ++i) {
+      result.positions.push_back(make_point(offset + i, 0.5 * i, 1.0));
+      hasher.update_string(std::to_string(offset + i));
+    }
+    result.digest = hasher.finish();
+    return result;
+  }
+
+  void test_unshared(TestResult& t)
+  {
+    auto& cache = DriverCache::instance();
+    CountingFactory factory;
+    const auto digest = digest_of("unshared");
+    auto* a = cache.acquire(digest, false, factory.factory());
+    auto* b = cache.acquire(digest, false, factory.factory());
+    t.check(factory.created == 2 && a != b, "drivers are not shared unless requested");
+    t.check(cache.digest(a) == digest, "the digest is recorded");
+    t.check(cache.size() == 2, "size counts unshared drivers");
+    t.check(cache.release(a) && cache.release(b), "release known drivers");
+    t.check(!cache.release(a), "release an unknown driver");
+    t.check(cache.size() == 0, "released drivers are removed");
+  }
+
+  void test_shared(TestResult& t)
+  {
+    auto& cache = DriverCache::instance();
+    CountingFactory factory;
+    const auto digest = digest_of("shared");
+    auto* a = cache.acquire(digest, true, factory.factory());
+    auto* b = cache.acquire(digest, true, factory.factory());
+    auto* other = cache.acquire(digest_of("other"), true, factory.factory());
+    t.check(factory.created == 2, "drivers of the same digest are assembled once");
+    t.check(a != b, "every acquisition is a separate session");
+    t.check(cache.size() == 3, "size counts sessions");
+
+    // every session keeps its own sensors, which are set again when it is locked
+    {
+      auto lock = cache.lock(a);
+      cache.set_electrodes(a, electrodes(3, 0.0));
+    }
+    {
+      auto lock = cache.lock(b);
+      cache.set_electrodes(b, electrodes(5, 10.0));
+    }
+    {
+      auto lock = cache.lock(a);
+      t.check(cache.electrodes(a).positions.size() == 3, "electrodes recorded for a session");
+      auto projected = a->getProjectedElectrodes();
+      t.check(projected.size() == 3 && projected[0][0] == 0.0,
+              "electrodes of the session are set again on lock");
+    }
+    {
+      auto lock = cache.lock(b);
+      auto projected = b->getProjectedElectrodes();
+      t.check(projected.size() == 5 && projected[0][0] == 10.0,
+              "electrodes of the other session are set again on lock");
+    }
+
+    // the driver stays alive until its last session is released
+    cache.release(a);
+    auto* c = cache.acquire(digest, true, factory.factory());
+    t.check(factory.created == 2, "a driver with a live session is reused");
+    cache.release(b);
+    cache.release(c);
+    auto* d = cache.acquire(digest, true, factory.factory());
+    t.check(factory.created == 3, "a driver is destroyed with its last session");
+    cache.release(d);
+    cache.release(other);
+    t.check(cache.size() == 0, "all sessions are released");
+  }
+
+  // concurrent acquisitions of a live shared driver reuse it and take turns on it
+  void test_concurrent(TestResult& t)
+  {
+    auto& cache = DriverCache::instance();
+    CountingFactory factory;
+    const auto digest = digest_of("concurrent");
+    auto* first = cache.acquire(digest, true, factory.factory());
+    std::vector<DriverCache::Driver*> sessions(8);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < sessions.size(); ++i) {
+      threads.emplace_back([&, i]() {
+        sessions[i] = cache.acquire(digest, true, factory.factory());
+        auto lock = cache.lock(sessions[i]);
+        cache.set_electrodes(sessions[i], electrodes(i + 1, 0.0));
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    t.check(factory.created == 1, "sessions acquired concurrently share the driver");
+    for (std::size_t i = 0; i < sessions.size(); ++i) {
+      auto lock = cache.lock(sessions[i]);
+      t.check(sessions[i]->getProjectedElectrodes().size() == i + 1,
+              "concurrent session " + std::to_string(i) + " keeps its electrodes");
+      cache.release(sessions[i]);
+    }
+    cache.release(first);
+    t.check(cache.size() == 0, "all concurrent sessions are released");
+  }
+}
+
+int main()
+{
+  TestResult t;
+  test_unshared(t);
+  test_shared(t);
+  test_concurrent(t);
+  return t.exit_code();
+}
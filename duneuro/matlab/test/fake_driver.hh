@@ -0,0 +1,184 @@
+#ifndef DUNEURO_MATLAB_TEST_FAKE_DRIVER_HH
+#define DUNEURO_MATLAB_TEST_FAKE_DRIVER_HH
+
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <duneuro/driver/driver_factory.hh>
+
+namespace duneuro
+{
+  inline Dune::FieldVector<double, 3> make_point(double x, double y, double z)
+  {
+    Dune::FieldVector<double, 3> point;
+    point[0] = x;
+    point[1] = y;
+    point[2] = z;
+    return point;
+  }
+
+  /**
+   * \brief driver with analytic transfer matrices, used to test the command layer without a mesh
+   *
+   * The entry of sensor i and node j is a smooth function of the sensor position. As in duneuro,
+   * eeg rows are referenced to the first electrode and meg rows are ordered by coil and projection.
+   * Applying a transfer matrix contracts it with a function of the dipole.
+   */
+  class FakeDriver : public DriverInterface<3>
+  {
+  public:
+    explicit FakeDriver(std::size_t nodes = 7) : nodes_(nodes)
+    {
+    }
+
+    static double value(const CoordinateType& position, std::size_t node)
+    {
+      return position[0] * (node + 1) + position[1] * node * node + std::sin(position[2] + node)
+             + 1.0;
+    }
+
+    std::unique_ptr<Function> makeDomainFunction() const override
+    {
+      return nullptr;
+    }
+
+    void solveEEGForward(const DipoleType&, Function&, const Dune::ParameterTree&,
+                         DataTree) override
+    {
+    }
+
+    std::vector<double> solveMEGForward(const Function&, const Dune::ParameterTree&,
+                                        DataTree) override
+    {
+      return {};
+    }
+
+    void setElectrodes(const std::vector<CoordinateType>& electrodes,
+                       const Dune::ParameterTree&) override
+    {
+      electrodes_ = electrodes;
+    }
+
+    std::vector<double> evaluateAtElectrodes(const Function&) const override
+    {
+      return {};
+    }
+
+    void
+    setCoilsAndProjections(const std::vector<CoordinateType>& coils,
+                           const std::vector<std::vector<CoordinateType>>& projections) override
+    {
+      coils_ = coils;
+      projections_ = projections;
+    }
+
+    std::unique_ptr<DenseMatrix<double>> computeEEGTransferMatrix(const Dune::ParameterTree&,
+                                                                  DataTree) override
+    {
+      ++computations_;
+      auto matrix = std::make_unique<DenseMatrix<double>>(electrodes_.size(), nodes_);
+      for (std::size_t i = 0; i < electrodes_.size(); ++i) {
+        for (std::size_t j = 0; j < nodes_; ++j) {
+          (*matrix)(i, j) = value(electrodes_[i], j) - value(electrodes_[0], j);
+        }
+      }
+      return matrix;
+    }
+
+    std::unique_ptr<DenseMatrix<double>> computeMEGTransferMatrix(const Dune::ParameterTree&,
+                                                                  DataTree) override
+    {
+      ++computations_;
+      const std::size_t perCoil = projections_.empty() ? 0 : projections_[0].size();
+      auto matrix = std::make_unique<DenseMatrix<double>>(coils_.size() * perCoil, nodes_);
+      for (std::size_t i = 0; i < coils_.size(); ++i) {
+        for (std::size_t p = 0; p < perCoil; ++p) {
+          const auto& projection = projections_[i][p];
+          for (std::size_t j = 0; j < nodes_; ++j) {
+            (*matrix)(i * perCoil + p, j) =
+                value(coils_[i], j) * (projection[0] + 2 * projection[1] + 3 * projection[2]);
+          }
+        }
+      }
+      return matrix;
+    }
+
+    std::vector<std::vector<double>> applyEEGTransfer(const DenseMatrix<double>& transferMatrix,
+                                                      const std::vector<DipoleType>& dipoles,
+                                                      const Dune::ParameterTree&, DataTree) override
+    {
+      return apply(transferMatrix, dipoles);
+    }
+
+    std::vector<std::vector<double>> applyMEGTransfer(const DenseMatrix<double>& transferMatrix,
+                                                      const std::vector<DipoleType>& dipoles,
+                                                      const Dune::ParameterTree&, DataTree) override
+    {
+      return apply(transferMatrix, dipoles);
+    }
+
+    std::vector<CoordinateType> getProjectedElectrodes() const override
+    {
+      return electrodes_;
+    }
+
+    void write(const Dune::ParameterTree&, DataTree) const override
+    {
+    }
+
+    void print_citations() override
+    {
+    }
+
+    std::unique_ptr<VolumeConductorVTKWriterInterface>
+    volumeConductorVTKWriter(const Dune::ParameterTree&) const override
+    {
+      return nullptr;
+    }
+
+    const std::vector<CoordinateType>& electrodes() const
+    {
+      return electrodes_;
+    }
+
+    const std::vector<CoordinateType>& coils() const
+    {
+      return coils_;
+    }
+
+    /** \brief number of transfer matrices computed so far */
+    std::size_t computations() const
+    {
+      return computations_;
+    }
+
+  private:
+    static std::vector<std::vector<double>> apply(const DenseMatrix<double>& transferMatrix,
+                                                  const std::vector<DipoleType>& dipoles)
+    {
+      std::vector<std::vector<double>> result;
+      for (const auto& dipole : dipoles) {
+        std::vector<double> sensors(transferMatrix.rows(), 0.0);
+        for (std::size_t i = 0; i < transferMatrix.rows(); ++i) {
+          for (std::size_t j = 0; j < transferMatrix.cols(); ++j) {
+            sensors[i] += transferMatrix(i, j)
+                          * (dipole.moment()[0] * (j + 1) + dipole.moment()[1]
+                             + dipole.moment()[2] * dipole.position()[2] * j);
+          }
+        }
+        result.push_back(std::move(sensors));
+      }
+      return result;
+    }
+
+    std::size_t nodes_;
+    std::vector<CoordinateType> electrodes_;
+    std::vector<CoordinateType> coils_;
+    std::vector<std::vector<CoordinateType>> projections_;
+    std::size_t computations_ = 0;
+  };
+}
+
+#endif // DUNEURO_MATLAB_TEST_FAKE_DRIVER_HH
@@ -0,0 +1,64 @@
+#ifndef DUNEURO_MATLAB_TEST_MESH_HH
+#define DUNEURO_MATLAB_TEST_MESH_HH
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <duneuro/common/fitted_driver_data.hh>
+
+#include "check.hh"
+#include "fake_driver.hh"
+
+namespace duneuro
+{
+  inline std::vector<double> flatten(const std::vector<Dune::FieldVector<double, 3>>& points)
+  {
+    std::vector<double> result;
+    for (const auto& point : points) {
+      result.insert(result.end(), point.begin(), point.end());
+    }
+    return result;
+  }
+
+  // two tetrahedra sharing a face, with one label, conductivity and tensor per element
+  inline FittedDriverData<3> make_mesh()
+  {
+    FittedDriverData<3> mesh;
+    mesh.nodes = {make_point(0, 0, 0), make_point(1, 0, 0), make_point(0, 1, 0),
+                  make_point(0, 0, 1), make_point(1, 1, 1)};
+    mesh.elements = {{0, 1, 2, 3}, {1, 2, 3, 4}};
+    mesh.labels = {0, 1};
+    mesh.conductivities = {0.33, 0.0042};
+    mesh.tensors.resize(2);
+    for (std::size_t t = 0; t < 2; ++t) {
+      for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+          mesh.tensors[t][i][j] = t + 0.1 * i + 0.01 * j;
+        }
+      }
+    }
+    return mesh;
+  }
+
+  /** \brief check that two meshes are equal, entry by entry */
+  inline void check_mesh(TestResult& t, const FittedDriverData<3>& actual,
+                         const FittedDriverData<3>& expected, const std::string& what)
+  {
+    t.check_close(flatten(actual.nodes), flatten(expected.nodes), 0.0, what + ": nodes");
+    t.check(actual.elements == expected.elements, what + ": elements");
+    t.check(actual.labels == expected.labels, what + ": labels");
+    t.check_close(actual.conductivities, expected.conductivities, 0.0, what + ": conductivities");
+    t.check(actual.tensors.size() == expected.tensors.size(), what + ": number of tensors");
+    for (std::size_t k = 0; k < std::min(actual.tensors.size(), expected.tensors.size()); ++k) {
+      for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+          t.check(actual.tensors[k][i][j] == expected.tensors[k][i][j], what + ": tensors");
+        }
+      }
+    }
+  }
+
+}
+
+#endif // DUNEURO_MATLAB_TEST_MESH_HH
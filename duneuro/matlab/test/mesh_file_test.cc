@@ -0,0 +1,97 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <duneuro/matlab/mesh_file.hh>
+
+#include "check.hh"
+#include "mesh.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  // writes the mesh like duneuro_write_mesh_file.m
+  template <class Index>
+  void write_mesh_file(const std::string& filename, const FittedDriverData<3>& mesh)
+  {
+    std::ofstream out(filename, std::ios::binary);
+    auto write = [&](const void* data, std::size_t bytes) {
+      out.write(static_cast<const char*>(data), bytes);
+    };
+    const std::uint64_t header[15] = {1,
+                                      mesh.nodes.size(),
+                                      mesh.elements.size(),
+                                      mesh.elements[0].size(),
+                                      sizeof(Index),
+                                      mesh.labels.size(),
+                                      mesh.conductivities.size(),
+                                      mesh.tensors.size()};
+    write("DUNEURMS", 8);
+    write(header, sizeof(header));
+    const auto nodes = flatten(mesh.nodes);
+    write(nodes.data(), nodes.size() * sizeof(double));
+    std::vector<Index> indices;
+    for (const auto& element : mesh.elements) {
+      indices.insert(indices.end(), element.begin(), element.end());
+    }
+    indices.insert(indices.end(), mesh.labels.begin(), mesh.labels.end());
+    write(indices.data(), indices.size() * sizeof(Index));
+    const std::vector<char> padding((8 - indices.size() * sizeof(Index) % 8) % 8, 0);
+    write(padding.data(), padding.size());
+    write(mesh.conductivities.data(), mesh.conductivities.size() * sizeof(double));
+    for (const auto& tensor : mesh.tensors) {
+      for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 3; ++i) {
+          write(&tensor[i][j], sizeof(double));
+        }
+      }
+    }
+  }
+
+  void test_mesh_file(TestResult& t, const std::string& directory)
+  {
+    const auto mesh = make_mesh();
+    const std::string filename = directory + "/head.dmesh";
+    write_mesh_file<std::uint32_t>(filename, mesh);
+    FittedDriverData<3> read;
+    read_mesh_file(filename, read, 2);
+    check_mesh(t, read, mesh, "mesh file with 4 byte indices");
+
+    write_mesh_file<std::uint64_t>(filename, mesh);
+    FittedDriverData<3> wide;
+    read_mesh_file(filename, wide, 1);
+    check_mesh(t, wide, mesh, "mesh file with 8 byte indices");
+
+    auto invalid = mesh;
+    invalid.elements[1][3] = 5;
+    write_mesh_file<std::uint32_t>(filename, invalid);
+    bool thrown = false;
+    try {
+      FittedDriverData<3> rejected;
+      read_mesh_file(filename, rejected, 1);
+    } catch (Dune::Exception&) {
+      thrown = true;
+    }
+    t.check(thrown, "mesh file with an invalid node index is rejected");
+  }
+}
+
+int main()
+{
+  TestResult t;
+  char directory[] = "mesh_file_test_XXXXXX";
+  if (!mkdtemp(directory)) {
+    t.check(false, "temporary directory");
+    return t.exit_code();
+  }
+  test_mesh_file(t, directory);
+  std::system(("rm -rf " + std::string(directory)).c_str());
+  return t.exit_code();
+}
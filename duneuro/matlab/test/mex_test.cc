@@ -0,0 +1,85 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include <mex.h>
+
+#include "check.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  void test_numeric(TestResult& t)
+  {
+    mxArray* arr = mxCreateDoubleMatrix(3, 4, mxREAL);
+    t.check(mxIsDouble(arr) && mxIsNumeric(arr) && !mxIsComplex(arr), "class of a double matrix");
+    t.check(mxGetM(arr) == 3 && mxGetN(arr) == 4 && mxGetNumberOfElements(arr) == 12,
+            "size of a double matrix");
+    t.check_close(std::vector<double>(mxGetPr(arr), mxGetPr(arr) + 12), std::vector<double>(12),
+                  0.0, "double matrices are zero initialized");
+    for (std::size_t i = 0; i < 12; ++i) {
+      mxGetPr(arr)[i] = i;
+    }
+    mxArray* copy = mxDuplicateArray(arr);
+    mxGetPr(arr)[5] = -1.0;
+    t.check(mxGetPr(copy)[5] == 5.0, "duplicates do not share their data");
+    mxDestroyArray(arr);
+    mxDestroyArray(copy);
+
+    const mwSize dims[] = {2, 3, 4};
+    mxArray* single = mxCreateNumericArray(3, dims, mxSINGLE_CLASS, mxREAL);
+    t.check(mxIsSingle(single) && mxGetElementSize(single) == sizeof(float),
+            "class of a single array");
+    t.check(mxGetNumberOfDimensions(single) == 3 && mxGetM(single) == 2 && mxGetN(single) == 12,
+            "trailing dimensions are folded into the columns");
+    mxDestroyArray(single);
+  }
+
+  void test_containers(TestResult& t)
+  {
+    const char* fields[] = {"name", "values"};
+    mxArray* str = mxCreateStructMatrix(1, 1, 2, fields);
+    mxSetField(str, 0, "name", mxCreateString("eeg"));
+    mxSetField(str, 0, "values", mxCreateDoubleScalar(2.5));
+    t.check(mxIsStruct(str) && mxGetNumberOfFields(str) == 2, "fields of a struct");
+    t.check(std::string(mxGetFieldNameByNumber(str, 1)) == "values", "name of a field");
+    char* name = mxArrayToString(mxGetField(str, 0, "name"));
+    t.check(name && std::string(name) == "eeg", "string of a field");
+    mxFree(name);
+    t.check(mxGetScalar(mxGetField(str, 0, "values")) == 2.5, "scalar of a field");
+    t.check(mxGetField(str, 0, "missing") == nullptr, "missing fields are null");
+    t.check(mxAddField(str, "added") == 2 && mxGetField(str, 0, "added") == nullptr,
+            "added fields are empty");
+
+    mxArray* cell = mxCreateCellMatrix(1, 2);
+    mxSetCell(cell, 1, str);
+    t.check(mxIsCell(cell) && mxGetCell(cell, 0) == nullptr && mxGetCell(cell, 1) == str,
+            "entries of a cell array");
+    // destroying the cell destroys the struct and its fields
+    mxDestroyArray(cell);
+  }
+
+  void test_errors(TestResult& t)
+  {
+    bool thrown = false;
+    try {
+      mexErrMsgTxt("expected failure");
+    } catch (MexError& error) {
+      thrown = std::string(error.what()) == "expected failure";
+    }
+    t.check(thrown, "mexErrMsgTxt throws its message");
+  }
+}
+
+int main()
+{
+  TestResult t;
+  test_numeric(t);
+  test_containers(t);
+  test_errors(t);
+  return t.exit_code();
+}
@@ -0,0 +1,91 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <duneuro/matlab/server_protocol.hh>
+
+#include "check.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  mxArray* iota_matrix(std::size_t rows, std::size_t cols)
+  {
+    mxArray* arr = mxCreateDoubleMatrix(rows, cols, mxREAL);
+    for (std::size_t i = 0; i < rows * cols; ++i) {
+      mxGetPr(arr)[i] = i;
+    }
+    return arr;
+  }
+
+  std::string write(const mxArray* arr, SharedMemorySegments& segments)
+  {
+    std::ostringstream stream;
+    MessageWriter writer(stream);
+    writer.write_array(arr, segments);
+    return stream.str();
+  }
+
+  void test_inline(TestResult& t)
+  {
+    SharedMemorySegments segments(1 << 20);
+    mxArray* arr = iota_matrix(3, 4);
+    const auto message = write(arr, segments);
+    t.check(segments.size() == 0, "small arrays are sent inline");
+    MessageReader reader(message);
+    mxArray* read = reader.read_array();
+    t.check(mxGetM(read) == 3 && mxGetN(read) == 4, "size of an inline array");
+    t.check_close(std::vector<double>(mxGetPr(read), mxGetPr(read) + 12),
+                  std::vector<double>(mxGetPr(arr), mxGetPr(arr) + 12), 0.0,
+                  "entries of an inline array");
+    mxDestroyArray(arr);
+    mxDestroyArray(read);
+  }
+
+  void test_shared_memory(TestResult& t)
+  {
+    SharedMemorySegments client(16);
+    mxArray* arr = iota_matrix(10, 10);
+    const auto request = write(arr, client);
+    t.check(client.size() == 1, "large arrays are passed in a segment");
+    t.check(request.size() < 100 * sizeof(double), "the data of a segment is not in the message");
+    MessageReader reader(request);
+    mxArray* read = reader.read_array();
+    t.check(mxGetPr(read)[57] == 57.0, "entries of an array read from a segment");
+    mxGetPr(read)[3] = -1.0;
+    t.check(mxGetPr(arr)[3] == 3.0, "segments are mapped privately by the reader");
+
+    // arrays allocated while a reply is built are placed in segments right away
+    SharedMemorySegments server(16);
+    mxArray* reply;
+    {
+      SharedMemoryAllocation allocation(server);
+      reply = iota_matrix(20, 20);
+    }
+    t.check(server.size() == 1, "the reply is allocated in a segment");
+    const auto response = write(reply, server);
+    t.check(server.size() == 1, "the segment of the reply is passed without another copy");
+    MessageReader responseReader(response);
+    mxArray* received = responseReader.read_array();
+    t.check(mxGetPr(received)[399] == 399.0, "entries of the reply");
+
+    for (auto* a : {arr, read, reply, received}) {
+      mxDestroyArray(a);
+    }
+    client.clear();
+    server.clear();
+  }
+}
+
+int main()
+{
+  TestResult t;
+  test_inline(t);
+  test_shared_memory(t);
+  return t.exit_code();
+}
@@ -0,0 +1,86 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <duneuro/matlab/snapshot.hh>
+
+#include "check.hh"
+#include "mesh.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  ContentDigest digest_of(const std::string& content)
+  {
+    ContentHasher hasher;
+    hasher.update_string(content);
+    return hasher.finish();
+  }
+
+  void test_snapshot(TestResult& t, const std::string& directory)
+  {
+    DriverSnapshot snapshot;
+    snapshot.config["type"] = "fitted";
+    snapshot.config["solver.reduction"] = "1e-10";
+    snapshot.digest = digest_of("snapshot");
+    snapshot.mesh = make_mesh();
+    snapshot.electrodes.positions = {make_point(1, 2, 3), make_point(4, 5, 6)};
+    snapshot.electrodes.config["type"] = "normal";
+    snapshot.electrodes.digest = digest_of("electrodes");
+    snapshot.coils.positions = {make_point(0, 0, 2)};
+    snapshot.coils.projections = {make_point(1, 0, 0), make_point(0, 1, 0)};
+    snapshot.coils.projectionsPerCoil = 2;
+    snapshot.coils.digest = digest_of("coils");
+
+    const std::string filename = directory + "/driver.snapshot";
+    write_snapshot(filename, snapshot);
+    const auto read = read_snapshot(filename);
+    t.check(read.config.get<std::string>("type", "") == "fitted"
+                && read.config.get<std::string>("solver.reduction", "") == "1e-10",
+            "snapshot config");
+    t.check(read.digest == snapshot.digest, "snapshot digest");
+    check_mesh(t, read.mesh, snapshot.mesh, "snapshot");
+    t.check_close(flatten(read.electrodes.positions), flatten(snapshot.electrodes.positions), 0.0,
+                  "snapshot electrodes");
+    t.check(read.electrodes.config.get<std::string>("type", "") == "normal",
+            "snapshot electrode config");
+    t.check(read.electrodes.digest == snapshot.electrodes.digest, "snapshot electrode digest");
+    t.check_close(flatten(read.coils.positions), flatten(snapshot.coils.positions), 0.0,
+                  "snapshot coils");
+    t.check_close(flatten(read.coils.projections), flatten(snapshot.coils.projections), 0.0,
+                  "snapshot projections");
+    t.check(read.coils.projectionsPerCoil == 2, "snapshot projections per coil");
+    t.check(read.coils.digest == snapshot.coils.digest, "snapshot coil digest");
+
+    // a truncated file is rejected instead of being read partially
+    std::ifstream in(filename, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream(filename, std::ios::binary).write(content.data(), content.size() / 2);
+    bool thrown = false;
+    try {
+      read_snapshot(filename);
+    } catch (Dune::Exception&) {
+      thrown = true;
+    }
+    t.check(thrown, "truncated snapshot is rejected");
+  }
+}
+
+int main()
+{
+  TestResult t;
+  char directory[] = "snapshot_test_XXXXXX";
+  if (!mkdtemp(directory)) {
+    t.check(false, "temporary directory");
+    return t.exit_code();
+  }
+  test_snapshot(t, directory);
+  std::system(("rm -rf " + std::string(directory)).c_str());
+  return t.exit_code();
+}
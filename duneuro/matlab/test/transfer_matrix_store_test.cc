@@ -0,0 +1,60 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <duneuro/matlab/transfer_matrix_store.hh>
+
+#include "check.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  ContentDigest digest_of(const std::string& content)
+  {
+    ContentHasher hasher;
+    hasher.update_string(content);
+    return hasher.finish();
+  }
+
+  void test_store(TestResult& t, const std::string& directory)
+  {
+    TransferMatrixStore store(directory);
+    const auto key = digest_of("store");
+    t.check(!store.load(TransferMatrixStore::Type::eeg, key), "missing matrix is not loaded");
+    DenseMatrix<double> matrix(3, 4);
+    for (std::size_t i = 0; i < 3; ++i) {
+      for (std::size_t j = 0; j < 4; ++j) {
+        matrix(i, j) = 10.0 * i + j + 0.5;
+      }
+    }
+    store.save(TransferMatrixStore::Type::eeg, key, matrix);
+    auto mapped = store.load(TransferMatrixStore::Type::eeg, key);
+    t.check(mapped && mapped->rows() == 3 && mapped->cols() == 4, "size of the stored matrix");
+    if (mapped) {
+      const std::vector<double> stored(mapped->data(), mapped->data() + 12);
+      t.check_close(stored, std::vector<double>(matrix.data(), matrix.data() + 12), 0.0,
+                    "entries of the stored matrix");
+    }
+    t.check(!store.load(TransferMatrixStore::Type::meg, key), "matrices are stored per type");
+    t.check(!store.load(TransferMatrixStore::Type::eeg, digest_of("other")),
+            "matrices of other keys are not loaded");
+  }
+}
+
+int main()
+{
+  TestResult t;
+  char directory[] = "transfer_matrix_store_test_XXXXXX";
+  if (!mkdtemp(directory)) {
+    t.check(false, "temporary directory");
+    return t.exit_code();
+  }
+  test_store(t, directory);
+  std::system(("rm -rf " + std::string(directory)).c_str());
+  return t.exit_code();
+}
@@ -0,0 +1,244 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <duneuro/matlab/driver_cache.hh>
+#include <duneuro/matlab/transfer_matrix.hh>
+
+#include "check.hh"
+#include "fake_driver.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  using Type = TransferMatrixStore::Type;
+
+  DriverCache::Driver* make_driver(const std::string& name)
+  {
+    ContentHasher hasher;
+    hasher.update_string(name);
+    return DriverCache::instance().acquire(hasher.finish(), false,
+                                           []() { return std::make_unique<FakeDriver>(); });
+  }
+
+  template <class T = double>
+  std::vector<T> compute(DriverCache::Driver* driver, const Dune::ParameterTree& config, Type type)
+  {
+    std::vector<T> result;
+    auto lock = DriverCache::instance().lock(driver);
+    compute_transfer_matrix<T>(driver, config, type, [&](std::size_t nodes, std::size_t sensors) {
+      result.resize(nodes * sensors);
+      return result.data();
+    });
+    return result;
+  }
+
+  std::vector<double> compute_or_load(DriverCache::Driver* driver,
+                                      const Dune::ParameterTree& config, Type type)
+  {
+    std::vector<double> result;
+    auto lock = DriverCache::instance().lock(driver);
+    compute_or_load_transfer_matrix<double>(driver, config, type,
+                                            [&](std::size_t nodes, std::size_t sensors) {
+                                              result.resize(nodes * sensors);
+                                              return result.data();
+                                            });
+    return result;
+  }
+
+  Dune::ParameterTree partition(std::size_t count, std::size_t index)
+  {
+    Dune::ParameterTree config;
+    config["sensor_partition.count"] = std::to_string(count);
+    config["sensor_partition.index"] = std::to_string(index);
+    return config;
+  }
+
+  // concatenation of all parts of the sensors split into count parts
+  std::vector<double> compute_partitioned(DriverCache::Driver* driver, std::size_t count,
+                                          Type type)
+  {
+    std::vector<double> result;
+    for (std::size_t index = 0; index < count; ++index) {
+      const auto part = compute(driver, partition(count, index), type);
+      result.insert(result.end(), part.begin(), part.end());
+    }
+    return result;
+  }
+
+  void test_eeg(TestResult& t)
+  {
+    auto* driver = make_driver("eeg");
+    DriverCache::Electrodes electrodes;
+    for (std::size_t i = 0; i < 10; ++i) {
+      electrodes.positions.push_back(make_point(0.3 * i, 1.0 - 0.1 * i, 0.01 * i * i));
+    }
+    DriverCache::instance().set_electrodes(driver, electrodes);
+    const auto full = compute(driver, Dune::ParameterTree(), Type::eeg);
+    t.check(full.size() == 10 * 7, "size of the eeg transfer matrix");
+    for (std::size_t blockSize : {1, 3, 4, 9}) {
+      Dune::ParameterTree config;
+      config["sensor_block_size"] = std::to_string(blockSize);
+      t.check_close(compute(driver, config, Type::eeg), full, 1e-12,
+                    "eeg blocks of " + std::to_string(blockSize) + " electrodes");
+    }
+    for (std::size_t count : {2, 3, 10}) {
+      t.check_close(compute_partitioned(driver, count, Type::eeg), full, 1e-12,
+                    "eeg partitioned into " + std::to_string(count) + " parts");
+    }
+    auto* fake = static_cast<FakeDriver*>(driver);
+    t.check(fake->electrodes().size() == 10, "all electrodes are set again after blocks");
+    DriverCache::instance().release(driver);
+  }
+
+  void test_meg(TestResult& t)
+  {
+    auto* driver = make_driver("meg");
+    DriverCache::Coils coils;
+    coils.projectionsPerCoil = 2;
+    for (std::size_t i = 0; i < 5; ++i) {
+      coils.positions.push_back(make_point(1.0 * i, 0.5 * i, 1.0));
+      coils.projections.push_back(make_point(1.0 + i, 0.0, 0.0));
+      coils.projections.push_back(make_point(0.0, 1.0 + i, 0.0));
+    }
+    DriverCache::instance().set_coils(driver, coils);
+    const auto full = compute(driver, Dune::ParameterTree(), Type::meg);
+    t.check(full.size() == 10 * 7, "size of the meg transfer matrix");
+    Dune::ParameterTree config;
+    config["sensor_block_size"] = "2";
+    t.check_close(compute(driver, config, Type::meg), full, 1e-12, "meg blocks of 2 coils");
+    t.check_close(compute_partitioned(driver, 2, Type::meg), full, 1e-12,
+                  "meg partitioned into 2 parts");
+    DriverCache::instance().release(driver);
+  }
+
+  // single precision matrices are narrowed copies of the unblocked double matrix. Applying them
+  // has to be requested, and their widened copy gives the results of the double matrix up to
+  // single precision
+  void test_single(TestResult& t)
+  {
+    auto* driver = make_driver("single");
+    DriverCache::Electrodes electrodes;
+    for (std::size_t i = 0; i < 8; ++i) {
+      electrodes.positions.push_back(make_point(0.1 * i, 2.0 - 0.3 * i, 0.05 * i));
+    }
+    DriverCache::instance().set_electrodes(driver, electrodes);
+    const auto full = compute(driver, Dune::ParameterTree(), Type::eeg);
+    Dune::ParameterTree single;
+    single["precision"] = "single";
+    const auto narrowed = compute<float>(driver, single, Type::eeg);
+    t.check_close(narrowed, full, 1e-6, "single precision eeg matrix");
+    auto blocked = single;
+    blocked["sensor_block_size"] = "3";
+    t.check(compute<float>(driver, blocked, Type::eeg) == narrowed,
+            "blocked single precision eeg matrix");
+    auto part = single;
+    part["sensor_partition.count"] = "2";
+    part["sensor_partition.index"] = "1";
+    t.check(compute<float>(driver, part, Type::eeg)
+                == std::vector<float>(narrowed.begin() + 4 * 7, narrowed.end()),
+            "partitioned single precision eeg matrix");
+
+    auto lock = DriverCache::instance().lock(driver);
+    bool rejected = false;
+    try {
+      widen_transfer_matrix(driver, Type::eeg, SingleTransferMatrix{narrowed.data(), 8, 7}, single);
+    } catch (Dune::Exception&) {
+      rejected = true;
+    }
+    t.check(rejected, "applying a single precision matrix requires apply.widen_single");
+    single["apply.widen_single"] = "true";
+    auto widened = widen_transfer_matrix(driver, Type::eeg,
+                                         SingleTransferMatrix{narrowed.data(), 8, 7}, single);
+    t.check_close(std::vector<double>(widened->data(), widened->data() + 8 * 7), narrowed, 0.0,
+                  "widened single precision matrix");
+    std::vector<DriverCache::Driver::DipoleType> dipoles;
+    for (std::size_t i = 0; i < 4; ++i) {
+      dipoles.emplace_back(make_point(0.1 * i, 0.2, 0.3 * i), make_point(1.0, -0.5 * i, 0.25));
+    }
+    DenseMatrix<double> reference(8, 7);
+    std::copy(full.begin(), full.end(), reference.data());
+    const auto expected = driver->applyEEGTransfer(reference, dipoles, Dune::ParameterTree());
+    const auto actual = driver->applyEEGTransfer(*widened, dipoles, Dune::ParameterTree());
+    for (std::size_t i = 0; i < dipoles.size(); ++i) {
+      t.check_close(actual[i], expected[i], 1e-5,
+                    "single precision result of dipole " + std::to_string(i));
+    }
+
+    bool thrown = false;
+    try {
+      widen_transfer_matrix(driver, Type::eeg, SingleTransferMatrix{narrowed.data(), 4, 7}, single);
+    } catch (Dune::Exception&) {
+      thrown = true;
+    }
+    t.check(thrown, "widening a matrix of a part of the sensors is rejected");
+    lock.unlock();
+    DriverCache::instance().release(driver);
+  }
+
+  // parts of the sensors are sliced from a stored full matrix, and are never stored themselves
+  void test_store(TestResult& t)
+  {
+    char directory[] = "transfer_matrix_test_XXXXXX";
+    if (!mkdtemp(directory)) {
+      t.check(false, "temporary directory for the store");
+      return;
+    }
+    auto* driver = make_driver("store");
+    DriverCache::Electrodes electrodes;
+    for (std::size_t i = 0; i < 6; ++i) {
+      electrodes.positions.push_back(make_point(0.2 * i, 0.5, 0.1 * i));
+    }
+    DriverCache::instance().set_electrodes(driver, electrodes);
+    auto* fake = static_cast<FakeDriver*>(driver);
+    const auto full = compute(driver, Dune::ParameterTree(), Type::eeg);
+
+    auto stored = partition(2, 1);
+    stored["transfer_matrix_store.path"] = directory;
+    const auto part = compute_or_load(driver, stored, Type::eeg);
+    t.check_close(part, std::vector<double>(full.begin() + 3 * 7, full.end()), 1e-12,
+                  "part computed without a stored matrix");
+    const std::size_t before = fake->computations();
+
+    Dune::ParameterTree whole;
+    whole["transfer_matrix_store.path"] = directory;
+    t.check_close(compute_or_load(driver, whole, Type::eeg), full, 1e-12, "stored full matrix");
+    const std::size_t computed = fake->computations();
+    t.check(computed > before, "the part was not stored in place of the full matrix");
+
+    t.check_close(compute_or_load(driver, stored, Type::eeg), part, 1e-12,
+                  "part sliced from the stored matrix");
+    stored["sensor_block_size"] = "2";
+    t.check_close(compute_or_load(driver, stored, Type::eeg), part, 1e-12,
+                  "blocked part sliced from the stored matrix");
+    t.check(fake->computations() == computed, "parts are loaded from the stored full matrix");
+
+    stored["transfer_matrix_store.mapped"] = "true";
+    bool thrown = false;
+    try {
+      compute_or_load(driver, stored, Type::eeg);
+    } catch (Dune::Exception&) {
+      thrown = true;
+    }
+    t.check(thrown, "mapping a part of the stored matrix is rejected");
+
+    DriverCache::instance().release(driver);
+    std::system(("rm -rf " + std::string(directory)).c_str());
+  }
+}
+
+int main()
+{
+  TestResult t;
+  test_eeg(t);
+  test_meg(t);
+  test_single(t);
+  test_store(t);
+  return t.exit_code();
+}
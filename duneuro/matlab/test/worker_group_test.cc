@@ -0,0 +1,87 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <duneuro/matlab/worker_group.hh>
+
+#include "check.hh"
+
+using namespace duneuro;
+
+namespace
+{
+  // entry (i, j) of the block of a rank
+  double entry(int rank, std::size_t i, std::size_t j)
+  {
+    return 100.0 * rank + 10.0 * j + i;
+  }
+
+  // every rank contributes rank + 1 columns of three rows
+  mxArray* block(int rank)
+  {
+    mxArray* arr = mxCreateDoubleMatrix(3, rank + 1, mxREAL);
+    for (std::size_t j = 0; j < static_cast<std::size_t>(rank + 1); ++j) {
+      for (std::size_t i = 0; i < 3; ++i) {
+        mxGetPr(arr)[j * 3 + i] = entry(rank, i, j);
+      }
+    }
+    return arr;
+  }
+
+  void check_gathered(TestResult& t, const mxArray* gathered, int size)
+  {
+    const std::size_t columns = size * (size + 1) / 2;
+    t.check(gathered && mxIsDouble(gathered) && mxGetM(gathered) == 3
+                && mxGetN(gathered) == columns,
+            "size of the gathered matrix of " + std::to_string(size) + " ranks");
+    if (!gathered || mxGetN(gathered) != columns) {
+      return;
+    }
+    std::vector<double> expected;
+    for (int rank = 0; rank < size; ++rank) {
+      for (std::size_t j = 0; j < static_cast<std::size_t>(rank + 1); ++j) {
+        for (std::size_t i = 0; i < 3; ++i) {
+          expected.push_back(entry(rank, i, j));
+        }
+      }
+    }
+    t.check_close(std::vector<double>(mxGetPr(gathered), mxGetPr(gathered) + 3 * columns),
+                  expected, 0.0, "blocks are concatenated in the order of the ranks");
+  }
+}
+
+int main(int argc, char** argv)
+{
+  TestResult t;
+  // the workers are forked first, as no thread may be running at that point
+  auto group = WorkerGroup::create(argc, argv, 3);
+  mxArray* local = block(group->rank());
+  mxArray* gathered = gather_columns(*group, local);
+  mxDestroyArray(local);
+  if (group->rank() != 0) {
+    return group->finish(gathered == nullptr ? 0 : 1);
+  }
+  t.check(group->size() == 3, "number of local workers");
+  check_gathered(t, gathered, group->size());
+  if (gathered) {
+    mxDestroyArray(gathered);
+  }
+  // rank 0 fails if one of the workers failed
+  const int status = group->finish(t.exit_code());
+  t.check(status == t.exit_code(), "all workers finished successfully");
+
+  auto single = WorkerGroup::create(argc, argv, 1);
+  local = block(0);
+  gathered = gather_columns(*single, local);
+  mxDestroyArray(local);
+  check_gathered(t, gathered, 1);
+  if (gathered) {
+    mxDestroyArray(gathered);
+  }
+  single->finish(0);
+  return t.exit_code();
+}
@@ -0,0 +1,628 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/transfer_matrix.hh>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/driver_cache.hh>
+#include <duneuro/matlab/parallel.hh>
+#include <duneuro/matlab/spatial_order.hh>
+#include <duneuro/matlab/utilities.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    std::size_t number_of_sensors(DriverInterface<3>* driver, TransferMatrixStore::Type type)
+    {
+      auto& cache = DriverCache::instance();
+      return type == TransferMatrixStore::Type::eeg ? cache.electrodes(driver).positions.size()
+                                                    : cache.coils(driver).positions.size();
+    }
+
+    // rows of the transfer matrix of all sensors, meg sensors have a row per projection
+    std::size_t number_of_rows(DriverInterface<3>* driver, TransferMatrixStore::Type type)
+    {
+      if (type == TransferMatrixStore::Type::eeg) {
+        return DriverCache::instance().electrodes(driver).positions.size();
+      }
+      const auto coils = DriverCache::instance().coils(driver);
+      return coils.positions.size() * coils.projectionsPerCoil;
+    }
+
+    /**
+     * the sensors [first, last) selected by the sensor_partition sub tree, all sensors if it is
+     * not set. The sensors are split into sensor_partition.count contiguous parts whose sizes
+     * differ by at most one, sensor_partition.index (counted from 0) selects one of them.
+     */
+    std::pair<std::size_t, std::size_t> sensor_partition(const Dune::ParameterTree& config,
+                                                         std::size_t sensors)
+    {
+      if (!config.hasSub("sensor_partition")) {
+        return {0, sensors};
+      }
+      const auto& partition = config.sub("sensor_partition");
+      const auto count = partition.get<std::size_t>("count");
+      const auto index = partition.get<std::size_t>("index");
+      if (count == 0 || count > sensors) {
+        DUNE_THROW(Dune::Exception, "sensor_partition.count " << count
+                                                             << " has to be between 1 and the "
+                                                             << "number of sensors " << sensors);
+      }
+      if (index >= count) {
+        DUNE_THROW(Dune::Exception, "sensor_partition.index " << index
+                                                             << " has to be smaller than "
+                                                             << count);
+      }
+      return {index * sensors / count, (index + 1) * sensors / count};
+    }
+
+    // rows [first, last) of the full transfer matrix which are selected by sensor_partition
+    struct SelectedRows {
+      std::size_t first;
+      std::size_t last;
+      std::size_t total;
+
+      bool partial() const
+      {
+        return last - first != total;
+      }
+    };
+
+    SelectedRows selected_rows(DriverInterface<3>* driver, const Dune::ParameterTree& config,
+                               TransferMatrixStore::Type type)
+    {
+      const std::size_t sensors = number_of_sensors(driver, type);
+      const auto partition = sensor_partition(config, sensors);
+      const std::size_t rowsPerSensor =
+          type == TransferMatrixStore::Type::eeg
+              ? 1
+              : DriverCache::instance().coils(driver).projectionsPerCoil;
+      return {partition.first * rowsPerSensor, partition.second * rowsPerSensor,
+              sensors * rowsPerSensor};
+    }
+
+    /**
+     * replaces the sensors set on a driver by parts of the sensors recorded in the driver cache
+     *
+     * the recorded sensors are not changed, so readers of the driver cache always see the sensors
+     * set by the user. All recorded sensors are set on the driver again by restore, or on
+     * destruction if restore was not called, e.g. because an exception was thrown. The lock of the
+     * driver has to be held while the object is alive.
+     */
+    class SensorSubset
+    {
+    public:
+      SensorSubset(DriverInterface<3>* driver, TransferMatrixStore::Type type)
+          : driver_(driver), eeg_(type == TransferMatrixStore::Type::eeg), changed_(false)
+      {
+        auto& cache = DriverCache::instance();
+        if (eeg_) {
+          electrodes_ = cache.electrodes(driver);
+        } else {
+          coils_ = cache.coils(driver);
+        }
+      }
+
+      ~SensorSubset()
+      {
+        if (changed_) {
+          try {
+            restore();
+          } catch (...) {
+            // already unwinding, the original error is more relevant
+          }
+        }
+      }
+
+      SensorSubset(const SensorSubset&) = delete;
+      SensorSubset& operator=(const SensorSubset&) = delete;
+
+      /** transfer matrix rows of each sensor */
+      std::size_t rows_per_sensor() const
+      {
+        return eeg_ ? 1 : coils_.projectionsPerCoil;
+      }
+
+      /**
+       * set the sensors [begin, end) on the driver. If prependReference is set, electrode 0 is
+       * set in front of them
+       */
+      void select(std::size_t begin, std::size_t end, bool prependReference)
+      {
+        changed_ = true;
+        if (eeg_) {
+          DriverCache::Electrodes subset;
+          if (prependReference) {
+            subset.positions.push_back(electrodes_.positions[0]);
+          }
+          subset.positions.insert(subset.positions.end(), electrodes_.positions.begin() + begin,
+                                  electrodes_.positions.begin() + end);
+          subset.config = electrodes_.config;
+          DriverCache::set_driver_electrodes(driver_, subset);
+        } else {
+          DriverCache::Coils subset;
+          subset.positions.assign(coils_.positions.begin() + begin,
+                                  coils_.positions.begin() + end);
+          subset.projections.assign(coils_.projections.begin() + begin * coils_.projectionsPerCoil,
+                                    coils_.projections.begin() + end * coils_.projectionsPerCoil);
+          subset.projectionsPerCoil = coils_.projectionsPerCoil;
+          DriverCache::set_driver_coils(driver_, subset);
+        }
+      }
+
+      /** set all recorded sensors on the driver again */
+      void restore()
+      {
+        if (eeg_) {
+          DriverCache::set_driver_electrodes(driver_, electrodes_);
+        } else {
+          DriverCache::set_driver_coils(driver_, coils_);
+        }
+        changed_ = false;
+      }
+
+    private:
+      DriverInterface<3>* driver_;
+      bool eeg_;
+      bool changed_;
+      DriverCache::Electrodes electrodes_;
+      DriverCache::Coils coils_;
+    };
+
+    /**
+     * call f(rowBegin, rowEnd, referenced) for consecutive blocks of at most blockSize of the
+     * sensors [first, last), with the sensors set on the driver replaced by the current block, see
+     * SensorSubset. Rows refer to the rows of the transfer matrix of the sensors [first, last).
+     *
+     * The driver references the eeg transfer matrix to the first electrode it is given. Electrode
+     * 0 is thus set in front of every eeg block which does not start with it, and referenced is
+     * true for these blocks. The first row of the matrix
+     * computed for such a block belongs to the reference and is not part of [rowBegin, rowEnd).
+     */
+    template <class F>
+    void for_each_sensor_block(DriverInterface<3>* driver, TransferMatrixStore::Type type,
+                               std::size_t first, std::size_t last, std::size_t blockSize,
+                               F&& f)
+    {
+      const bool eeg = type == TransferMatrixStore::Type::eeg;
+      SensorSubset subset(driver, type);
+      std::size_t rowBegin = 0;
+      for (std::size_t begin = first; begin < last; begin += blockSize) {
+        const std::size_t end = std::min(last, begin + blockSize);
+        const bool referenced = eeg && begin > 0;
+        subset.select(begin, end, referenced);
+        const std::size_t blockRows = (end - begin) * subset.rows_per_sensor();
+        f(rowBegin, rowBegin + blockRows, referenced);
+        rowBegin += blockRows;
+      }
+      subset.restore();
+    }
+
+    /**
+     * order in which the entries of the input are processed, empty for the original order
+     *
+     * unless apply.reorder is false, inputs with at least apply.reorder_threshold entries are
+     * processed along a morton curve through their positions, so that consecutive dipoles are
+     * mostly located in neighboring elements of the mesh.
+     */
+    std::vector<std::size_t> processing_order(const TransferInput& input,
+                                              const Dune::ParameterTree& config)
+    {
+      if (!config.get<bool>("apply.reorder", true)
+          || input.count < config.get<std::size_t>("apply.reorder_threshold", 4096)) {
+        return {};
+      }
+      ScopedPhase phase("reorder_dipoles");
+      return morton_order(input.data, input.count, input.positions ? 3 : 6);
+    }
+
+    // dipoles of the entries order[begin, end) of the input, see TransferInput
+    std::vector<Dipole<double, 3>> make_input_dipoles(const TransferInput& input,
+                                                      const std::vector<std::size_t>& order,
+                                                      std::size_t begin, std::size_t end)
+    {
+      if (order.empty() && !input.positions) {
+        return make_dipoles(input.data + 6 * begin, end - begin);
+      }
+      std::vector<Dipole<double, 3>> output;
+      output.reserve(input.positions ? 3 * (end - begin) : end - begin);
+      for (std::size_t k = begin; k < end; ++k) {
+        const std::size_t entry = order.empty() ? k : order[k];
+        if (!input.positions) {
+          const double* ptr = input.data + 6 * entry;
+          Dune::FieldVector<double, 3> pos, mom;
+          std::copy(ptr, ptr + 3, pos.begin());
+          std::copy(ptr + 3, ptr + 6, mom.begin());
+          output.push_back(Dipole<double, 3>(pos, mom));
+          continue;
+        }
+        const double* ptr = input.data + 3 * entry;
+        Dune::FieldVector<double, 3> pos;
+        std::copy(ptr, ptr + 3, pos.begin());
+        for (unsigned int d = 0; d < 3; ++d) {
+          Dune::FieldVector<double, 3> mom(0.0);
+          mom[d] = 1.0;
+          output.push_back(Dipole<double, 3>(pos, mom));
+        }
+      }
+      return output;
+    }
+
+    // a transfer matrix together with its application and the output of its results
+    struct ApplyTarget {
+      const DenseMatrix<double>& tm;
+      const TransferApplication& apply;
+      double* out;
+      std::size_t stride;
+    };
+
+    /**
+     * apply the rows of each target matrix to all dipoles of the input, writing the result of the
+     * i-th dipole to out + i * stride of the target. The entries are processed in the given
+     * order, see processing_order, and the results are scattered back to the original positions.
+     * Blocks always contain all three dipoles of a position, so that they are passed to the driver
+     * next to each other. The dipoles of a block are created once and passed to all targets.
+     */
+    void apply_rows(const std::vector<ApplyTarget>& targets, const TransferInput& input,
+                    const std::vector<std::size_t>& order, const Dune::ParameterTree& config)
+    {
+      const std::size_t dipolesPerEntry = input.positions ? 3 : 1;
+      const std::size_t blockSize = config.get<std::size_t>("apply.block_size", 1024);
+      parallel_for_blocks(
+          input.count, std::max<std::size_t>(1, blockSize / dipolesPerEntry),
+          config.get<unsigned int>("apply.threads", 1), [&](std::size_t begin, std::size_t end) {
+            const auto dipoles = make_input_dipoles(input, order, begin, end);
+            for (const auto& target : targets) {
+              const auto result = target.apply(target.tm, dipoles);
+              if (result.size() != dipoles.size()) {
+                DUNE_THROW(Dune::Exception, "unexpected number of apply results");
+              }
+              for (std::size_t i = 0; i < result.size(); ++i) {
+                const auto& r = result[i];
+                if (r.size() != target.tm.rows()) {
+                  DUNE_THROW(Dune::Exception, "unexpected size of apply result");
+                }
+                const std::size_t k = begin + i / dipolesPerEntry;
+                const std::size_t entry = order.empty() ? k : order[k];
+                const std::size_t column = entry * dipolesPerEntry + i % dipolesPerEntry;
+                std::copy(r.begin(), r.end(), target.out + column * target.stride);
+              }
+            }
+          });
+    }
+
+    // the computed matrix is written directly into double outputs, other precisions are converted
+    double* direct_output(const TransferMatrixAllocator<double>& allocate, std::size_t nodes,
+                          std::size_t sensors)
+    {
+      return allocate(nodes, sensors);
+    }
+
+    double* direct_output(const TransferMatrixAllocator<float>&, std::size_t, std::size_t)
+    {
+      return nullptr;
+    }
+
+    /**
+     * compute the transfer matrix of the sensors selected by sensor_partition. If the sensors are
+     * not split, the matrix computed by the driver is returned as is. Otherwise the blocks of
+     * sensor_block_size sensors are copied into the buffer provided by allocate as soon as they
+     * are computed, and nullptr is returned.
+     */
+    template <class T>
+    std::unique_ptr<DenseMatrix<double>>
+    compute_sensor_blocks(DriverInterface<3>* driver, const Dune::ParameterTree& config,
+                          TransferMatrixStore::Type type, const TransferMatrixAllocator<T>& allocate)
+    {
+      const bool eeg = type == TransferMatrixStore::Type::eeg;
+      auto compute = [&]() {
+        return eeg ? driver->computeEEGTransferMatrix(config)
+                   : driver->computeMEGTransferMatrix(config);
+      };
+      const std::size_t sensors = number_of_sensors(driver, type);
+      const auto partition = sensor_partition(config, sensors);
+      const std::size_t selected = partition.second - partition.first;
+      std::size_t blockSize = config.get<std::size_t>("sensor_block_size", 0);
+      if (selected == sensors && (blockSize == 0 || blockSize >= sensors)) {
+        return compute();
+      }
+      if (blockSize == 0) {
+        blockSize = selected;
+      }
+      const std::size_t rows =
+          eeg ? selected : selected * DriverCache::instance().coils(driver).projectionsPerCoil;
+      T* out = nullptr;
+      std::size_t cols = 0;
+      auto copyBlock = [&](std::size_t rowBegin, std::size_t rowEnd, bool referenced) {
+        auto tm = compute();
+        if (!out) {
+          cols = tm->cols();
+          out = allocate(cols, rows);
+        }
+        const std::size_t offset = referenced ? 1 : 0;
+        if (tm->rows() != rowEnd - rowBegin + offset || tm->cols() != cols) {
+          DUNE_THROW(Dune::Exception, "transfer matrix of sensor block has unexpected size");
+        }
+        ScopedPhase phase("copy_result", (rowEnd - rowBegin) * cols * sizeof(T));
+        const double* source = tm->data() + offset * cols;
+        if (!referenced) {
+          std::copy(source, source + (rowEnd - rowBegin) * cols, out + rowBegin * cols);
+          return;
+        }
+        // the rows are relative to the reference electrode. Its own row is subtracted as well,
+        // in case the driver does not leave it zero
+        const double* reference = tm->data();
+        for (std::size_t row = 0; row < rowEnd - rowBegin; ++row) {
+          T* target = out + (rowBegin + row) * cols;
+          for (std::size_t col = 0; col < cols; ++col) {
+            target[col] = static_cast<T>(source[row * cols + col] - reference[col]);
+          }
+        }
+      };
+      for_each_sensor_block(driver, type, partition.first, partition.second, blockSize, copyBlock);
+      return nullptr;
+    }
+
+    // key of the transfer matrix of the driver in the store, see compute_or_load_transfer_matrix
+    ContentDigest transfer_matrix_key(DriverInterface<3>* driver, const Dune::ParameterTree& config,
+                                      TransferMatrixStore::Type type)
+    {
+      auto& cache = DriverCache::instance();
+      const auto driverDigest = cache.digest(driver);
+      if (driverDigest.empty()) {
+        DUNE_THROW(Dune::Exception, "the transfer matrix store identifies drivers by their digest, "
+                                    "please create the driver with driver_cache.enable or "
+                                    "driver_cache.digest set");
+      }
+      ContentHasher hasher;
+      hasher.update_digest(driverDigest);
+      // the precision only affects the output, the store always holds double matrices. Blocks and
+      // partitions of the sensors do not change the matrix, only the full matrix is stored
+      digest_parametertree(hasher, config, {"transfer_matrix_store", "precision",
+                                            "sensor_block_size", "sensor_partition"});
+      hasher.update_value(type);
+      hasher.update_digest(type == TransferMatrixStore::Type::eeg ? cache.electrodes(driver).digest
+                                                                   : cache.coils(driver).digest);
+      return hasher.finish();
+    }
+
+    // mapped results are the stored matrices themselves, which always hold all sensors
+    void check_stored_partition(const SelectedRows& rows, bool mapped)
+    {
+      if (rows.partial() && mapped) {
+        DUNE_THROW(Dune::Exception, "a sensor_partition can not be mapped from the transfer "
+                                    "matrix store, please set transfer_matrix_store.mapped to "
+                                    "false");
+      }
+    }
+
+    void check_stored_rows(const MappedTransferMatrix& matrix, const SelectedRows& rows)
+    {
+      if (matrix.rows() != rows.total) {
+        DUNE_THROW(Dune::Exception, "stored transfer matrix has " << matrix.rows()
+                                                                  << " rows, expected "
+                                                                  << rows.total);
+      }
+    }
+  }
+
+  bool single_precision(const Dune::ParameterTree& config)
+  {
+    const auto precision = config.get<std::string>("precision", "double");
+    if (precision != "double" && precision != "single") {
+      DUNE_THROW(Dune::Exception,
+                 "unknown precision \"" << precision << "\", expected double or single");
+    }
+    return precision == "single";
+  }
+
+  void check_single_precision_apply(const Dune::ParameterTree& config)
+  {
+    if (!config.get<bool>("apply.widen_single", false)) {
+      DUNE_THROW(Dune::Exception,
+                 "single precision transfer matrices are a storage format, applying one widens a "
+                 "double copy of it. Convert it with double() or set apply.widen_single");
+    }
+  }
+
+  template <class T>
+  void compute_transfer_matrix(DriverInterface<3>* driver, const Dune::ParameterTree& config,
+                               TransferMatrixStore::Type type,
+                               const TransferMatrixAllocator<T>& allocate)
+  {
+    if (auto tm = compute_sensor_blocks(driver, config, type, allocate)) {
+      ScopedPhase phase("copy_result", tm->rows() * tm->cols() * sizeof(T));
+      std::copy(tm->data(), tm->data() + tm->rows() * tm->cols(), allocate(tm->cols(), tm->rows()));
+    }
+  }
+
+  template <class T>
+  std::unique_ptr<MappedTransferMatrix>
+  compute_or_load_transfer_matrix(DriverInterface<3>* driver, const Dune::ParameterTree& config,
+                                  TransferMatrixStore::Type type,
+                                  const TransferMatrixAllocator<T>& allocate)
+  {
+    if (!config.hasSub("transfer_matrix_store")) {
+      compute_transfer_matrix<T>(driver, config, type, allocate);
+      return nullptr;
+    }
+    const auto& storeConfig = config.sub("transfer_matrix_store");
+    const bool mapped = storeConfig.get<bool>("mapped", false);
+    const auto rows = selected_rows(driver, config, type);
+    check_stored_partition(rows, mapped);
+    TransferMatrixStore store(storeConfig.get<std::string>("path"));
+    const auto key = transfer_matrix_key(driver, config, type);
+    auto matrix = store.load(type, key);
+    if (!matrix && rows.partial()) {
+      // only full matrices are stored, so a part is computed without storing it
+      compute_transfer_matrix<T>(driver, config, type, allocate);
+      return nullptr;
+    }
+    if (!matrix) {
+      std::vector<double> buffer;
+      std::size_t nodes = 0;
+      std::size_t nsensors = 0;
+      double* out = nullptr;
+      compute_transfer_matrix<double>(driver, config, type, [&](std::size_t m, std::size_t n) {
+        nodes = m;
+        nsensors = n;
+        // a mapped result is read back from the store and outputs in other precisions are
+        // converted, so the computed matrix is only temporary in these cases
+        out = mapped ? nullptr : direct_output(allocate, m, n);
+        if (!out) {
+          buffer.resize(m * n);
+          out = buffer.data();
+        }
+        return out;
+      });
+      store.save(type, key, DenseMatrix<double>(nsensors, nodes, out));
+      if (!mapped) {
+        if (!buffer.empty()) {
+          ScopedPhase phase("copy_result", buffer.size() * sizeof(T));
+          std::copy(buffer.begin(), buffer.end(), allocate(nodes, nsensors));
+        }
+        return nullptr;
+      }
+      buffer = std::vector<double>();
+      matrix = store.load(type, key);
+    }
+    if (mapped) {
+      return matrix;
+    }
+    check_stored_rows(*matrix, rows);
+    const std::size_t cols = matrix->cols();
+    ScopedPhase phase("copy_result", (rows.last - rows.first) * cols * sizeof(T));
+    std::copy(matrix->data() + rows.first * cols, matrix->data() + rows.last * cols,
+              allocate(cols, rows.last - rows.first));
+    return nullptr;
+  }
+
+  template void compute_transfer_matrix<double>(DriverInterface<3>*, const Dune::ParameterTree&,
+                                                TransferMatrixStore::Type,
+                                                const TransferMatrixAllocator<double>&);
+  template void compute_transfer_matrix<float>(DriverInterface<3>*, const Dune::ParameterTree&,
+                                               TransferMatrixStore::Type,
+                                               const TransferMatrixAllocator<float>&);
+  template std::unique_ptr<MappedTransferMatrix>
+  compute_or_load_transfer_matrix<double>(DriverInterface<3>*, const Dune::ParameterTree&,
+                                          TransferMatrixStore::Type,
+                                          const TransferMatrixAllocator<double>&);
+  template std::unique_ptr<MappedTransferMatrix>
+  compute_or_load_transfer_matrix<float>(DriverInterface<3>*, const Dune::ParameterTree&,
+                                         TransferMatrixStore::Type,
+                                         const TransferMatrixAllocator<float>&);
+
+  std::size_t ComputedTransferMatrix::rows() const
+  {
+    return computed ? computed->rows() : storedRows.second - storedRows.first;
+  }
+
+  std::size_t ComputedTransferMatrix::cols() const
+  {
+    return computed ? computed->cols() : stored->cols();
+  }
+
+  const double* ComputedTransferMatrix::data() const
+  {
+    return computed ? computed->data() : stored->data() + storedRows.first * stored->cols();
+  }
+
+  ComputedTransferMatrix compute_or_load_transfer_matrix(DriverInterface<3>* driver,
+                                                         const Dune::ParameterTree& config,
+                                                         TransferMatrixStore::Type type)
+  {
+    ComputedTransferMatrix result;
+    TransferMatrixAllocator<double> allocate = [&](std::size_t nodes, std::size_t sensors) {
+      result.computed = std::make_unique<DenseMatrix<double>>(sensors, nodes);
+      return result.computed->data();
+    };
+    if (!config.hasSub("transfer_matrix_store")) {
+      if (auto tm = compute_sensor_blocks(driver, config, type, allocate)) {
+        result.computed = std::move(tm);
+      }
+      return result;
+    }
+    const auto& storeConfig = config.sub("transfer_matrix_store");
+    result.mapped = storeConfig.get<bool>("mapped", false);
+    const auto rows = selected_rows(driver, config, type);
+    check_stored_partition(rows, result.mapped);
+    TransferMatrixStore store(storeConfig.get<std::string>("path"));
+    const auto key = transfer_matrix_key(driver, config, type);
+    result.stored = store.load(type, key);
+    if (result.stored) {
+      check_stored_rows(*result.stored, rows);
+      result.storedRows = {rows.first, rows.last};
+      return result;
+    }
+    if (auto tm = compute_sensor_blocks(driver, config, type, allocate)) {
+      result.computed = std::move(tm);
+    }
+    // only full matrices are stored
+    if (rows.partial()) {
+      return result;
+    }
+    store.save(type, key, *result.computed);
+    if (result.mapped) {
+      result.computed.reset();
+      result.stored = store.load(type, key);
+      result.storedRows = {0, rows.total};
+    }
+    return result;
+  }
+
+  void apply_transfer_blocked(const DenseMatrix<double>& tm, const TransferInput& input,
+                              const Dune::ParameterTree& config, double* out,
+                              const TransferApplication& apply)
+  {
+    apply_rows({ApplyTarget{tm, apply, out, tm.rows()}}, input, processing_order(input, config),
+               config);
+  }
+
+  std::unique_ptr<DenseMatrix<double>> widen_transfer_matrix(const SingleTransferMatrix& tm,
+                                                             const Dune::ParameterTree& config)
+  {
+    const std::size_t n = tm.rows * tm.cols;
+    auto widened = std::make_unique<DenseMatrix<double>>(tm.rows, tm.cols);
+    ScopedPhase phase("widen_transfer_matrix", n * sizeof(float));
+    double* target = widened->data();
+    parallel_for_blocks(n, 1 << 16,
+                        config.get<unsigned int>("apply.threads", 1),
+                        [&](std::size_t begin, std::size_t end) {
+                          std::copy(tm.data + begin, tm.data + end, target + begin);
+                        });
+    return widened;
+  }
+
+  std::unique_ptr<DenseMatrix<double>> widen_transfer_matrix(DriverInterface<3>* driver,
+                                                             TransferMatrixStore::Type type,
+                                                             const SingleTransferMatrix& tm,
+                                                             const Dune::ParameterTree& config)
+  {
+    check_single_precision_apply(config);
+    const std::size_t rows = number_of_rows(driver, type);
+    if (tm.rows != rows) {
+      DUNE_THROW(Dune::Exception, "transfer matrix has " << tm.rows << " rows, but the sensors of "
+                                                         << "the driver have " << rows);
+    }
+    return widen_transfer_matrix(tm, config);
+  }
+
+  void apply_meeg_transfer_blocked(const DenseMatrix<double>& eegTm,
+                                   const DenseMatrix<double>& megTm, const TransferInput& input,
+                                   const Dune::ParameterTree& config, double* eegOut,
+                                   double* megOut, const TransferApplication& applyEEG,
+                                   const TransferApplication& applyMEG)
+  {
+    apply_rows({ApplyTarget{eegTm, applyEEG, eegOut, eegTm.rows()},
+                ApplyTarget{megTm, applyMEG, megOut, megTm.rows()}},
+               input, processing_order(input, config), config);
+  }
+}
@@ -0,0 +1,224 @@
+#ifndef DUNEURO_MATLAB_TRANSFER_MATRIX_HH
+#define DUNEURO_MATLAB_TRANSFER_MATRIX_HH
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <dune/common/parametertree.hh>
+
+#include <duneuro/common/dense_matrix.hh>
+#include <duneuro/common/dipole.hh>
+#include <duneuro/driver/driver_factory.hh>
+
+#include <duneuro/matlab/transfer_matrix_store.hh>
+
+namespace duneuro
+{
+  /**
+   * \brief allocator for transfer matrix outputs
+   *
+   * called once with the matlab dimensions (nodes x sensors) of the matrix, returns a buffer of
+   * that size in column major layout. T is double or float.
+   */
+  template <class T>
+  using TransferMatrixAllocator = std::function<T*(std::size_t nodes, std::size_t sensors)>;
+
+  /**
+   * \brief computes the transfer of a block of dipoles, one vector of sensor values per dipole
+   *
+   * the matrix passed is either the full transfer matrix or a block of its rows, see
+   * apply_transfer_blocked.
+   */
+  using TransferApplication = std::function<std::vector<std::vector<double>>(
+      const DenseMatrix<double>&, const std::vector<Dipole<double, 3>>&)>;
+
+  /** \brief row major (sensors x nodes) transfer matrix in single precision, not owning its data */
+  struct SingleTransferMatrix {
+    const float* data;
+    std::size_t rows;
+    std::size_t cols;
+  };
+
+  /**
+   * \brief dipoles to apply a transfer matrix to
+   *
+   * either count dipoles stored as 6xN doubles, or count source positions stored as 3xN doubles.
+   * Each position stands for three dipoles with unit moments in x, y and z direction, in this
+   * order, so that the result of applying the transfer matrix is the leadfield of the positions.
+   */
+  struct TransferInput {
+    const double* data;
+    std::size_t count;
+    bool positions;
+
+    /** \brief number of dipoles, i.e. columns of the result */
+    std::size_t columns() const
+    {
+      return positions ? 3 * count : count;
+    }
+  };
+
+  /**
+   * \brief whether the transfer matrix is requested in single precision
+   *
+   * reads precision (double or single, default double) from the config. Single precision halves
+   * the memory of computed and stored matrices in matlab, but it is a storage format only, see
+   * widen_transfer_matrix.
+   */
+  bool single_precision(const Dune::ParameterTree& config);
+
+  /**
+   * \brief throw unless the config allows applying a single precision transfer matrix
+   *
+   * the driver applies double matrices only, so applying a single matrix widens a full double
+   * copy of it first. This costs more memory and time than applying the double matrix, and is
+   * therefore only done if apply.widen_single is set.
+   */
+  void check_single_precision_apply(const Dune::ParameterTree& config);
+
+  /**
+   * \brief compute a transfer matrix directly into the buffer provided by allocate
+   *
+   * If sensor_block_size is set to a positive value smaller than the number of sensors, the
+   * sensors set on the driver are temporarily replaced by blocks of at most that many sensors and
+   * each block is copied into the output as soon as it is computed. Since the transfer matrix of
+   * the driver is stored row major with one row per sensor, each block is a contiguous part of the
+   * output. The peak memory is thus the output plus one block instead of two full matrices. Every
+   * block projects its sensors onto the mesh and sets up the solver again, so blocks should be
+   * as large as the memory allows. The sensors recorded in the driver cache are not changed, and
+   * all of them are set on the driver again afterwards, also if the computation fails. The
+   * caller has to hold the lock of the driver.
+   *
+   * The eeg transfer matrix is referenced to the first electrode. Each eeg block which does not
+   * start with it therefore gets the first electrode in front of its own electrodes, and the row
+   * of the reference is subtracted from the rows of the block, so the result equals the matrix
+   * computed in one piece.
+   *
+   * If the sensor_partition sub tree is set, only the part sensor_partition.index (counted from
+   * 0) of the sensors split into sensor_partition.count contiguous parts is computed and the
+   * output holds the columns of these sensors. The solves of different sensors are independent,
+   * so the parts can be computed by separate processes and concatenated horizontally into the
+   * full matrix, see the gather statement of duneuro_matlab_runner.
+   *
+   * For single precision outputs, each computed matrix or block is narrowed while it is copied,
+   * so in combination with sensor_block_size the peak memory is about half of the double case.
+   *
+   * Does not use the mex api unless allocate does.
+   */
+  template <class T>
+  void compute_transfer_matrix(DriverInterface<3>* driver, const Dune::ParameterTree& config,
+                               TransferMatrixStore::Type type,
+                               const TransferMatrixAllocator<T>& allocate);
+
+  /**
+   * \brief compute a transfer matrix, or load it from the store configured in the
+   * transfer_matrix_store sub tree
+   *
+   * If transfer_matrix_store.mapped is set, the mapped matrix is returned and allocate is not
+   * called. Otherwise the matrix is written to the buffer provided by allocate and nullptr is
+   * returned. The store holds double precision matrices, mapped matrices are always double.
+   *
+   * The store only holds full matrices, so sensor_block_size and sensor_partition are not part of
+   * the key. A part of the sensors is copied from the stored full matrix if there is one, and
+   * computed without storing it otherwise. Parts can not be mapped.
+   */
+  template <class T>
+  std::unique_ptr<MappedTransferMatrix>
+  compute_or_load_transfer_matrix(DriverInterface<3>* driver, const Dune::ParameterTree& config,
+                                  TransferMatrixStore::Type type,
+                                  const TransferMatrixAllocator<T>& allocate);
+
+  /**
+   * \brief a transfer matrix computed or loaded without an output buffer
+   *
+   * holds either the row major (sensors x nodes) matrix computed by the driver, or the matrix
+   * loaded from the transfer matrix store.
+   */
+  struct ComputedTransferMatrix {
+    std::unique_ptr<DenseMatrix<double>> computed;
+    std::unique_ptr<MappedTransferMatrix> stored;
+    // rows of the stored matrix which form the result, see sensor_partition
+    std::pair<std::size_t, std::size_t> storedRows;
+    // whether transfer_matrix_store.mapped is set, i.e. the stored matrix is the result itself
+    bool mapped = false;
+
+    std::size_t rows() const;
+    std::size_t cols() const;
+    const double* data() const;
+  };
+
+  /**
+   * \brief compute a transfer matrix, or load it from the store, without an output buffer
+   *
+   * behaves like compute_or_load_transfer_matrix, but keeps the matrix computed by the driver
+   * instead of copying it into an output, unless the sensors are split by sensor_block_size or
+   * sensor_partition. Used by background jobs, which can not allocate matlab arrays, so that their
+   * result is only copied once, into the matlab array created when it is retrieved. Does not use
+   * the mex api.
+   */
+  ComputedTransferMatrix compute_or_load_transfer_matrix(DriverInterface<3>* driver,
+                                                         const Dune::ParameterTree& config,
+                                                         TransferMatrixStore::Type type);
+
+  /**
+   * \brief apply a transfer matrix to the dipoles of the input
+   *
+   * The dipoles are processed in blocks of apply.block_size and the result of each block is
+   * written directly into the (sensors x input.columns()) column major output. The three dipoles
+   * of a position are always part of the same block. apply.threads (default 1) spreads the blocks
+   * over several threads, which all apply to the same driver concurrently. Only use more than one
+   * thread if the driver is not shared with other sessions or jobs and supports concurrent
+   * applies.
+   *
+   * Inputs with at least apply.reorder_threshold (default 4096) entries are processed in the
+   * order of a morton curve through their positions, which keeps the element lookups of
+   * consecutive dipoles local in the mesh. The results are scattered back, so the output is in
+   * the order of the input. Setting apply.reorder to false disables the reordering.
+   */
+  void apply_transfer_blocked(const DenseMatrix<double>& tm, const TransferInput& input,
+                              const Dune::ParameterTree& config, double* out,
+                              const TransferApplication& apply);
+
+  /**
+   * \brief widen a single precision transfer matrix to double, so that it can be applied
+   *
+   * The driver applies double matrices holding a row for every sensor, so neither rows nor
+   * columns can be widened block by block. The matrix is widened once, on apply.threads
+   * (default 1) threads, so the peak memory is that of the double matrix plus the single matrix.
+   * Applying a single matrix is thus no faster than applying the double one, see
+   * check_single_precision_apply.
+   */
+  std::unique_ptr<DenseMatrix<double>> widen_transfer_matrix(const SingleTransferMatrix& tm,
+                                                             const Dune::ParameterTree& config);
+
+  /**
+   * \brief widen a transfer matrix which belongs to the sensors set on the driver
+   *
+   * the matrix has to hold a row for every sensor, since the driver may post process the results
+   * of all sensors together. Throws unless check_single_precision_apply passes. The caller has to
+   * hold the lock of the driver.
+   */
+  std::unique_ptr<DenseMatrix<double>> widen_transfer_matrix(DriverInterface<3>* driver,
+                                                             TransferMatrixStore::Type type,
+                                                             const SingleTransferMatrix& tm,
+                                                             const Dune::ParameterTree& config);
+
+  /**
+   * \brief apply an eeg and a meg transfer matrix to the dipoles of the input in a single pass
+   *
+   * Works like apply_transfer_blocked, but the dipoles of each block are created once and passed
+   * to applyEEG and applyMEG right after each other, while they are still in the cache. The
+   * results are written to the (eeg sensors x input.columns()) and (meg sensors x
+   * input.columns()) column major outputs.
+   */
+  void apply_meeg_transfer_blocked(const DenseMatrix<double>& eegTm,
+                                   const DenseMatrix<double>& megTm, const TransferInput& input,
+                                   const Dune::ParameterTree& config, double* eegOut,
+                                   double* megOut, const TransferApplication& applyEEG,
+                                   const TransferApplication& applyMEG);
+}
+
+#endif // DUNEURO_MATLAB_TRANSFER_MATRIX_HH
@@ -0,0 +1,168 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/transfer_matrix_store.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/temporary_file.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    const char transferMatrixMagic[8] = {'D', 'U', 'N', 'E', 'U', 'R', 'T', 'M'};
+    const std::uint64_t transferMatrixVersion = 2;
+
+    // the header is padded to 128 bytes, so that the matrix data is aligned
+    struct TransferMatrixHeader {
+      char magic[8];
+      std::uint64_t version;
+      std::uint64_t rows;
+      std::uint64_t cols;
+      std::uint8_t keySha256[32];
+      std::uint64_t keyBytes;
+      std::uint64_t reserved[7];
+    };
+    static_assert(sizeof(TransferMatrixHeader) == 128, "unexpected header size");
+
+    bool has_key(const TransferMatrixHeader& header, const ContentDigest& key)
+    {
+      return header.keyBytes == key.bytes
+             && std::equal(key.sha256.begin(), key.sha256.end(), header.keySha256);
+    }
+  }
+
+  MappedTransferMatrix::MappedTransferMatrix(const std::string& filename,
+                                             const ContentDigest& expectedKey)
+      : mapping_(nullptr), mappingSize_(0), rows_(0), cols_(0), data_(nullptr)
+  {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      DUNE_THROW(Dune::IOError, "could not open transfer matrix file \"" << filename
+                                                                         << "\": "
+                                                                         << std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(TransferMatrixHeader)) {
+      ::close(fd);
+      DUNE_THROW(Dune::IOError, "transfer matrix file \"" << filename << "\" is truncated");
+    }
+    mappingSize_ = st.st_size;
+    mapping_ = ::mmap(nullptr, mappingSize_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping_ == MAP_FAILED) {
+      mapping_ = nullptr;
+      DUNE_THROW(Dune::IOError, "could not map transfer matrix file \"" << filename
+                                                                        << "\": "
+                                                                        << std::strerror(errno));
+    }
+    const auto* header = static_cast<const TransferMatrixHeader*>(mapping_);
+    if (std::memcmp(header->magic, transferMatrixMagic, sizeof(transferMatrixMagic)) != 0
+        || header->version != transferMatrixVersion || !has_key(*header, expectedKey)
+        || mappingSize_
+               != sizeof(TransferMatrixHeader) + header->rows * header->cols * sizeof(double)) {
+      ::munmap(mapping_, mappingSize_);
+      mapping_ = nullptr;
+      DUNE_THROW(Dune::IOError, "transfer matrix file \"" << filename << "\" is invalid");
+    }
+    rows_ = header->rows;
+    cols_ = header->cols;
+    data_ = reinterpret_cast<const double*>(static_cast<const char*>(mapping_)
+                                            + sizeof(TransferMatrixHeader));
+    // the matrix is usually traversed completely, so we ask for read-ahead
+    ::madvise(mapping_, mappingSize_, MADV_WILLNEED);
+  }
+
+  MappedTransferMatrix::~MappedTransferMatrix()
+  {
+    if (mapping_) {
+      ::munmap(mapping_, mappingSize_);
+    }
+  }
+
+  std::unique_ptr<const DenseMatrix<double>> MappedTransferMatrix::view() const
+  {
+    // the const cast below is a work around to fulfill the dense matrix interface. The mapping is
+    // read-only, so the view must not be written to.
+    return std::make_unique<DenseMatrix<double>>(rows_, cols_, const_cast<double*>(data_));
+  }
+
+  TransferMatrixStore::TransferMatrixStore(const std::string& directory) : directory_(directory)
+  {
+    struct stat st;
+    if (::stat(directory_.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+      DUNE_THROW(Dune::IOError, "transfer matrix store \"" << directory_
+                                                           << "\" is not a directory");
+    }
+  }
+
+  std::unique_ptr<MappedTransferMatrix> TransferMatrixStore::load(Type type,
+                                                                  const ContentDigest& key) const
+  {
+    auto name = filename(type, key);
+    std::ifstream stream(name, std::ios::binary);
+    if (!stream) {
+      return nullptr;
+    }
+    // a matrix of another key whose name collides with this one is not the matrix of the key
+    TransferMatrixHeader header;
+    if (stream.read(reinterpret_cast<char*>(&header), sizeof(header))
+        && std::memcmp(header.magic, transferMatrixMagic, sizeof(transferMatrixMagic)) == 0
+        && header.version == transferMatrixVersion && !has_key(header, key)) {
+      return nullptr;
+    }
+    return std::make_unique<MappedTransferMatrix>(name, key);
+  }
+
+  void TransferMatrixStore::save(Type type, const ContentDigest& key,
+                                 const DenseMatrix<double>& matrix) const
+  {
+    auto name = filename(type, key);
+    const auto tmpname = temporary_filename(name);
+    {
+      std::ofstream stream(tmpname, std::ios::binary);
+      TransferMatrixHeader header;
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic, transferMatrixMagic, sizeof(transferMatrixMagic));
+      header.version = transferMatrixVersion;
+      header.rows = matrix.rows();
+      header.cols = matrix.cols();
+      std::copy(key.sha256.begin(), key.sha256.end(), header.keySha256);
+      header.keyBytes = key.bytes;
+      stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      stream.write(reinterpret_cast<const char*>(matrix.data()),
+                   matrix.rows() * matrix.cols() * sizeof(double));
+      if (!stream) {
+        std::remove(tmpname.c_str());
+        DUNE_THROW(Dune::IOError, "could not write transfer matrix file \"" << tmpname << "\"");
+      }
+    }
+    if (std::rename(tmpname.c_str(), name.c_str()) != 0) {
+      std::remove(tmpname.c_str());
+      DUNE_THROW(Dune::IOError, "could not move transfer matrix file to \"" << name << "\"");
+    }
+  }
+
+  std::string TransferMatrixStore::filename(Type type, const ContentDigest& key) const
+  {
+    std::stringstream sstr;
+    sstr << directory_ << "/" << (type == Type::eeg ? "eeg" : "meg") << "_" << std::hex
+         << std::setw(16) << std::setfill('0') << key.short_hash() << ".dtm";
+    return sstr.str();
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef DUNEURO_MATLAB_TRANSFER_MATRIX_STORE_HH
+#define DUNEURO_MATLAB_TRANSFER_MATRIX_STORE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <duneuro/common/dense_matrix.hh>
+
+#include <duneuro/matlab/content_digest.hh>
+
+namespace duneuro
+{
+  /**
+   * \brief read-only transfer matrix backed by a memory mapped file
+   *
+   * the data is stored in the layout of DenseMatrix, i.e. row major with one row per sensor. This
+   * coincides with the column major layout of the (nodes x sensors) matrix returned to matlab.
+   */
+  class MappedTransferMatrix
+  {
+  public:
+    MappedTransferMatrix(const std::string& filename, const ContentDigest& expectedKey);
+    ~MappedTransferMatrix();
+
+    MappedTransferMatrix(const MappedTransferMatrix&) = delete;
+    MappedTransferMatrix& operator=(const MappedTransferMatrix&) = delete;
+
+    std::size_t rows() const
+    {
+      return rows_;
+    }
+
+    std::size_t cols() const
+    {
+      return cols_;
+    }
+
+    const double* data() const
+    {
+      return data_;
+    }
+
+    /** \brief non-owning view of the mapped data */
+    std::unique_ptr<const DenseMatrix<double>> view() const;
+
+  private:
+    void* mapping_;
+    std::size_t mappingSize_;
+    std::size_t rows_;
+    std::size_t cols_;
+    const double* data_;
+  };
+
+  /**
+   * \brief directory of transfer matrices stored in a binary format
+   *
+   * each matrix is stored in a file named after its type and the first 64 bits of its key. The
+   * file consists of a fixed size header (magic, version, the full key, rows and columns) followed
+   * by the matrix entries as doubles. The full key is compared on load, so a file of a different
+   * key with the same name is treated as missing. Files are written to a temporary name and
+   * renamed afterwards, so that concurrent sessions never map partially written matrices.
+   */
+  class TransferMatrixStore
+  {
+  public:
+    enum class Type { eeg, meg };
+
+    explicit TransferMatrixStore(const std::string& directory);
+
+    /** \brief map the matrix stored for the key. returns nullptr if it does not exist */
+    std::unique_ptr<MappedTransferMatrix> load(Type type, const ContentDigest& key) const;
+
+    /** \brief store the matrix for the key, replacing an existing one */
+    void save(Type type, const ContentDigest& key, const DenseMatrix<double>& matrix) const;
+
+  private:
+    std::string filename(Type type, const ContentDigest& key) const;
+
+    std::string directory_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_TRANSFER_MATRIX_STORE_HH
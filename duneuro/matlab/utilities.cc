@@ -4,43 +4,385 @@
 
 #include <duneuro/matlab/utilities.hh>
 
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/mesh_conversion.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include <sys/stat.h>
 
 namespace duneuro
 {
-  std::map<std::string, std::string> matlab_struct_to_map(const mxArray* mstr)
+  namespace
   {
-    std::map<std::string, std::string> out;
-
-    auto nfields = mxGetNumberOfFields(mstr);
-    for (int i = 0; i < nfields; ++i) {
-      std::string name(mxGetFieldNameByNumber(mstr, i));
-      auto field = mxGetFieldByNumber(mstr, 0, i);
-      if (mxIsStruct(field)) {
-        auto sub = matlab_struct_to_map(field);
-        for (const auto& k : sub) {
-          out[name + '.' + k.first] = k.second;
-        }
-      } else if (mxIsChar(field)) {
-        out[name] = std::string(mxArrayToString(field));
+    /**
+     * \brief call f with a typed pointer to the data of an index array
+     *
+     * index arrays (elements, labels) may be passed as uint64, int64, uint32, int32 or double
+     * arrays. The data is accessed in place, no conversion copy is created.
+     */
+    template <class F>
+    void visit_index_array(const mxArray* arr, const std::string& name, F&& f)
+    {
+      if (mxIsComplex(arr)) {
+        mexErrMsgTxt((name + " has to be a real array").c_str());
+        return;
+      }
+      switch (mxGetClassID(arr)) {
+      case mxUINT64_CLASS: f(static_cast<const std::uint64_t*>(mxGetData(arr))); break;
+      case mxINT64_CLASS: f(static_cast<const std::int64_t*>(mxGetData(arr))); break;
+      case mxUINT32_CLASS: f(static_cast<const std::uint32_t*>(mxGetData(arr))); break;
+      case mxINT32_CLASS: f(static_cast<const std::int32_t*>(mxGetData(arr))); break;
+      case mxDOUBLE_CLASS: f(static_cast<const double*>(mxGetPr(arr))); break;
+      default:
+        mexErrMsgTxt(
+            (name + " has the wrong data type. expecting uint64, int64, uint32, int32 or double")
+                .c_str());
+      }
+    }
+
+    template <class T>
+    void extract_elements(const T* ptr, std::size_t rows, std::size_t cols,
+                          FittedDriverData<3>& data, unsigned int threads)
+    {
+      auto first = convert_elements(ptr, rows, cols, data, threads);
+      if (first != rows * cols) {
+        std::stringstream sstr;
+        sstr << "node index " << ptr[first] << " of element " << first / rows
+             << " out of bounds (" << data.nodes.size() << ")";
+        mexErrMsgTxt(sstr.str().c_str());
+        return;
+      }
+    }
+
+    template <class T>
+    void extract_labels(const T* ptr, std::size_t n, FittedDriverData<3>& data,
+                        unsigned int threads)
+    {
+      auto first = convert_labels(ptr, n, data, threads);
+      if (first != n) {
+        std::stringstream sstr;
+        sstr << "label " << ptr[first] << " of element " << first
+             << " is not a non-negative integer";
+        mexErrMsgTxt(sstr.str().c_str());
+        return;
+      }
+    }
+
+    // reports a handle which is not a live handle of the given type
+    void report_invalid_handle(HandleRegistry::Handle handle, HandleType type)
+    {
+      std::stringstream sstr;
+      auto encoded = HandleRegistry::encoded_type(handle);
+      if (encoded != type && encoded != HandleType::none) {
+        sstr << "expected a " << handle_type_name(type) << " handle, got a "
+             << handle_type_name(encoded) << " handle";
+      } else {
+        sstr << "invalid or deleted " << handle_type_name(type) << " handle";
+      }
+      mexErrMsgTxt(sstr.str().c_str());
+    }
+
+    // the object of a handle of the given type, reports stale and mistyped handles
+    void* find_handle(HandleRegistry::Handle handle, HandleType type)
+    {
+      void* object = HandleRegistry::instance().find(handle, type);
+      if (!object) {
+        report_invalid_handle(handle, type);
+      }
+      return object;
+    }
+
+    HandleRegistry::Handle extract_raw_handle(const mxArray* arr)
+    {
+      if (mxGetNumberOfElements(arr) != 1 || mxGetClassID(arr) != mxUINT64_CLASS
+          || mxIsComplex(arr)) {
+        mexErrMsgTxt("expected a handle, i.e. a real uint64 scalar");
       }
+      return *static_cast<const std::uint64_t*>(mxGetData(arr));
     }
+  }
 
+  mxArray* make_handle(HandleType type, void* object, HandleRegistry::Deleter deleter)
+  {
+    auto handle = HandleRegistry::instance().insert(type, object, deleter);
+    mxArray* out = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+    *static_cast<std::uint64_t*>(mxGetData(out)) = handle;
+    // note: mexLock has a lock count, release_handle calls mexUnlock for each released handle
+    mexLock();
     return out;
   }
 
+  void* extract_handle(const mxArray* arr, HandleType type)
+  {
+    return find_handle(extract_raw_handle(arr), type);
+  }
+
+  std::shared_ptr<void> share_handle(const mxArray* arr, HandleType type)
+  {
+    auto handle = extract_raw_handle(arr);
+    auto object = HandleRegistry::instance().share(handle, type);
+    if (!object) {
+      report_invalid_handle(handle, type);
+    }
+    return object;
+  }
+
+  std::vector<void*> extract_handles(const mxArray* arr, HandleType type)
+  {
+    if (mxGetClassID(arr) != mxUINT64_CLASS || mxIsComplex(arr)) {
+      mexErrMsgTxt("expected handles, i.e. a real uint64 array");
+    }
+    const auto* ptr = static_cast<const std::uint64_t*>(mxGetData(arr));
+    std::vector<void*> objects(mxGetNumberOfElements(arr));
+    for (auto& object : objects) {
+      object = find_handle(*ptr++, type);
+    }
+    return objects;
+  }
+
+  bool release_handle(const mxArray* arr, HandleType type)
+  {
+    auto handle = extract_raw_handle(arr);
+    auto encoded = HandleRegistry::encoded_type(handle);
+    if (encoded != type) {
+      std::stringstream sstr;
+      sstr << "expected a " << handle_type_name(type) << " handle, got a "
+           << handle_type_name(encoded) << " handle";
+      mexErrMsgTxt(sstr.str().c_str());
+    }
+    if (!HandleRegistry::instance().release(handle)) {
+      return false;
+    }
+    mexUnlock();
+    return true;
+  }
+
+  std::size_t release_all_handles()
+  {
+    auto released = HandleRegistry::instance().release_all();
+    for (std::size_t i = 0; i < released; ++i) {
+      mexUnlock();
+    }
+    return released;
+  }
+
+  namespace
+  {
+    // shortest representation with at most max_digits10 significant digits which is read back as
+    // the same value
+    template <class T>
+    void append_floating_point(std::string& out, T value, T (*parse)(const char*, char**))
+    {
+      char buffer[32];
+      for (int digits = std::numeric_limits<T>::digits10; ; ++digits) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", digits, static_cast<double>(value));
+        if (digits >= std::numeric_limits<T>::max_digits10 || parse(buffer, nullptr) == value) {
+          break;
+        }
+      }
+      out += buffer;
+    }
+
+    void append_value(std::string& out, double value)
+    {
+      append_floating_point<double>(out, value, std::strtod);
+    }
+
+    void append_value(std::string& out, float value)
+    {
+      append_floating_point<float>(out, value, std::strtof);
+    }
+
+    void append_value(std::string& out, mxLogical value)
+    {
+      out += value ? "true" : "false";
+    }
+
+    template <class T>
+    void append_value(std::string& out, T value)
+    {
+      static_assert(std::is_integral<T>::value, "unexpected value type");
+      if (std::is_signed<T>::value) {
+        out += std::to_string(static_cast<long long>(value));
+      } else {
+        out += std::to_string(static_cast<unsigned long long>(value));
+      }
+    }
+
+    // vectors and matrices are written as whitespace separated lists in column major order
+    template <class T>
+    std::string format_values(const T* ptr, std::size_t n)
+    {
+      std::string out;
+      out.reserve(n * 8);
+      for (std::size_t i = 0; i < n; ++i) {
+        if (i > 0) {
+          out += ' ';
+        }
+        append_value(out, ptr[i]);
+      }
+      return out;
+    }
+
+    std::string format_numeric_field(const mxArray* field)
+    {
+      const void* data = mxGetData(field);
+      const std::size_t n = mxGetNumberOfElements(field);
+      switch (mxGetClassID(field)) {
+      case mxDOUBLE_CLASS: return format_values(static_cast<const double*>(data), n);
+      case mxSINGLE_CLASS: return format_values(static_cast<const float*>(data), n);
+      case mxINT8_CLASS: return format_values(static_cast<const std::int8_t*>(data), n);
+      case mxUINT8_CLASS: return format_values(static_cast<const std::uint8_t*>(data), n);
+      case mxINT16_CLASS: return format_values(static_cast<const std::int16_t*>(data), n);
+      case mxUINT16_CLASS: return format_values(static_cast<const std::uint16_t*>(data), n);
+      case mxINT32_CLASS: return format_values(static_cast<const std::int32_t*>(data), n);
+      case mxUINT32_CLASS: return format_values(static_cast<const std::uint32_t*>(data), n);
+      case mxINT64_CLASS: return format_values(static_cast<const std::int64_t*>(data), n);
+      case mxUINT64_CLASS: return format_values(static_cast<const std::uint64_t*>(data), n);
+      default: return std::string();
+      }
+    }
+
+    // cell arrays of strings are written as whitespace separated lists
+    std::string format_string_list(const mxArray* field, const std::string& key)
+    {
+      std::string out;
+      const std::size_t n = mxGetNumberOfElements(field);
+      for (std::size_t i = 0; i < n; ++i) {
+        const mxArray* entry = mxGetCell(field, i);
+        if (!entry || !mxIsChar(entry)) {
+          std::stringstream sstr;
+          sstr << "config field \"" << key << "\" has to be a cell array of strings";
+          mexErrMsgTxt(sstr.str().c_str());
+        }
+        auto str = extract_string(entry);
+        if (str.empty() || str.find_first_of(" \t\n") != std::string::npos) {
+          std::stringstream sstr;
+          sstr << "entry " << i + 1 << " of config field \"" << key
+               << "\" is empty or contains whitespace";
+          mexErrMsgTxt(sstr.str().c_str());
+        }
+        if (i > 0) {
+          out += ' ';
+        }
+        out += str;
+      }
+      return out;
+    }
+
+    // parameter trees hold scalars and lists, matrices have no representation in them
+    void check_vector(const mxArray* field, const std::string& key)
+    {
+      if (mxGetNumberOfDimensions(field) != 2 || std::min(mxGetM(field), mxGetN(field)) > 1) {
+        std::stringstream sstr;
+        sstr << "config field \"" << key << "\" is a matrix. expected a scalar or a vector";
+        mexErrMsgTxt(sstr.str().c_str());
+      }
+    }
+
+    // the subtrees holding the mesh of a driver, of which only strings like file names are taken
+    bool is_mesh_subtree(const std::string& key)
+    {
+      return key == "volume_conductor.grid" || key == "volume_conductor.tensors";
+    }
+
+    void add_struct_to_parametertree(const mxArray* mstr, const std::string& prefix,
+                                     bool stringsOnly, Dune::ParameterTree& config,
+                                     ScopedPhase& phase)
+    {
+      auto nfields = mxGetNumberOfFields(mstr);
+      for (int i = 0; i < nfields; ++i) {
+        std::string key = prefix + mxGetFieldNameByNumber(mstr, i);
+        auto field = mxGetFieldByNumber(mstr, 0, i);
+        if (!field) {
+          continue;
+        }
+        std::string value;
+        if (mxIsStruct(field)) {
+          add_struct_to_parametertree(field, key + '.', stringsOnly || is_mesh_subtree(key),
+                                      config, phase);
+          continue;
+        } else if (mxIsChar(field)) {
+          value = extract_string(field);
+        } else if (stringsOnly) {
+          continue;
+        } else if (mxIsLogical(field)) {
+          check_vector(field, key);
+          value = format_values(mxGetLogicals(field), mxGetNumberOfElements(field));
+        } else if (mxIsNumeric(field) && !mxIsComplex(field) && !mxIsSparse(field)) {
+          check_vector(field, key);
+          value = format_numeric_field(field);
+        } else if (mxIsCell(field)) {
+          value = format_string_list(field, key);
+        } else {
+          std::stringstream sstr;
+          sstr << "config field \"" << key << "\" has an unsupported type. expected struct, "
+               << "string, real numeric or logical array, or cell array of strings";
+          mexErrMsgTxt(sstr.str().c_str());
+        }
+        phase.add_bytes(key.size() + value.size());
+        config[key] = std::move(value);
+      }
+    }
+  }
+
   Dune::ParameterTree matlab_struct_to_parametertree(const mxArray* mstr)
   {
-    Dune::ParameterTree config;
-    auto map = matlab_struct_to_map(mstr);
-    for (const auto& k : map) {
-      config[k.first] = k.second;
+    if (is_config_handle(mstr)) {
+      return extract_config(mstr);
     }
+    ScopedPhase phase("matlab_struct_to_parametertree");
+    if (!mxIsStruct(mstr)) {
+      mexErrMsgTxt("expected a config struct or a compiled config");
+    }
+    Dune::ParameterTree config;
+    add_struct_to_parametertree(mstr, "", false, config, phase);
     return config;
   }
 
+  bool is_config_handle(const mxArray* arr)
+  {
+    return (mxIsUint64(arr) && mxGetNumberOfElements(arr) == 1)
+           || mxIsClass(arr, "duneuro_config");
+  }
+
+  const Dune::ParameterTree& extract_config(const mxArray* arr)
+  {
+    if (mxIsClass(arr, "duneuro_config")) {
+      // mxGetProperty returns a copy of the property, which is freed together with the call
+      const mxArray* handle = mxGetProperty(arr, 0, "cpp_handle");
+      if (!handle) {
+        mexErrMsgTxt("duneuro_config object without handle");
+      }
+      return *extract_handle<Dune::ParameterTree>(handle);
+    }
+    return *extract_handle<Dune::ParameterTree>(arr);
+  }
+
+  const Dune::ParameterTree& extract_config(const mxArray* arr, Dune::ParameterTree& storage)
+  {
+    if (is_config_handle(arr)) {
+      return extract_config(arr);
+    }
+    storage = matlab_struct_to_parametertree(arr);
+    return storage;
+  }
+
   Dipole<double, 3> extract_dipole(const mxArray* arr)
   {
+    ScopedPhase phase("extract_dipole", mxGetNumberOfElements(arr) * sizeof(double));
     if (!mxIsDouble(arr)) {
       mexErrMsgTxt("expected double matrix for dipole");
     }
@@ -57,6 +399,7 @@ namespace duneuro
 
   std::vector<Dipole<double, 3>> extract_dipoles(const mxArray* arr)
   {
+    ScopedPhase phase("extract_dipoles", mxGetNumberOfElements(arr) * sizeof(double));
     if (!mxIsDouble(arr)) {
       mexErrMsgTxt("expected double matrix for dipoles");
     }
@@ -65,9 +408,14 @@ namespace duneuro
     if (rows != 6) {
       mexErrMsgTxt("number of rows has to be two times the number of dims, i.e. 6");
     }
-    const double* ptr = mxGetPr(arr);
+    return make_dipoles(mxGetPr(arr), cols);
+  }
+
+  std::vector<Dipole<double, 3>> make_dipoles(const double* ptr, std::size_t count)
+  {
     std::vector<Dipole<double, 3>> output;
-    for (int i = 0; i < cols; ++i, ptr += rows) {
+    output.reserve(count);
+    for (std::size_t i = 0; i < count; ++i, ptr += 6) {
       Dune::FieldVector<double, 3> pos, mom;
       std::copy(ptr, ptr + 3, pos.begin());
       std::copy(ptr + 3, ptr + 6, mom.begin());
@@ -78,6 +426,7 @@ namespace duneuro
 
   std::vector<double> extract_vector(const mxArray* arr)
   {
+    ScopedPhase phase("extract_vector", mxGetNumberOfElements(arr) * sizeof(double));
     if(!mxIsDouble(arr)) {
       mexErrMsgTxt("expected double matrix");
     }
@@ -99,6 +448,7 @@ namespace duneuro
 
   std::vector<Dune::FieldVector<double, 3>> extract_field_vectors(const mxArray* arr)
   {
+    ScopedPhase phase("extract_field_vectors", mxGetNumberOfElements(arr) * sizeof(double));
     if (!mxIsDouble(arr)) {
       mexErrMsgTxt("expected double matrix");
     }
@@ -117,26 +467,24 @@ namespace duneuro
     return output;
   }
 
-  std::vector<std::vector<Dune::FieldVector<double, 3>>> extract_projections(const mxArray* arr)
+  std::vector<Dune::FieldVector<double, 3>> extract_projections(const mxArray* arr,
+                                                                std::size_t& projectionsPerCoil)
   {
+    ScopedPhase phase("extract_projections", mxGetNumberOfElements(arr) * sizeof(double));
     if (!mxIsDouble(arr)) {
       mexErrMsgTxt("expected double matrix for projections");
     }
-    int rows = mxGetM(arr);
-    int cols = mxGetN(arr);
+    std::size_t rows = mxGetM(arr);
     if (rows % 3 != 0) {
       mexErrMsgTxt("number of rows has to be a multiple of the number of dims, i.e. 3");
     }
+    projectionsPerCoil = rows / 3;
+    // the column major matlab matrix already lists the projections grouped by coil
     const double* ptr = mxGetPr(arr);
-    std::vector<std::vector<Dune::FieldVector<double, 3>>> output;
-    for (int i = 0; i < cols; ++i, ptr += rows) {
-      std::vector<Dune::FieldVector<double, 3>> current;
-      for (int j = 0; j < rows; j += 3) {
-        Dune::FieldVector<double, 3> v;
-        std::copy(ptr + j, ptr + j + 3, v.begin());
-        current.push_back(v);
-      }
-      output.push_back(current);
+    std::vector<Dune::FieldVector<double, 3>> output(mxGetNumberOfElements(arr) / 3);
+    for (auto& v : output) {
+      std::copy(ptr, ptr + 3, v.begin());
+      ptr += 3;
     }
     return output;
   }
@@ -160,8 +508,21 @@ namespace duneuro
     return mxIsLogicalScalarTrue(arr);
   }
 
-  void extract_fitted_driver_data_from_struct(const mxArray* str, FittedDriverData<3>& data)
+  std::string extract_string(const mxArray* arr)
+  {
+    if (!mxIsChar(arr)) {
+      mexErrMsgTxt("expected char array");
+    }
+    char* buffer = mxArrayToString(arr);
+    std::string out(buffer);
+    mxFree(buffer);
+    return out;
+  }
+
+  void extract_fitted_driver_data_from_struct(const mxArray* str, FittedDriverData<3>& data,
+                                              unsigned int threads)
   {
+    ScopedPhase phase("extract_fitted_driver_data_from_struct");
     const int dim = 3;
     if (!mxIsStruct(str)) {
       mexErrMsgTxt("expected struct array to extract data from");
@@ -182,35 +543,18 @@ namespace duneuro
           if (!mxIsDouble(nodes)) {
             mexErrMsgTxt("nodes has the wrong data type. expecting double");
           }
-          if (!mxIsUint64(elements)) {
-            mexErrMsgTxt("elements has the wrong data type. expecting uint64");
-          }
           auto nodeRows = mxGetM(nodes);
           auto nodeCols = mxGetN(nodes);
-          auto elementRows = mxGetM(elements);
-          auto elementCols = mxGetN(elements);
           if (nodeRows != dim) {
             mexErrMsgTxt("number of rows of the node array has to match the dimension");
           }
           const double* const nodePtr = mxGetPr(nodes);
-          for (unsigned int i = 0; i < nodeCols; ++i) {
-            typename duneuro::FittedDriverData<dim>::Coordinate c;
-            std::copy(nodePtr + i * dim, nodePtr + (i + 1) * dim, c.begin());
-            data.nodes.push_back(c);
-          }
-          const std::uint64_t* const elementPtr =
-              static_cast<const std::uint64_t*>(mxGetData(elements));
-          for (unsigned int i = 0; i < elementCols; ++i) {
-            data.elements.emplace_back(elementPtr + i * elementRows,
-                                       elementPtr + (i + 1) * elementRows);
-            for (const auto& ei : data.elements.back()) {
-              if (ei >= data.nodes.size()) {
-                std::stringstream sstr;
-                sstr << "node index " << ei << " out of bounds (" << data.nodes.size() << ")";
-                mexErrMsgTxt(sstr.str().c_str());
-              }
-            }
-          }
+          phase.add_bytes((mxGetNumberOfElements(nodes) * mxGetElementSize(nodes))
+                          + (mxGetNumberOfElements(elements) * mxGetElementSize(elements)));
+          convert_nodes(nodePtr, nodeCols, data, threads);
+          visit_index_array(elements, "elements", [&](const auto* elementPtr) {
+            extract_elements(elementPtr, mxGetM(elements), mxGetN(elements), data, threads);
+          });
         }
       }
       auto tensors = mxGetField(vc, 0, "tensors");
@@ -221,12 +565,10 @@ namespace duneuro
         auto labels = mxGetField(tensors, 0, "labels");
         auto conductivities = mxGetField(tensors, 0, "conductivities");
         if (labels) {
-          if (!mxIsUint64(labels)) {
-            mexErrMsgTxt("labels has the wrong data type. expected uint64.");
-            return;
-          }
-          const std::uint64_t* const lptr = static_cast<const std::uint64_t*>(mxGetData(labels));
-          std::copy(lptr, lptr + mxGetNumberOfElements(labels), std::back_inserter(data.labels));
+          phase.add_bytes(mxGetNumberOfElements(labels) * mxGetElementSize(labels));
+          visit_index_array(labels, "labels", [&](const auto* lptr) {
+            extract_labels(lptr, mxGetNumberOfElements(labels), data, threads);
+          });
           if (data.labels.size() != data.elements.size()) {
             std::stringstream errormsg;
             errormsg << "number of labels (" << data.labels.size() << ") and number of elements ("
@@ -240,9 +582,9 @@ namespace duneuro
             mexErrMsgTxt("conductivities has the wrong data type. expected double.");
             return;
           }
+          phase.add_bytes(mxGetNumberOfElements(conductivities) * sizeof(double));
           const double* const cptr = mxGetPr(conductivities);
-          std::copy(cptr, cptr + mxGetNumberOfElements(conductivities),
-                    std::back_inserter(data.conductivities));
+          data.conductivities.assign(cptr, cptr + mxGetNumberOfElements(conductivities));
         }
         auto realtensors = mxGetField(tensors, 0, "tensors");
         if (realtensors) {
@@ -250,24 +592,108 @@ namespace duneuro
             mexErrMsgTxt("tensors has the wrong data type. expected double.");
             return;
           }
-          int rows = mxGetM(realtensors);
-          int cols = mxGetN(realtensors);
+          std::size_t rows = mxGetM(realtensors);
+          std::size_t cols = mxGetN(realtensors);
           if (rows != 9) {
             mexErrMsgTxt("number of rows of the tensors matrix has to be the number of dims squared, i.e. 9");
             return;
           }
-          const double* ptr = mxGetPr(realtensors);
-          for (int i = 0; i < cols; ++i, ptr += rows) {
-            Dune::FieldMatrix<double, 3, 3> m;
-            for (int c = 0; c < 3; ++c) {
-              for (int r = 0; r < 3; ++r) {
-                m[r][c] = *(ptr + 3 * c + r);
-              }
-            }
-            data.tensors.push_back(m);
-          }
+          phase.add_bytes(rows * cols * sizeof(double));
+          convert_tensors(mxGetPr(realtensors), cols, data, threads);
+        }
+      }
+    }
+  }
+
+  std::string extract_mesh_filename(const mxArray* str)
+  {
+    if (!mxIsStruct(str)) {
+      return "";
+    }
+    auto vc = mxGetField(str, 0, "volume_conductor");
+    if (!vc || !mxIsStruct(vc)) {
+      return "";
+    }
+    auto file = mxGetField(vc, 0, "mesh_file");
+    if (!file) {
+      return "";
+    }
+    if (!mxIsChar(file)) {
+      mexErrMsgTxt("mesh_file has the wrong data type. expected char array");
+    }
+    if (mxGetField(vc, 0, "grid") || mxGetField(vc, 0, "tensors")) {
+      mexErrMsgTxt("the mesh_file replaces grid and tensors of the volume_conductor, please "
+                   "provide only one of them");
+    }
+    return extract_string(file);
+  }
+
+  void digest_matlab_array(ContentHasher& hasher, const mxArray* arr, unsigned int threads)
+  {
+    if (!arr) {
+      hasher.update_value(std::uint64_t(mxUNKNOWN_CLASS));
+      return;
+    }
+    hasher.update_value(static_cast<std::uint64_t>(mxGetClassID(arr)));
+    const auto ndims = mxGetNumberOfDimensions(arr);
+    hasher.update_value(static_cast<std::uint64_t>(ndims));
+    hasher.update(mxGetDimensions(arr), ndims * sizeof(mwSize));
+    const auto nelements = mxGetNumberOfElements(arr);
+    if (mxIsStruct(arr)) {
+      const int nfields = mxGetNumberOfFields(arr);
+      for (std::size_t e = 0; e < nelements; ++e) {
+        for (int i = 0; i < nfields; ++i) {
+          hasher.update_string(mxGetFieldNameByNumber(arr, i));
+          digest_matlab_array(hasher, mxGetFieldByNumber(arr, e, i), threads);
         }
       }
+    } else if (mxIsCell(arr)) {
+      for (std::size_t e = 0; e < nelements; ++e) {
+        digest_matlab_array(hasher, mxGetCell(arr, e), threads);
+      }
+    } else if (mxIsNumeric(arr) || mxIsChar(arr) || mxIsLogical(arr)) {
+      hasher.update_parallel(mxGetData(arr), nelements * mxGetElementSize(arr), threads);
+    }
+  }
+
+  void digest_file_identity(ContentHasher& hasher, const std::string& filename)
+  {
+    struct stat st;
+    if (::stat(filename.c_str(), &st) != 0) {
+      std::stringstream sstr;
+      sstr << "could not open \"" << filename << "\": " << std::strerror(errno);
+      mexErrMsgTxt(sstr.str().c_str());
+    }
+    const std::uint64_t identity[] = {
+        static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino),
+        static_cast<std::uint64_t>(st.st_size), static_cast<std::uint64_t>(st.st_mtim.tv_sec),
+        static_cast<std::uint64_t>(st.st_mtim.tv_nsec)};
+    hasher.update(identity, sizeof(identity));
+  }
+
+  void digest_parametertree(ContentHasher& hasher, const Dune::ParameterTree& tree,
+                            const std::vector<std::string>& skip)
+  {
+    auto skipped = [&](const std::string& key) {
+      return std::find(skip.begin(), skip.end(), key) != skip.end();
+    };
+    for (const auto& key : tree.getValueKeys()) {
+      if (skipped(key)) {
+        continue;
+      }
+      hasher.update_string(key);
+      hasher.update_string(tree[key]);
+    }
+    // sub trees are marked, so that they can not be confused with values
+    const char subMarker = '.';
+    for (const auto& key : tree.getSubKeys()) {
+      if (skipped(key)) {
+        continue;
+      }
+      hasher.update_value(subMarker);
+      hasher.update_string(key);
+      digest_parametertree(hasher, tree.sub(key));
+      hasher.update_value(subMarker);
     }
   }
 }
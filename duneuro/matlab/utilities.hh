@@ -3,33 +3,109 @@
 
 #include <mex.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <dune/common/parametertree.hh>
 
 #include <duneuro/common/dense_matrix.hh>
 #include <duneuro/common/dipole.hh>
 #include <duneuro/common/fitted_driver_data.hh>
 
+#include <duneuro/matlab/content_digest.hh>
+#include <duneuro/matlab/handle_registry.hh>
+#include <duneuro/matlab/parallel.hh>
+
 namespace duneuro
 {
-  /** \TODO docme! */
+  /**
+   * \brief register an object in the HandleRegistry and return its handle as a uint64 scalar
+   *
+   * the mex module stays locked as long as handles are alive, see release_handle.
+   */
+  mxArray* make_handle(HandleType type, void* object, HandleRegistry::Deleter deleter);
+
   template <class T>
-  mxArray* convert_ptr_to_mat(T* ptr)
+  mxArray* make_handle(std::unique_ptr<T> object)
   {
-    mxArray* out = mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
-    *((uint64_t*) mxGetData(out)) = reinterpret_cast<uint64_t>(ptr);
-    return out;
+    return make_handle(HandleTraits<T>::type, object.release(),
+                       [](void* ptr) { delete static_cast<T*>(ptr); });
   }
 
-  /** \TODO docme! */
+  /** \brief the object of a handle of the given type, reports stale and mistyped handles */
+  void* extract_handle(const mxArray* arr, HandleType type);
+
+  template <class T>
+  T* extract_handle(const mxArray* arr)
+  {
+    return static_cast<T*>(extract_handle(arr, HandleTraits<T>::type));
+  }
+
+  /**
+   * \brief shared reference to the object of a handle, reports stale and mistyped handles
+   *
+   * used by background jobs to keep their inputs alive if the handle is released while they run.
+   */
+  std::shared_ptr<void> share_handle(const mxArray* arr, HandleType type);
+
   template <class T>
-  T* convert_mat_to_ptr(const mxArray* in)
+  std::shared_ptr<T> share_handle(const mxArray* arr)
   {
-    if (mxGetNumberOfElements(in) != 1 || mxGetClassID(in) != mxUINT64_CLASS || mxIsComplex(in))
-      mexErrMsgTxt("Input must be a real uint64 scalar.");
-    return reinterpret_cast<T*>(*((uint64_t*) mxGetData(in)));
+    return std::static_pointer_cast<T>(share_handle(arr, HandleTraits<T>::type));
   }
 
+  /** \brief the objects of an array of handles of the given type, in column major order */
+  std::vector<void*> extract_handles(const mxArray* arr, HandleType type);
+
+  template <class T>
+  std::vector<T*> extract_handles(const mxArray* arr)
+  {
+    auto objects = extract_handles(arr, HandleTraits<T>::type);
+    std::vector<T*> output(objects.size());
+    std::transform(objects.begin(), objects.end(), output.begin(),
+                   [](void* ptr) { return static_cast<T*>(ptr); });
+    return output;
+  }
+
+  /**
+   * \brief destroy the object of a handle of the given type
+   *
+   * handles which have already been released, e.g. by release_all_handles, are ignored and false
+   * is returned. Handles of a different type are reported as an error.
+   */
+  bool release_handle(const mxArray* arr, HandleType type);
+
+  /** \brief destroy all objects handed out to matlab, returns their number */
+  std::size_t release_all_handles();
+
+  /**
+   * \brief convert a matlab struct to a parameter tree
+   *
+   * nested structs become sub trees. Strings are taken as they are. Real numeric and logical
+   * scalars and vectors are written as whitespace separated lists, using a round trip exact
+   * representation for floating point values and true/false for logicals. Matrices are rejected
+   * with an error naming the field. All fields but strings in volume_conductor.grid and
+   * volume_conductor.tensors, which hold the mesh of a driver, are skipped. Cell arrays of strings
+   * are written as whitespace separated lists. A compiled config (see extract_config) is returned
+   * as a copy.
+   */
   Dune::ParameterTree matlab_struct_to_parametertree(const mxArray* mstr);
+
+  /** \brief whether the array is a compiled config, given as handle or duneuro_config object */
+  bool is_config_handle(const mxArray* arr);
+
+  /** \brief the parameter tree of a compiled config */
+  const Dune::ParameterTree& extract_config(const mxArray* arr);
+
+  /**
+   * \brief the parameter tree of a compiled config or of a config struct
+   *
+   * structs are converted into storage, compiled configs are referenced without copying them.
+   */
+  const Dune::ParameterTree& extract_config(const mxArray* arr, Dune::ParameterTree& storage);
   /**
    * \brief extract a single dipole from a matlab array
    *
@@ -46,13 +122,26 @@ namespace duneuro
    */
   std::vector<Dipole<double, 3>> extract_dipoles(const mxArray* arr);
 
+  /**
+   * \brief create dipoles from a buffer of 6xN doubles in the format of extract_dipoles
+   *
+   * does not use the mex api and can therefore be used from worker threads.
+   */
+  std::vector<Dipole<double, 3>> make_dipoles(const double* ptr, std::size_t count);
+
   std::vector<double> extract_vector(const mxArray* arr);
 
   /** \TODO docme! */
   std::vector<Dune::FieldVector<double, 3>> extract_field_vectors(const mxArray* arr);
 
-  /** \TODO docme! */
-  std::vector<std::vector<Dune::FieldVector<double, 3>>> extract_projections(const mxArray* arr);
+  /**
+   * \brief extract the projections of all coils from a (3k x coils) matrix
+   *
+   * the projections are returned in a single flat array grouped by coil, see DriverCache::Coils,
+   * and k is stored in projectionsPerCoil.
+   */
+  std::vector<Dune::FieldVector<double, 3>> extract_projections(const mxArray* arr,
+                                                                std::size_t& projectionsPerCoil);
 
   /** \TODO docme! */
   std::unique_ptr<const DenseMatrix<double>> extract_dense_matrix(mxArray* arr);
@@ -60,8 +149,54 @@ namespace duneuro
   /** \TODO docme! */
   bool extract_bool(const mxArray* arr);
 
-  /** \TODO docme! */
-  void extract_fitted_driver_data_from_struct(const mxArray* str, duneuro::FittedDriverData<3>& data);
+  /** \brief copy a matlab char array into a string, releasing the temporary matlab buffer */
+  std::string extract_string(const mxArray* arr);
+
+  /**
+   * \brief extract the volume conductor from a matlab struct
+   *
+   * nodes are expected as a 3xN double matrix, tensors as a 9xN double matrix. elements (KxM) and
+   * labels may be given as uint64, int64, uint32, int32 or double arrays and are read directly from
+   * the matlab buffer, so no conversion is necessary on the matlab side. All node indices are
+   * validated, the first invalid element is reported. The arrays are validated and converted on
+   * threads threads, see mesh_conversion.hh.
+   */
+  void extract_fitted_driver_data_from_struct(const mxArray* str,
+                                              duneuro::FittedDriverData<3>& data,
+                                              unsigned int threads = default_number_of_threads());
+
+  /**
+   * \brief the binary mesh file given as volume_conductor.mesh_file of the struct
+   *
+   * the file replaces the grid and tensors of the volume_conductor, see read_mesh_file. Returns an
+   * empty string if the struct does not reference a mesh file.
+   */
+  std::string extract_mesh_filename(const mxArray* str);
+
+  /**
+   * \brief append the content of a matlab array to a digest
+   *
+   * the digest covers class, dimensions and data of numeric, logical and char arrays. structs and
+   * cell arrays are digested recursively including their field names. The data of large arrays
+   * is hashed on threads threads, see ContentHasher::update_parallel.
+   */
+  void digest_matlab_array(ContentHasher& hasher, const mxArray* arr, unsigned int threads = 1);
+
+  /**
+   * \brief append the identity of a file, i.e. its device, inode, size and modification time
+   *
+   * identifies an unmodified file without reading its content.
+   */
+  void digest_file_identity(ContentHasher& hasher, const std::string& filename);
+
+  /**
+   * \brief append all keys and values of a parameter tree to a digest
+   *
+   * values and sub trees on the top level whose key is contained in skip are ignored, which
+   * allows excluding settings that do not influence the result.
+   */
+  void digest_parametertree(ContentHasher& hasher, const Dune::ParameterTree& tree,
+                            const std::vector<std::string>& skip = std::vector<std::string>());
 }
 
 #endif // DUNEURO_MATLAB_UTILITIES_HH
@@ -0,0 +1,157 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/vtk_encoding.hh>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <dune/common/exceptions.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    // size of the blocks data arrays are compressed in, see the vtk file format documentation
+    constexpr std::size_t compressionBlockSize = std::size_t(1) << 16;
+
+    template <class T>
+    void append(std::string& out, const T& value)
+    {
+      out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+  }
+
+  const char* vtk_byte_order()
+  {
+    const std::uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1 ? "LittleEndian" : "BigEndian";
+  }
+
+  std::string vtk_xml_header(const char* type, bool compressed)
+  {
+    std::stringstream sstr;
+    sstr << "<?xml version=\"1.0\"?>\n"
+         << "<VTKFile type=\"" << type << "\" version=\"1.0\" byte_order=\"" << vtk_byte_order()
+         << "\" header_type=\"UInt64\"";
+    if (compressed) {
+      sstr << " compressor=\"vtkZLibDataCompressor\"";
+    }
+    sstr << ">\n";
+    return sstr.str();
+  }
+
+  bool vtk_compression_available()
+  {
+#if HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  std::string encode_vtk_array(const void* data, std::size_t bytes, bool compress, int level)
+  {
+    std::string out;
+    if (!compress) {
+      append(out, static_cast<std::uint64_t>(bytes));
+      out.append(static_cast<const char*>(data), bytes);
+      return out;
+    }
+#if HAVE_ZLIB
+    const std::size_t blocks = (bytes + compressionBlockSize - 1) / compressionBlockSize;
+    const std::size_t header = (3 + blocks) * sizeof(std::uint64_t);
+    out.resize(header);
+    std::vector<std::uint64_t> sizes;
+    sizes.push_back(blocks);
+    sizes.push_back(compressionBlockSize);
+    sizes.push_back(bytes % compressionBlockSize);
+    const auto* source = static_cast<const Bytef*>(data);
+    std::vector<Bytef> buffer(compressBound(compressionBlockSize));
+    for (std::size_t b = 0; b < blocks; ++b) {
+      const std::size_t size = std::min(compressionBlockSize, bytes - b * compressionBlockSize);
+      uLongf compressedSize = buffer.size();
+      if (compress2(buffer.data(), &compressedSize, source + b * compressionBlockSize, size, level)
+          != Z_OK) {
+        DUNE_THROW(Dune::Exception, "zlib compression failed");
+      }
+      sizes.push_back(compressedSize);
+      out.append(reinterpret_cast<const char*>(buffer.data()), compressedSize);
+    }
+    std::memcpy(&out[0], sizes.data(), header);
+    return out;
+#else
+    DUNE_THROW(Dune::Exception, "compressed output requires duneuro-matlab built with zlib");
+#endif
+  }
+
+  std::string vtk_xml_escape(const std::string& value)
+  {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+      switch (c) {
+      case '&': escaped += "&amp;"; break;
+      case '<': escaped += "&lt;"; break;
+      case '>': escaped += "&gt;"; break;
+      case '"': escaped += "&quot;"; break;
+      case '\'': escaped += "&apos;"; break;
+      default: escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  std::string vtk_step_name(const std::string& filename, std::size_t step)
+  {
+    std::stringstream sstr;
+    sstr << filename << "_" << std::setw(6) << std::setfill('0') << step;
+    return sstr.str();
+  }
+
+  void write_vtk_collection(const std::string& file, const std::vector<VTKCollectionEntry>& steps)
+  {
+    std::ofstream stream(file);
+    stream << "<?xml version=\"1.0\"?>\n"
+           << "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"" << vtk_byte_order()
+           << "\">\n"
+           << "  <Collection>\n";
+    stream << std::setprecision(17);
+    for (const auto& step : steps) {
+      stream << "    <DataSet timestep=\"" << step.time << "\" group=\"\" part=\"0\" file=\""
+             << vtk_xml_escape(step.file) << "\"/>\n";
+    }
+    stream << "  </Collection>\n</VTKFile>\n";
+    if (!stream) {
+      DUNE_THROW(Dune::IOError, "could not write \"" << file << "\"");
+    }
+  }
+
+  void write_vtk_file(const std::string& file, const std::string& header,
+                      const std::vector<const std::string*>& arrays)
+  {
+    std::ofstream stream(file, std::ios::binary);
+    if (!stream) {
+      DUNE_THROW(Dune::IOError, "could not open \"" << file << "\" for writing");
+    }
+    stream << header;
+    for (const auto* array : arrays) {
+      stream.write(array->data(), array->size());
+    }
+    stream << "\n  </AppendedData>\n</VTKFile>\n";
+    if (!stream) {
+      DUNE_THROW(Dune::IOError, "could not write \"" << file << "\"");
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef DUNEURO_MATLAB_VTK_ENCODING_HH
+#define DUNEURO_MATLAB_VTK_ENCODING_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace duneuro
+{
+  /** \brief byte order of this machine as written to vtk files */
+  const char* vtk_byte_order();
+
+  /** \brief start of an xml vtk file of the given type with UInt64 headers */
+  std::string vtk_xml_header(const char* type, bool compressed);
+
+  /**
+   * \brief encode a data array for the raw appended section of a vtk file
+   *
+   * uncompressed arrays are prefixed with their size in bytes. Compressed arrays are split into
+   * blocks of 64KB compressed with the given zlib level, and prefixed with the number of blocks,
+   * the block size, the size of the last partial block and the compressed size of each block.
+   * Throws if compression is requested without zlib support.
+   */
+  std::string encode_vtk_array(const void* data, std::size_t bytes, bool compress, int level);
+
+  /** \brief whether compressed vtk output is available, i.e. the module was built with zlib */
+  bool vtk_compression_available();
+
+  /** \brief escape &, <, >, " and ' for use in an xml attribute value */
+  std::string vtk_xml_escape(const std::string& value);
+
+  /** \brief name of the file of a time step without extension, i.e. <filename>_<step> */
+  std::string vtk_step_name(const std::string& filename, std::size_t step);
+
+  /** \brief time step of a .pvd collection */
+  struct VTKCollectionEntry {
+    double time;
+    std::string file;
+  };
+
+  /** \brief write a .pvd collection of the given files, which are relative to its location */
+  void write_vtk_collection(const std::string& file, const std::vector<VTKCollectionEntry>& steps);
+
+  /**
+   * \brief write an xml vtk file consisting of a header, the appended data arrays and the end of
+   * the file
+   *
+   * the header has to end with the opening of the appended data section, i.e. with "_".
+   */
+  void write_vtk_file(const std::string& file, const std::string& header,
+                      const std::vector<const std::string*>& arrays);
+}
+
+#endif // DUNEURO_MATLAB_VTK_ENCODING_HH
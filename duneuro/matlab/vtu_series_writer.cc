@@ -0,0 +1,355 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/vtu_series_writer.hh>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_statistics.hh>
+#include <duneuro/matlab/driver_cache.hh>
+#include <duneuro/matlab/parallel.hh>
+#include <duneuro/matlab/vtk_encoding.hh>
+
+namespace duneuro
+{
+  namespace
+  {
+    // vtk cell types
+    constexpr std::uint8_t vtkTetra = 10;
+    constexpr std::uint8_t vtkHexahedron = 12;
+
+    // vertex i of a vtk hexahedron is vertex hexahedronVertices[i] of the dune hexahedron
+    constexpr std::array<unsigned int, 8> hexahedronVertices = {{0, 1, 3, 2, 4, 5, 7, 6}};
+
+    std::string piece_name(const std::string& filename, std::size_t step, std::size_t piece)
+    {
+      std::stringstream sstr;
+      sstr << vtk_step_name(filename, step) << "_" << std::setw(4) << std::setfill('0') << piece;
+      return sstr.str();
+    }
+  }
+
+  VTUSeriesWriter::VTUSeriesWriter(const Dune::ParameterTree& config)
+      : config_(config)
+      , filename_(config.get<std::string>("filename"))
+      , basename_(filename_.substr(filename_.find_last_of('/') + 1))
+      , compress_(config.get<bool>("compress", vtk_compression_available()))
+      , compressionLevel_(config.get<int>("compression_level", 1))
+      , threads_(config.get<unsigned int>("threads", default_number_of_threads()))
+      , labels_(config.get<bool>("labels", true))
+  {
+    if (compress_ && !vtk_compression_available()) {
+      DUNE_THROW(Dune::Exception, "compressed output requires duneuro-matlab built with zlib");
+    }
+    if (compressionLevel_ < 1 || compressionLevel_ > 9) {
+      DUNE_THROW(Dune::Exception, "compression_level has to be between 1 and 9");
+    }
+  }
+
+  VTUSeriesWriter::VTUSeriesWriter(const FittedDriverData<3>& mesh,
+                                   const Dune::ParameterTree& config)
+      : VTUSeriesWriter(config)
+  {
+    set_mesh(mesh);
+  }
+
+  VTUSeriesWriter::VTUSeriesWriter(std::shared_ptr<DriverInterface<3>> driver,
+                                   const Dune::ParameterTree& config)
+      : VTUSeriesWriter(config)
+  {
+    driver_ = std::move(driver);
+  }
+
+  void VTUSeriesWriter::set_mesh(const FittedDriverData<3>& mesh)
+  {
+    if (has_mesh()) {
+      DUNE_THROW(Dune::Exception, "the mesh of the writer is already set");
+    }
+    const std::size_t numberOfVertices = mesh.nodes.size();
+    const std::size_t numberOfCells = mesh.elements.size();
+    if (labels_ && mesh.labels.size() != numberOfCells) {
+      DUNE_THROW(Dune::Exception, "number of labels and number of elements do not match");
+    }
+    for (const auto& element : mesh.elements) {
+      if (element.size() != 4 && element.size() != 8) {
+        DUNE_THROW(Dune::Exception, "only tetrahedral and hexahedral meshes are supported");
+      }
+      for (auto vertex : element) {
+        if (vertex >= numberOfVertices) {
+          DUNE_THROW(Dune::Exception, "element refers to vertex " << vertex << ", but the mesh has "
+                                                                  << numberOfVertices
+                                                                  << " vertices");
+        }
+      }
+    }
+    numberOfVertices_ = numberOfVertices;
+    numberOfCells_ = numberOfCells;
+    const std::size_t pieces =
+        std::max<std::size_t>(1, std::min(config_.get<std::size_t>("pieces", 1), numberOfCells_));
+    std::vector<Piece> encoded(pieces);
+    for (std::size_t p = 0; p < pieces; ++p) {
+      encoded[p].cellBegin = p * numberOfCells_ / pieces;
+      encoded[p].cellEnd = (p + 1) * numberOfCells_ / pieces;
+    }
+    ScopedPhase phase("encode_vtu_geometry");
+    parallel_for_blocks(pieces, 1, threads_, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t p = begin; p < end; ++p) {
+        encode_geometry(mesh, encoded[p]);
+      }
+    });
+    pieces_ = std::move(encoded);
+  }
+
+  void VTUSeriesWriter::add_vertex_data(const std::string& name, const double* values,
+                                        std::size_t steps, const std::vector<double>& times)
+  {
+    add_data(name, true, values, steps, times);
+  }
+
+  void VTUSeriesWriter::add_cell_data(const std::string& name, const double* values,
+                                      std::size_t steps, const std::vector<double>& times)
+  {
+    add_data(name, false, values, steps, times);
+  }
+
+  void VTUSeriesWriter::add_function_data(const std::string& name,
+                                          const std::vector<const Function*>& functions,
+                                          bool vertexData, const std::vector<double>& times)
+  {
+    if (!driver_) {
+      DUNE_THROW(Dune::Exception, "functions can only be added to a writer created for a driver");
+    }
+    check_times(functions.size(), times);
+    ScopedPhase phase("write_vtu_series");
+    auto lock = DriverCache::instance().lock(driver_.get());
+    for (std::size_t step = 0; step < functions.size(); ++step) {
+      const std::size_t index = collection_.size();
+      auto writer = driver_->volumeConductorVTKWriter(config_);
+      if (vertexData) {
+        writer->addVertexData(*functions[step], name);
+      } else {
+        writer->addCellData(*functions[step], name);
+      }
+      Dune::ParameterTree config;
+      config["filename"] = vtk_step_name(filename_, index);
+      writer->write(config);
+      collection_.push_back(VTKCollectionEntry{
+          times.empty() ? static_cast<double>(index) : times[step],
+          vtk_step_name(basename_, index) + ".vtu"});
+    }
+    write_collection();
+  }
+
+  void VTUSeriesWriter::check_times(std::size_t steps, const std::vector<double>& times) const
+  {
+    if (!times.empty() && times.size() != steps) {
+      DUNE_THROW(Dune::Exception, "expected one time per step, got " << times.size()
+                                                                      << " times for " << steps
+                                                                      << " steps");
+    }
+  }
+
+  void VTUSeriesWriter::add_data(const std::string& name, bool vertexData, const double* values,
+                                 std::size_t steps, const std::vector<double>& times)
+  {
+    if (!has_mesh()) {
+      DUNE_THROW(Dune::Exception, "arrays can only be added once the mesh of the writer is set");
+    }
+    check_times(steps, times);
+    const std::size_t entries = vertexData ? numberOfVertices_ : numberOfCells_;
+    const std::size_t firstStep = collection_.size();
+    const bool partitioned = pieces_.size() > 1;
+    ScopedPhase phase("write_vtu_series", steps * entries * sizeof(double));
+    // every piece of every step is encoded and written independently
+    parallel_for_blocks(steps * pieces_.size(), 1, threads_,
+                        [&](std::size_t begin, std::size_t end) {
+                          for (std::size_t task = begin; task < end; ++task) {
+                            const std::size_t step = task / pieces_.size();
+                            const std::size_t p = task % pieces_.size();
+                            const std::string file =
+                                partitioned ? piece_name(filename_, firstStep + step, p)
+                                            : vtk_step_name(filename_, firstStep + step);
+                            write_piece(pieces_[p], file + ".vtu", name, vertexData,
+                                        values + step * entries);
+                          }
+                        });
+    for (std::size_t step = 0; step < steps; ++step) {
+      const std::size_t index = firstStep + step;
+      if (partitioned) {
+        write_pieces_collection(index, name, vertexData);
+      }
+      collection_.push_back(VTKCollectionEntry{
+          times.empty() ? static_cast<double>(index) : times[step],
+          vtk_step_name(basename_, index) + (partitioned ? ".pvtu" : ".vtu")});
+    }
+    write_collection();
+  }
+
+  void VTUSeriesWriter::write_pieces_collection(std::size_t index, const std::string& name,
+                                                bool vertexData) const
+  {
+    const auto escaped = vtk_xml_escape(name);
+    std::stringstream sstr;
+    sstr << vtk_xml_header("PUnstructuredGrid", false)
+         << "  <PUnstructuredGrid GhostLevel=\"0\">\n";
+    if (vertexData) {
+      sstr << "    <PPointData Scalars=\"" << escaped << "\">\n"
+           << "      <PDataArray type=\"Float64\" Name=\"" << escaped << "\"/>\n"
+           << "    </PPointData>\n";
+    }
+    if (!vertexData || labels_) {
+      sstr << "    <PCellData>\n";
+      if (!vertexData) {
+        sstr << "      <PDataArray type=\"Float64\" Name=\"" << escaped << "\"/>\n";
+      }
+      if (labels_) {
+        sstr << "      <PDataArray type=\"Int32\" Name=\"label\"/>\n";
+      }
+      sstr << "    </PCellData>\n";
+    }
+    sstr << "    <PPoints>\n"
+         << "      <PDataArray type=\"Float64\" NumberOfComponents=\"3\"/>\n"
+         << "    </PPoints>\n";
+    for (std::size_t p = 0; p < pieces_.size(); ++p) {
+      sstr << "    <Piece Source=\"" << vtk_xml_escape(piece_name(basename_, index, p))
+           << ".vtu\"/>\n";
+    }
+    sstr << "  </PUnstructuredGrid>\n</VTKFile>\n";
+    const std::string file = vtk_step_name(filename_, index) + ".pvtu";
+    std::ofstream stream(file);
+    stream << sstr.str();
+    if (!stream) {
+      DUNE_THROW(Dune::IOError, "could not write \"" << file << "\"");
+    }
+  }
+
+  void VTUSeriesWriter::encode_geometry(const FittedDriverData<3>& mesh, Piece& piece) const
+  {
+    // local numbering of the vertices used by the cells of the piece
+    std::vector<std::int64_t> local(numberOfVertices_, -1);
+    for (std::size_t c = piece.cellBegin; c < piece.cellEnd; ++c) {
+      for (auto vertex : mesh.elements[c]) {
+        local[vertex] = 0;
+      }
+    }
+    for (std::size_t v = 0; v < numberOfVertices_; ++v) {
+      if (local[v] >= 0) {
+        local[v] = piece.vertices.size();
+        piece.vertices.push_back(v);
+      }
+    }
+    std::vector<double> points;
+    points.reserve(3 * piece.vertices.size());
+    for (auto v : piece.vertices) {
+      points.insert(points.end(), mesh.nodes[v].begin(), mesh.nodes[v].end());
+    }
+    std::vector<std::int64_t> connectivity, offsets;
+    std::vector<std::uint8_t> types;
+    std::vector<std::int32_t> labels;
+    for (std::size_t c = piece.cellBegin; c < piece.cellEnd; ++c) {
+      const auto& element = mesh.elements[c];
+      if (element.size() == 4) {
+        for (auto vertex : element) {
+          connectivity.push_back(local[vertex]);
+        }
+        types.push_back(vtkTetra);
+      } else {
+        for (auto i : hexahedronVertices) {
+          connectivity.push_back(local[element[i]]);
+        }
+        types.push_back(vtkHexahedron);
+      }
+      offsets.push_back(connectivity.size());
+      if (labels_) {
+        labels.push_back(static_cast<std::int32_t>(mesh.labels[c]));
+      }
+    }
+    auto add = [&](const void* data, std::size_t bytes) {
+      piece.geometryOffsets.push_back(piece.geometry.size());
+      piece.geometry += encode(data, bytes);
+    };
+    add(points.data(), points.size() * sizeof(double));
+    add(connectivity.data(), connectivity.size() * sizeof(std::int64_t));
+    add(offsets.data(), offsets.size() * sizeof(std::int64_t));
+    add(types.data(), types.size() * sizeof(std::uint8_t));
+    if (labels_) {
+      add(labels.data(), labels.size() * sizeof(std::int32_t));
+    }
+  }
+
+  void VTUSeriesWriter::write_piece(const Piece& piece, const std::string& file,
+                                    const std::string& name, bool vertexData,
+                                    const double* values) const
+  {
+    std::string data;
+    if (vertexData) {
+      std::vector<double> gathered(piece.vertices.size());
+      std::transform(piece.vertices.begin(), piece.vertices.end(), gathered.begin(),
+                     [&](std::size_t v) { return values[v]; });
+      data = encode(gathered.data(), gathered.size() * sizeof(double));
+    } else {
+      data = encode(values + piece.cellBegin, (piece.cellEnd - piece.cellBegin) * sizeof(double));
+    }
+    // the geometry is appended after the data, so its offsets are shifted by the size of the data
+    auto offset = [&](std::size_t i) { return data.size() + piece.geometryOffsets[i]; };
+    const auto escaped = vtk_xml_escape(name);
+    std::stringstream sstr;
+    sstr << vtk_xml_header("UnstructuredGrid", compress_) << "  <UnstructuredGrid>\n"
+         << "    <Piece NumberOfPoints=\"" << piece.vertices.size() << "\" NumberOfCells=\""
+         << piece.cellEnd - piece.cellBegin << "\">\n";
+    const char* dataArray = "      <DataArray type=\"";
+    if (vertexData) {
+      sstr << "      <PointData Scalars=\"" << escaped << "\">\n"
+           << "  " << dataArray << "Float64\" Name=\"" << escaped
+           << "\" format=\"appended\" offset=\"0\"/>\n"
+           << "      </PointData>\n";
+    }
+    if (!vertexData || labels_) {
+      sstr << "      <CellData>\n";
+      if (!vertexData) {
+        sstr << "  " << dataArray << "Float64\" Name=\"" << escaped
+             << "\" format=\"appended\" offset=\"0\"/>\n";
+      }
+      if (labels_) {
+        sstr << "  " << dataArray << "Int32\" Name=\"label\" format=\"appended\" offset=\""
+             << offset(4) << "\"/>\n";
+      }
+      sstr << "      </CellData>\n";
+    }
+    sstr << "      <Points>\n"
+         << "  " << dataArray << "Float64\" NumberOfComponents=\"3\" format=\"appended\" offset=\""
+         << offset(0) << "\"/>\n"
+         << "      </Points>\n"
+         << "      <Cells>\n"
+         << "  " << dataArray << "Int64\" Name=\"connectivity\" format=\"appended\" offset=\""
+         << offset(1) << "\"/>\n"
+         << "  " << dataArray << "Int64\" Name=\"offsets\" format=\"appended\" offset=\""
+         << offset(2) << "\"/>\n"
+         << "  " << dataArray << "UInt8\" Name=\"types\" format=\"appended\" offset=\""
+         << offset(3) << "\"/>\n"
+         << "      </Cells>\n"
+         << "    </Piece>\n"
+         << "  </UnstructuredGrid>\n"
+         << "  <AppendedData encoding=\"raw\">\n"
+         << "_";
+    write_vtk_file(file, sstr.str(), {&data, &piece.geometry});
+  }
+
+  void VTUSeriesWriter::write_collection() const
+  {
+    write_vtk_collection(filename_ + ".pvd", collection_);
+  }
+
+  std::string VTUSeriesWriter::encode(const void* data, std::size_t bytes) const
+  {
+    return encode_vtk_array(data, bytes, compress_, compressionLevel_);
+  }
+}
@@ -0,0 +1,145 @@
+#ifndef DUNEURO_MATLAB_VTU_SERIES_WRITER_HH
+#define DUNEURO_MATLAB_VTU_SERIES_WRITER_HH
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dune/common/parametertree.hh>
+
+#include <duneuro/common/fitted_driver_data.hh>
+#include <duneuro/driver/driver_factory.hh>
+
+#include <duneuro/matlab/vtk_encoding.hh>
+
+namespace duneuro
+{
+  /**
+   * \brief writes data on a fixed tetrahedral or hexahedral mesh as a series of vtu files
+   *
+   * Each call to add_vertex_data or add_cell_data appends one time step per column of the data
+   * and records it in a .pvd collection, which is rewritten after every call so that it stays
+   * valid if the export is interrupted. Files use the binary appended vtk format, zlib compressed
+   * if compress is set (the default if the module was built with zlib).
+   *
+   * A writer created for a driver also appends functions, e.g. solutions of the driver, with
+   * add_function_data. Their time steps are written on the grid of the driver by its vtk writer,
+   * see DriverInterface::volumeConductorVTKWriter. Arrays are numbered like the nodes of the mesh
+   * the driver was created from, which the grid of the driver does not expose, so arrays can
+   * only be added once that mesh is set, see set_mesh.
+   *
+   * The mesh is converted and encoded only once, and the encoded geometry is copied into the file
+   * of each time step, so that a time step only costs the encoding of its data. If pieces is
+   * larger than one, the cells are split into that many contiguous parts, each time step is
+   * written as a .pvtu file referencing one .vtu file per piece, and the pieces are encoded and
+   * written on threads threads.
+   *
+   * Configuration:
+   *   filename: path of the output without extension. Files are named <filename>.pvd,
+   *             <filename>_<step>.vtu or .pvtu and <filename>_<step>_<piece>.vtu
+   *   compress: whether to compress the data with zlib, default true if available
+   *   compression_level: zlib compression level from 1 (fast) to 9 (small), default 1
+   *   pieces: number of pieces, default 1
+   *   threads: number of threads for encoding and writing, default all cores
+   *   labels: whether the element labels are written as cell data, default true
+   *   The config is also passed to the vtk writer of the driver, e.g. its mode.
+   *
+   * Does not use the mex api.
+   */
+  class VTUSeriesWriter
+  {
+  public:
+    VTUSeriesWriter(const FittedDriverData<3>& mesh, const Dune::ParameterTree& config);
+
+    /** \brief writer for functions on the grid of the driver, which is kept alive */
+    VTUSeriesWriter(std::shared_ptr<DriverInterface<3>> driver, const Dune::ParameterTree& config);
+
+    /** \brief convert and encode the mesh the data of add_vertex_data and add_cell_data refer to */
+    void set_mesh(const FittedDriverData<3>& mesh);
+
+    bool has_mesh() const
+    {
+      return !pieces_.empty();
+    }
+
+    /**
+     * \brief append one time step per column of the (vertices x steps) column major values
+     *
+     * times contains the time of each step. If it is empty, the index of the step is used.
+     * Throws if no mesh is set.
+     */
+    void add_vertex_data(const std::string& name, const double* values, std::size_t steps,
+                         const std::vector<double>& times);
+
+    /** \brief append one time step per column of the (cells x steps) column major values */
+    void add_cell_data(const std::string& name, const double* values, std::size_t steps,
+                       const std::vector<double>& times);
+
+    std::size_t number_of_vertices() const
+    {
+      return numberOfVertices_;
+    }
+
+    std::size_t number_of_cells() const
+    {
+      return numberOfCells_;
+    }
+
+    /**
+     * \brief append one time step per function, evaluated at the vertices or cells of the grid of
+     * the driver
+     *
+     * the driver is locked while the steps are written. Throws if the writer was not created for
+     * a driver.
+     */
+    void add_function_data(const std::string& name, const std::vector<const Function*>& functions,
+                           bool vertexData, const std::vector<double>& times);
+
+    /** \brief number of time steps written so far */
+    std::size_t number_of_steps() const
+    {
+      return collection_.size();
+    }
+
+  private:
+    explicit VTUSeriesWriter(const Dune::ParameterTree& config);
+
+    // a contiguous range of cells together with the vertices they use and their encoded geometry
+    struct Piece {
+      std::size_t cellBegin;
+      std::size_t cellEnd;
+      std::vector<std::size_t> vertices;
+      std::string geometry;
+      std::vector<std::size_t> geometryOffsets;
+    };
+
+    void add_data(const std::string& name, bool vertexData, const double* values,
+                  std::size_t steps, const std::vector<double>& times);
+    void check_times(std::size_t steps, const std::vector<double>& times) const;
+    void encode_geometry(const FittedDriverData<3>& mesh, Piece& piece) const;
+    void write_piece(const Piece& piece, const std::string& file, const std::string& name,
+                     bool vertexData, const double* values) const;
+    // writes the .pvtu file listing the arrays and the files of the pieces of a step
+    void write_pieces_collection(std::size_t step, const std::string& name,
+                                 bool vertexData) const;
+    void write_collection() const;
+    std::string encode(const void* data, std::size_t bytes) const;
+
+    Dune::ParameterTree config_;
+    std::shared_ptr<DriverInterface<3>> driver_;
+    std::string filename_;
+    // filename_ without its directory, files are referenced relative to the collection
+    std::string basename_;
+    bool compress_;
+    int compressionLevel_;
+    unsigned int threads_;
+    bool labels_;
+    std::size_t numberOfVertices_ = 0;
+    std::size_t numberOfCells_ = 0;
+    std::vector<Piece> pieces_;
+    std::vector<VTKCollectionEntry> collection_;
+  };
+}
+
+#endif // DUNEURO_MATLAB_VTU_SERIES_WRITER_HH
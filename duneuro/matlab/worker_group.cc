@@ -0,0 +1,290 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <duneuro/matlab/worker_group.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <dune/common/exceptions.hh>
+#if HAVE_MPI
+#include <dune/common/parallel/mpihelper.hh>
+#endif
+
+namespace duneuro
+{
+  namespace
+  {
+    /**
+     * rank 0 and the worker processes forked by it, connected by one socket pair per worker.
+     * A group of size 1 is the process itself.
+     */
+    class LocalWorkerGroup : public WorkerGroup
+    {
+    public:
+      // fds[r] is the socket to rank r on rank 0 and fds[0] the socket to rank 0 on the workers
+      LocalWorkerGroup(int rank, int size, std::vector<int> fds, std::vector<pid_t> workers)
+          : rank_(rank), size_(size), fds_(std::move(fds)), workers_(std::move(workers))
+      {
+      }
+
+      ~LocalWorkerGroup()
+      {
+        close_sockets();
+      }
+
+      int rank() const override
+      {
+        return rank_;
+      }
+
+      int size() const override
+      {
+        return size_;
+      }
+
+      void send_to_root(const void* data, std::size_t bytes) override
+      {
+        const char* ptr = static_cast<const char*>(data);
+        for (std::size_t sent = 0; sent < bytes;) {
+          // MSG_NOSIGNAL turns a terminated rank 0 into an error instead of SIGPIPE
+          ssize_t n = ::send(fds_[0], ptr + sent, bytes - sent, MSG_NOSIGNAL);
+          if (n < 0 && errno == EINTR) {
+            continue;
+          }
+          if (n < 0) {
+            DUNE_THROW(Dune::IOError, "rank 0 terminated: " << std::strerror(errno));
+          }
+          sent += n;
+        }
+      }
+
+      void receive_from(int rank, void* data, std::size_t bytes) override
+      {
+        char* ptr = static_cast<char*>(data);
+        for (std::size_t received = 0; received < bytes;) {
+          ssize_t n = ::recv(fds_[rank], ptr + received, bytes - received, 0);
+          if (n < 0 && errno == EINTR) {
+            continue;
+          }
+          if (n <= 0) {
+            DUNE_THROW(Dune::IOError, "rank " << rank << " terminated before sending its data");
+          }
+          received += n;
+        }
+      }
+
+      int finish(int status) override
+      {
+        if (status != 0) {
+          for (auto pid : workers_) {
+            ::kill(pid, SIGTERM);
+          }
+        }
+        close_sockets();
+        for (auto pid : workers_) {
+          int workerStatus = 0;
+          pid_t result;
+          do {
+            result = ::waitpid(pid, &workerStatus, 0);
+          } while (result < 0 && errno == EINTR);
+          if (result < 0 || !WIFEXITED(workerStatus) || WEXITSTATUS(workerStatus) != 0) {
+            status = 1;
+          }
+        }
+        workers_.clear();
+        return status;
+      }
+
+    private:
+      void close_sockets()
+      {
+        for (auto fd : fds_) {
+          if (fd >= 0) {
+            ::close(fd);
+          }
+        }
+        fds_.clear();
+      }
+
+      int rank_;
+      int size_;
+      std::vector<int> fds_;
+      std::vector<pid_t> workers_;
+    };
+
+    std::unique_ptr<WorkerGroup> fork_local_workers(int size)
+    {
+      std::vector<int> fds(1, -1);
+      std::vector<pid_t> workers;
+      // buffered output would be written by every process otherwise
+      std::cout.flush();
+      std::cerr.flush();
+      for (int rank = 1; rank < size; ++rank) {
+        int sockets[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+          DUNE_THROW(Dune::IOError, "could not create socket pair: " << std::strerror(errno));
+        }
+        const pid_t pid = ::fork();
+        if (pid < 0) {
+          const int error = errno;
+          ::close(sockets[0]);
+          ::close(sockets[1]);
+          DUNE_THROW(Dune::IOError, "could not fork worker: " << std::strerror(error));
+        }
+        if (pid == 0) {
+          // the sockets of rank 0 to the previous workers
+          for (auto fd : fds) {
+            if (fd >= 0) {
+              ::close(fd);
+            }
+          }
+          ::close(sockets[0]);
+          return std::make_unique<LocalWorkerGroup>(rank, size, std::vector<int>{sockets[1]},
+                                                    std::vector<pid_t>());
+        }
+        ::close(sockets[1]);
+        fds.push_back(sockets[0]);
+        workers.push_back(pid);
+      }
+      return std::make_unique<LocalWorkerGroup>(0, size, std::move(fds), std::move(workers));
+    }
+
+#if HAVE_MPI
+    class MPIWorkerGroup : public WorkerGroup
+    {
+    public:
+      MPIWorkerGroup(int rank, int size) : rank_(rank), size_(size)
+      {
+      }
+
+      int rank() const override
+      {
+        return rank_;
+      }
+
+      int size() const override
+      {
+        return size_;
+      }
+
+      void send_to_root(const void* data, std::size_t bytes) override
+      {
+        const char* ptr = static_cast<const char*>(data);
+        do {
+          const std::size_t n = std::min(bytes, maxChunk);
+          MPI_Send(const_cast<char*>(ptr), n, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+          ptr += n;
+          bytes -= n;
+        } while (bytes > 0);
+      }
+
+      void receive_from(int rank, void* data, std::size_t bytes) override
+      {
+        char* ptr = static_cast<char*>(data);
+        do {
+          const std::size_t n = std::min(bytes, maxChunk);
+          MPI_Recv(ptr, n, MPI_BYTE, rank, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+          ptr += n;
+          bytes -= n;
+        } while (bytes > 0);
+      }
+
+      int finish(int status) override
+      {
+        if (status != 0 && size_ > 1) {
+          MPI_Abort(MPI_COMM_WORLD, status);
+        }
+        return status;
+      }
+
+    private:
+      // mpi counts are ints
+      static constexpr std::size_t maxChunk = std::size_t(1) << 30;
+
+      int rank_;
+      int size_;
+    };
+#endif
+  }
+
+  std::unique_ptr<WorkerGroup> WorkerGroup::create(int& argc, char**& argv,
+                                                   unsigned int localWorkers)
+  {
+    if (localWorkers > 1) {
+      // mpi is not initialized, since forking an mpi process is not supported
+      return fork_local_workers(localWorkers);
+    }
+#if HAVE_MPI
+    const auto& helper = Dune::MPIHelper::instance(argc, argv);
+    if (helper.size() > 1) {
+      return std::make_unique<MPIWorkerGroup>(helper.rank(), helper.size());
+    }
+#endif
+    return std::make_unique<LocalWorkerGroup>(0, 1, std::vector<int>(), std::vector<pid_t>());
+  }
+
+  mxArray* gather_columns(WorkerGroup& group, const mxArray* arr)
+  {
+    if (!arr || !mxIsNumeric(arr) || mxIsComplex(arr) || mxIsSparse(arr)
+        || mxGetNumberOfDimensions(arr) != 2) {
+      DUNE_THROW(Dune::Exception, "only real numeric matrices can be gathered");
+    }
+    const std::size_t bytes = mxGetNumberOfElements(arr) * mxGetElementSize(arr);
+    if (group.rank() != 0) {
+      const std::uint64_t shape[3] = {static_cast<std::uint64_t>(mxGetClassID(arr)), mxGetM(arr),
+                                      mxGetN(arr)};
+      group.send_to_root(shape, sizeof(shape));
+      if (bytes > 0) {
+        group.send_to_root(mxGetData(arr), bytes);
+      }
+      return nullptr;
+    }
+    std::vector<std::size_t> columns(group.size());
+    columns[0] = mxGetN(arr);
+    for (int rank = 1; rank < group.size(); ++rank) {
+      std::uint64_t shape[3];
+      group.receive_from(rank, shape, sizeof(shape));
+      if (shape[0] != static_cast<std::uint64_t>(mxGetClassID(arr))) {
+        DUNE_THROW(Dune::Exception, "the matrix of rank " << rank << " has a different class");
+      }
+      if (shape[1] != mxGetM(arr)) {
+        DUNE_THROW(Dune::Exception, "the matrix of rank " << rank << " has " << shape[1]
+                                                          << " rows instead of " << mxGetM(arr));
+      }
+      columns[rank] = shape[2];
+    }
+    const std::size_t total = std::accumulate(columns.begin(), columns.end(), std::size_t(0));
+    mxArray* out = mxCreateUninitNumericMatrix(mxGetM(arr), total, mxGetClassID(arr), mxREAL);
+    try {
+      char* position = static_cast<char*>(mxGetData(out));
+      if (bytes > 0) {
+        std::memcpy(position, mxGetData(arr), bytes);
+        position += bytes;
+      }
+      for (int rank = 1; rank < group.size(); ++rank) {
+        const std::size_t blockBytes = mxGetM(arr) * columns[rank] * mxGetElementSize(arr);
+        if (blockBytes > 0) {
+          group.receive_from(rank, position, blockBytes);
+          position += blockBytes;
+        }
+      }
+    } catch (...) {
+      mxDestroyArray(out);
+      throw;
+    }
+    return out;
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef DUNEURO_MATLAB_WORKER_GROUP_HH
+#define DUNEURO_MATLAB_WORKER_GROUP_HH
+
+#include <mex.h>
+
+#include <cstddef>
+#include <memory>
+
+namespace duneuro
+{
+  /**
+   * \brief processes executing the same job of duneuro_matlab_runner, identified by their rank
+   *
+   * the group consists either of the ranks of an mpi run, if the runner is built with mpi and
+   * started by mpirun, or of local worker processes forked at startup. Data only flows from the
+   * ranks to rank 0, see gather_columns.
+   */
+  class WorkerGroup
+  {
+  public:
+    /**
+     * \brief create the group of the current process
+     *
+     * localWorkers > 1 forks localWorkers - 1 processes, which return from create with ranks 1 to
+     * localWorkers - 1. Has to be called before any thread is started. Local workers can not be
+     * combined with an mpi run of several ranks.
+     */
+    static std::unique_ptr<WorkerGroup> create(int& argc, char**& argv, unsigned int localWorkers);
+
+    virtual ~WorkerGroup() = default;
+
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+
+    /** \brief send bytes from the current rank, which must not be 0, to rank 0 */
+    virtual void send_to_root(const void* data, std::size_t bytes) = 0;
+
+    /** \brief receive the next bytes sent by the given rank, called on rank 0 only */
+    virtual void receive_from(int rank, void* data, std::size_t bytes) = 0;
+
+    /**
+     * \brief end the participation of the current rank and return the exit status of the process
+     *
+     * rank 0 waits for local workers and fails if one of them failed. A failing rank stops the
+     * other ranks, as they might wait for its data otherwise.
+     */
+    virtual int finish(int status) = 0;
+  };
+
+  /**
+   * \brief concatenate the matrices of all ranks horizontally, in the order of the ranks
+   *
+   * has to be called by all ranks. The matrices have to be real numeric matrices of the same class
+   * and number of rows. Each block is copied into the result as it arrives, so rank 0 holds the
+   * result and a single block at a time. Returns the result on rank 0 and nullptr on the other
+   * ranks.
+   */
+  mxArray* gather_columns(WorkerGroup& group, const mxArray* arr);
+}
+
+#endif // DUNEURO_MATLAB_WORKER_GROUP_HH
@@ -16,6 +16,11 @@
 
 void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
 {
+  static bool atExitRegistered = false;
+  if (!atExitRegistered) {
+    mexAtExit(duneuro::CommandHandler::at_exit);
+    atExitRegistered = true;
+  }
   try {
     if (nrhs == 0) {
       mexErrMsgTxt("please provide a command argument");
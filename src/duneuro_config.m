@@ -0,0 +1,16 @@
+classdef duneuro_config < handle
+    properties (Hidden = true)
+        cpp_handle;
+    end
+    methods
+        % Constructor, converts the config struct once. the object can be passed to every method
+        % expecting a config struct.
+        function this = duneuro_config(config)
+            this.cpp_handle = duneuro_matlab('compile_config', config);
+        end
+        % Destructor
+        function delete(this)
+            duneuro_matlab('delete_config', this.cpp_handle);
+        end
+    end
+end
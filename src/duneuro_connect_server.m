@@ -0,0 +1,22 @@
+% connects this matlab session to a duneuro_matlab_server, which hosts the drivers, transfer
+% matrices and all other objects of its clients in one process:
+%
+%   $ duneuro_matlab_server --socket /tmp/duneuro.sock &
+%
+%   duneuro_connect_server('/tmp/duneuro.sock');
+%   meeg = duneuro_meeg(cfg);
+%
+% afterwards all duneuro objects are created in the server. Sessions creating a driver from the
+% same struct with cfg.driver_cache.enable = true share a single copy of it, while each of them
+% keeps its own electrodes and coils. Objects created before connecting can not be used while
+% connected. Arrays of at least config.shared_memory_threshold bytes (default 1 MiB) are passed
+% through shared memory. Relative file names are resolved in the working directory of the server.
+% The objects of a session are released by the server when it disconnects, see
+% duneuro_disconnect_server.
+function duneuro_connect_server(socket_path, config)
+  if nargin < 2
+    duneuro_matlab('connect_server', socket_path);
+  else
+    duneuro_matlab('connect_server', socket_path, config);
+  end
+end
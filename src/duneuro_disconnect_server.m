@@ -0,0 +1,5 @@
+% closes the connection to a duneuro_matlab_server, see duneuro_connect_server. The server
+% releases all objects created by this session, so they can not be used afterwards.
+function duneuro_disconnect_server()
+  duneuro_matlab('disconnect_server');
+end
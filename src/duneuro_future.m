@@ -0,0 +1,40 @@
+classdef duneuro_future < handle
+    properties (Hidden = true)
+        cpp_handle;
+        % matlab objects the job uses
+        dependencies;
+        % optional function applied to the result of the job
+        postprocess;
+    end
+    methods
+        % Constructor
+        function this = duneuro_future(cpp_handle, dependencies, postprocess)
+            this.cpp_handle = cpp_handle;
+            this.dependencies = dependencies;
+            if nargin > 2
+                this.postprocess = postprocess;
+            else
+                this.postprocess = [];
+            end
+        end
+        % returns 'pending', 'running', 'finished', 'failed' or 'cancelled'
+        function state = poll(this)
+            state = duneuro_matlab('poll', this.cpp_handle);
+        end
+        % blocks until the job is done and returns its result
+        function varargout = wait(this)
+            varargout = cell(1, nargout);
+            [varargout{:}] = duneuro_matlab('wait', this.cpp_handle);
+            if ~isempty(this.postprocess) && nargout > 0
+                varargout{1} = this.postprocess(varargout{1});
+            end
+        end
+        function cancel(this)
+            duneuro_matlab('cancel', this.cpp_handle);
+        end
+        % Destructor, cancels the job without waiting for it to stop
+        function delete(this)
+            duneuro_matlab('delete_future', this.cpp_handle);
+        end
+    end
+end
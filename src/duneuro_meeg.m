@@ -6,16 +6,23 @@ classdef duneuro_meeg < handle
         electrodes;
         coils;
         projections;
+        % snapshot file the driver was saved to or loaded from, see save_snapshot
+        snapshot;
     end
     methods
         % Constructor
-        function this = duneuro_meeg(config)
-            this.cpp_handle = duneuro_matlab('create', config);
+        function this = duneuro_meeg(config, cpp_handle)
+            if nargin > 1
+                this.cpp_handle = cpp_handle;
+            else
+                this.cpp_handle = duneuro_matlab('create', config);
+            end
             this.constructor_arguments = config;
             this.source_model = [];
             this.electrodes = [];
             this.coils = [];
             this.projections = [];
+            this.snapshot = [];
         end
         % Destructor
         function delete(this)
@@ -24,14 +31,25 @@ classdef duneuro_meeg < handle
         function solve_eeg_forward(this, dipole, func, config)
             duneuro_matlab('solve_eeg_forward', this.cpp_handle, dipole, func.cpp_handle, config);
         end
+        % electrode potentials of the 6xN dipoles, solved one after another. Saves the calls
+        % into the mex file, each dipole is still a full solve of the driver.
+        function potentials = solve_eeg_forward_batch(this, dipoles, config)
+            potentials = duneuro_matlab('solve_eeg_forward_batch', this.cpp_handle, dipoles, config);
+        end
         function solution = solve_meg_forward(this, func, config)
             solution = duneuro_matlab('solve_meg_forward', this.cpp_handle, func.cpp_handle, config);
         end
         function matrix = compute_eeg_transfer_matrix(this, config)
             matrix = duneuro_matlab('compute_eeg_transfer_matrix', this.cpp_handle, config);
+            if isa(matrix, 'uint64')
+                matrix = duneuro_transfer_matrix(matrix);
+            end
         end
         function matrix = compute_meg_transfer_matrix(this, config)
             matrix = duneuro_matlab('compute_meg_transfer_matrix', this.cpp_handle, config);
+            if isa(matrix, 'uint64')
+                matrix = duneuro_transfer_matrix(matrix);
+            end
         end
         function set_electrodes(this, electrodes, config)
             duneuro_matlab('set_electrodes', this.cpp_handle, electrodes, config);
@@ -49,17 +67,106 @@ classdef duneuro_meeg < handle
         function solution = evaluate_at_electrodes(this, func)
             solution = duneuro_matlab('evaluate_at_electrodes', this.cpp_handle, func.cpp_handle);
         end
+        % evaluates an array or cell array of duneuro_function objects at the electrodes,
+        % returning one column per function
+        function solution = evaluate_at_electrodes_batch(this, funcs, config)
+            if iscell(funcs)
+                handles = cellfun(@(f) f.cpp_handle, funcs);
+            else
+                handles = [funcs.cpp_handle];
+            end
+            if nargin < 3
+                config = struct();
+            end
+            solution = duneuro_matlab('evaluate_at_electrodes_batch', this.cpp_handle, uint64(handles), config);
+        end
+        % single precision transfer matrices only save memory while they are stored. Applying
+        % one requires config.apply.widen_single = true and widens a double copy of it first,
+        % which is slower than applying the double matrix.
         function solution = apply_eeg_transfer(this, transfer_matrix, dipoles, config)
+            if isa(transfer_matrix, 'duneuro_transfer_matrix')
+                transfer_matrix = transfer_matrix.cpp_handle;
+            end
             solution = duneuro_matlab('apply_eeg_transfer', this.cpp_handle, transfer_matrix, dipoles, config);
         end
         function solution = apply_meg_transfer(this, transfer_matrix, dipoles, config)
+            if isa(transfer_matrix, 'duneuro_transfer_matrix')
+                transfer_matrix = transfer_matrix.cpp_handle;
+            end
             solution = duneuro_matlab('apply_meg_transfer', this.cpp_handle, transfer_matrix, dipoles, config);
         end
+        % applies both transfer matrices to the dipoles in a single pass
+        function [eeg, meg] = apply_meeg_transfer(this, eeg_transfer_matrix, meg_transfer_matrix, dipoles, config)
+            if isa(eeg_transfer_matrix, 'duneuro_transfer_matrix')
+                eeg_transfer_matrix = eeg_transfer_matrix.cpp_handle;
+            end
+            if isa(meg_transfer_matrix, 'duneuro_transfer_matrix')
+                meg_transfer_matrix = meg_transfer_matrix.cpp_handle;
+            end
+            [eeg, meg] = duneuro_matlab('apply_meeg_transfer', this.cpp_handle, eeg_transfer_matrix, meg_transfer_matrix, dipoles, config);
+        end
+        % leadfield of the 3xN source positions, with the x, y and z columns of each position
+        % next to each other. config.modality selects eeg (default) or meg.
+        function leadfield = compute_leadfield(this, transfer_matrix, positions, config)
+            if isa(transfer_matrix, 'duneuro_transfer_matrix')
+                transfer_matrix = transfer_matrix.cpp_handle;
+            end
+            leadfield = duneuro_matlab('compute_leadfield', this.cpp_handle, transfer_matrix, positions, config);
+        end
+        function future = solve_eeg_forward_async(this, dipole, func, config)
+            future = duneuro_future(duneuro_matlab('solve_eeg_forward_async', this.cpp_handle, dipole, func.cpp_handle, config), {this, func});
+        end
+        function future = solve_meg_forward_async(this, func, config)
+            future = duneuro_future(duneuro_matlab('solve_meg_forward_async', this.cpp_handle, func.cpp_handle, config), {this, func});
+        end
+        function future = compute_eeg_transfer_matrix_async(this, config)
+            future = duneuro_future(duneuro_matlab('compute_eeg_transfer_matrix_async', this.cpp_handle, config), {this}, @duneuro_meeg.wrap_transfer_matrix);
+        end
+        function future = compute_meg_transfer_matrix_async(this, config)
+            future = duneuro_future(duneuro_matlab('compute_meg_transfer_matrix_async', this.cpp_handle, config), {this}, @duneuro_meeg.wrap_transfer_matrix);
+        end
+        % a matlab transfer matrix is copied as double matrix, which stays in memory until the
+        % job finishes, and copying it blocks matlab. Copies above config.apply.async_copy_limit
+        % MiB (default 256) are rejected. A duneuro_transfer_matrix, computed with
+        % config.transfer_matrix_store.mapped set, is shared with the job instead.
+        function future = apply_eeg_transfer_async(this, transfer_matrix, dipoles, config)
+            dependencies = {this, transfer_matrix};
+            if isa(transfer_matrix, 'duneuro_transfer_matrix')
+                transfer_matrix = transfer_matrix.cpp_handle;
+            end
+            future = duneuro_future(duneuro_matlab('apply_eeg_transfer_async', this.cpp_handle, transfer_matrix, dipoles, config), dependencies);
+        end
+        function future = apply_meg_transfer_async(this, transfer_matrix, dipoles, config)
+            dependencies = {this, transfer_matrix};
+            if isa(transfer_matrix, 'duneuro_transfer_matrix')
+                transfer_matrix = transfer_matrix.cpp_handle;
+            end
+            future = duneuro_future(duneuro_matlab('apply_meg_transfer_async', this.cpp_handle, transfer_matrix, dipoles, config), dependencies);
+        end
+        % writes the mesh, electrodes and coils to a binary file, which load_snapshot restores
+        % without marshalling the constructor struct again. Saving the object afterwards only
+        % stores the name of the snapshot instead of the struct.
+        function save_snapshot(this, filename)
+            if isempty(this.constructor_arguments)
+                error('the object was loaded from the snapshot %s, which can be copied instead', this.snapshot);
+            end
+            duneuro_matlab('save_snapshot', this.cpp_handle, this.constructor_arguments, filename);
+            this.snapshot = filename;
+            % the electrodes and coils are part of the snapshot and need not be replayed by loadobj
+            this.electrodes = [];
+            this.coils = [];
+            this.projections = [];
+        end
         function print_citations(this)
             duneuro_matlab('print_citations', this.cpp_handle);
         end
         function s = saveobj(this)
-            s.constructor_arguments = this.constructor_arguments;
+            s.snapshot = this.snapshot;
+            if isempty(this.snapshot)
+                s.constructor_arguments = this.constructor_arguments;
+            else
+                s.constructor_arguments = [];
+            end
             s.source_model = this.source_model;
             s.electrodes = this.electrodes;
             s.coils = this.coils;
@@ -67,11 +174,54 @@ classdef duneuro_meeg < handle
         end
     end
     methods(Static)
+        % creates the driver on the background worker, wait returns a duneuro_meeg object
+        function future = create_async(config)
+            future = duneuro_future(duneuro_matlab('create_async', config), {}, @(handle) duneuro_meeg(config, handle));
+        end
+        % runs a cell array of commands {command, arguments...} within a single mex call. the
+        % command is given by its name or its opcode, see opcodes. nargouts contains the number
+        % of outputs of each command, results{i} is a cell array with the outputs of command i.
+        function results = batch(commands, nargouts)
+            if nargin < 2
+                nargouts = zeros(1, numel(commands));
+            end
+            if nargout > 0 || any(nargouts > 0)
+                results = duneuro_matlab('batch', commands, nargouts);
+            else
+                duneuro_matlab('batch', commands, nargouts);
+            end
+        end
+        % struct listing the live handles of each type
+        function h = handles()
+            h = duneuro_matlab('handles');
+        end
+        % destroys all drivers, functions, writers, transfer matrices and futures. the objects
+        % holding them become invalid.
+        function released = release_all()
+            released = duneuro_matlab('release_all');
+        end
+        % struct mapping each command name to its opcode
+        function codes = opcodes()
+            codes = duneuro_matlab('opcodes');
+        end
+        % creates a duneuro_meeg object from a file written by save_snapshot
+        function obj = load_snapshot(filename)
+            obj = duneuro_meeg([], duneuro_matlab('load_snapshot', filename));
+            obj.snapshot = filename;
+        end
+        function matrix = wrap_transfer_matrix(matrix)
+            if isa(matrix, 'uint64')
+                matrix = duneuro_transfer_matrix(matrix);
+            end
+        end
         function obj = loadobj(s)
-            obj = duneuro_meeg(s.constructor_arguments);
-            if ~isempty(s.source_model)
-                obj.set_source_model(s.source_model);
+            if isfield(s, 'snapshot') && ~isempty(s.snapshot)
+                obj = duneuro_meeg.load_snapshot(s.snapshot);
+            else
+                obj = duneuro_meeg(s.constructor_arguments);
             end
+            % the source model is not a state of the driver, it is passed with every call
+            obj.source_model = s.source_model;
             if ~isempty(s.electrodes)
                 obj.set_electrodes(s.electrodes.electrodes, s.electrodes.config);
             end
@@ -1,29 +1,71 @@
 classdef duneuro_point_vtk_writer < handle
   properties (Hidden = true)
     cpp_handle;
+    % binary mode: the data is only referenced here and encoded directly from the matlab arrays
+    % when writing, see write_point_vtu
+    binary = false;
+    config;
+    points;
+    scalar_data = {};
+    vector_data = {};
   end
 
   methods
-    % constructor
-    function this = duneuro_point_vtk_writer(point_data_or_dipole)
-      this.cpp_handle = duneuro_matlab('point_vtk_writer', point_data_or_dipole);
+    % constructor. If a config struct is given, the writer writes binary vtu files, possibly
+    % compressed, and accepts (N x steps) scalar and (3 x N x steps) vector data, written as a
+    % .pvd time series. Configuration: compress, compression_level, threads
+    function this = duneuro_point_vtk_writer(point_data_or_dipole, config)
+      if nargin < 2
+        this.cpp_handle = duneuro_matlab('point_vtk_writer', point_data_or_dipole);
+        return;
+      end
+      this.binary = true;
+      this.config = config;
+      if size(point_data_or_dipole, 1) == 3
+        this.points = point_data_or_dipole;
+      elseif numel(point_data_or_dipole) == 6
+        this.points = point_data_or_dipole(1:3);
+        this.points = this.points(:);
+        this.vector_data = {'moment', point_data_or_dipole(4:6)};
+      else
+        error('expected point matrix or single dipole');
+      end
     end
-    
+
     function add_scalar_data(this, point_data, name)
-      duneuro_matlab('point_writer_add_scalar_data', this.cpp_handle, point_data, name);
+      if this.binary
+        this.scalar_data(end+1:end+2) = {name, point_data};
+      else
+        duneuro_matlab('point_writer_add_scalar_data', this.cpp_handle, point_data, name);
+      end
     end
-    
+
     function add_vector_data(this, vector_data, name)
-      duneuro_matlab('point_writer_add_vector_data', this.cpp_handle, vector_data, name);
+      if this.binary
+        this.vector_data(end+1:end+2) = {name, vector_data};
+      else
+        duneuro_matlab('point_writer_add_vector_data', this.cpp_handle, vector_data, name);
+      end
     end
-    
-    function write(this, filename)
-      duneuro_matlab('point_writer_write', this.cpp_handle, filename);
+
+    % in binary mode, times optionally contains the time of each step
+    function write(this, filename, times)
+      if this.binary
+        args = {filename, this.points, this.scalar_data, this.vector_data, this.config};
+        if nargin > 2
+          args{end+1} = times;
+        end
+        duneuro_matlab('write_point_vtu', args{:});
+      else
+        duneuro_matlab('point_writer_write', this.cpp_handle, filename);
+      end
     end
-    
+
     % destructor
     function delete(this)
-      duneuro_matlab('point_writer_delete', this.cpp_handle);
+      if ~isempty(this.cpp_handle)
+        duneuro_matlab('point_writer_delete', this.cpp_handle);
+      end
     end
   end
 end
@@ -0,0 +1,7 @@
+% reads an array file written by duneuro_write_array or by a "save" statement of a
+% duneuro_matlab_runner job, e.g. a transfer matrix computed on a cluster node:
+%
+%   transfer = duneuro_read_array('transfer.dar');
+function value = duneuro_read_array(filename)
+  value = duneuro_matlab('read_array', filename);
+end
@@ -0,0 +1,19 @@
+classdef duneuro_transfer_matrix < handle
+    properties (Hidden = true)
+        cpp_handle;
+    end
+    methods
+        % Constructor, takes ownership of a handle to a mapped transfer matrix
+        function this = duneuro_transfer_matrix(cpp_handle)
+            this.cpp_handle = cpp_handle;
+        end
+        % size as seen from matlab, i.e. [nodes sensors]
+        function s = size(this)
+            s = duneuro_matlab('transfer_matrix_size', this.cpp_handle);
+        end
+        % Destructor
+        function delete(this)
+            duneuro_matlab('delete_transfer_matrix', this.cpp_handle);
+        end
+    end
+end
@@ -0,0 +1,60 @@
+classdef duneuro_vtu_series_writer < handle
+    % writes vertex or cell data on the mesh of a driver as a time series of binary, optionally
+    % zlib compressed vtu files collected in <config.filename>.pvd. The mesh is encoded only once.
+    % See VTUSeriesWriter for the options of config.
+    properties (Hidden = true)
+      cpp_handle;
+      % struct of the driver, whose mesh is set on the writer once the first matrix is added
+      mesh_source;
+    end
+
+    methods
+      % constructor, takes a duneuro_meeg object or the struct it was created from. Functions of
+      % a duneuro_meeg object are written on its grid.
+      function this = duneuro_vtu_series_writer(driver, config)
+        if isa(driver, 'duneuro_meeg')
+          this.cpp_handle = duneuro_matlab('vtu_series_writer', driver.cpp_handle, config);
+          this.mesh_source = driver.constructor_arguments;
+        else
+          this.cpp_handle = duneuro_matlab('vtu_series_writer', driver, config);
+        end
+      end
+
+      % appends one time step per column of the (vertices x steps) matrix, or per duneuro_function
+      function add_vertex_data(this, data, name, times)
+        data = this.prepare(data);
+        if nargin < 4
+          duneuro_matlab('series_writer_add_vertex_data', this.cpp_handle, data, name);
+        else
+          duneuro_matlab('series_writer_add_vertex_data', this.cpp_handle, data, name, times);
+        end
+      end
+
+      % appends one time step per column of the (cells x steps) matrix, or per duneuro_function
+      function add_cell_data(this, data, name, times)
+        data = this.prepare(data);
+        if nargin < 4
+          duneuro_matlab('series_writer_add_cell_data', this.cpp_handle, data, name);
+        else
+          duneuro_matlab('series_writer_add_cell_data', this.cpp_handle, data, name, times);
+        end
+      end
+
+      % destructor
+      function delete(this)
+        duneuro_matlab('series_writer_delete', this.cpp_handle);
+      end
+    end
+
+    methods (Access = private)
+      % handles of functions, or the matrix once the mesh of its nodes is set
+      function data = prepare(this, data)
+        if isa(data, 'duneuro_function')
+          data = [data.cpp_handle];
+        elseif ~isempty(this.mesh_source)
+          duneuro_matlab('series_writer_set_mesh', this.cpp_handle, this.mesh_source);
+          this.mesh_source = [];
+        end
+      end
+    end
+end
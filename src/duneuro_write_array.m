@@ -0,0 +1,14 @@
+% writes a numeric, logical, char, struct or cell array to a binary array file, e.g. to prepare
+% the inputs of a job for duneuro_matlab_runner:
+%
+%   duneuro_write_array(cfg, 'driver.dar');
+%
+% and in the job file:
+%
+%   load cfg driver.dar
+%   driver = create cfg
+%
+% see duneuro_read_array for reading the results of a job.
+function duneuro_write_array(value, filename)
+  duneuro_matlab('write_array', filename, value);
+end
@@ -0,0 +1,59 @@
+% writes the grid and tensors of a volume_conductor struct to a binary mesh file, which can be
+% passed to duneuro_meeg as volume_conductor.mesh_file instead of the grid and tensors:
+%
+%   duneuro_write_mesh_file(cfg.volume_conductor, 'head.dmesh');
+%   cfg.volume_conductor = struct('mesh_file', 'head.dmesh');
+%   meeg = duneuro_meeg(cfg);
+%
+% the file is memory mapped when the driver is created, so the mesh does not have to be loaded
+% into the workspace. Indices are stored with 4 bytes if possible.
+function duneuro_write_mesh_file(volume_conductor, filename)
+  grid = volume_conductor.grid;
+  labels = [];
+  conductivities = [];
+  tensors = [];
+  if isfield(volume_conductor, 'tensors')
+    t = volume_conductor.tensors;
+    if isfield(t, 'labels')
+      labels = t.labels;
+    end
+    if isfield(t, 'conductivities')
+      conductivities = t.conductivities;
+    end
+    if isfield(t, 'tensors')
+      tensors = t.tensors;
+    end
+  end
+  if size(grid.nodes, 1) ~= 3
+    error('expected nodes as 3xN matrix');
+  end
+  if ~isempty(tensors) && size(tensors, 1) ~= 9
+    error('expected tensors as 9xN matrix');
+  end
+  if max([double(max(grid.elements(:))), double(max(labels(:))), 0]) < 2^32
+    index_type = 'uint32';
+    index_bytes = 4;
+  else
+    index_type = 'uint64';
+    index_bytes = 8;
+  end
+
+  fid = fopen(filename, 'w', 'native');
+  if fid < 0
+    error('could not open %s', filename);
+  end
+  cleanup = onCleanup(@() fclose(fid));
+  header = zeros(1, 15, 'uint64');
+  header(1:8) = uint64([1, size(grid.nodes, 2), size(grid.elements, 2), ...
+                        size(grid.elements, 1), index_bytes, numel(labels), ...
+                        numel(conductivities), size(tensors, 2)]);
+  fwrite(fid, 'DUNEURMS', 'char');
+  fwrite(fid, header, 'uint64');
+  fwrite(fid, grid.nodes, 'double');
+  fwrite(fid, grid.elements, index_type);
+  fwrite(fid, labels, index_type);
+  index_data_bytes = (numel(grid.elements) + numel(labels)) * index_bytes;
+  fwrite(fid, zeros(1, mod(-index_data_bytes, 8), 'uint8'), 'uint8');
+  fwrite(fid, conductivities, 'double');
+  fwrite(fid, tensors, 'double');
+end
@@ -0,0 +1,325 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <mex.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_handler.hh>
+#include <duneuro/matlab/spatial_order.hh>
+#include <duneuro/matlab/transfer_matrix.hh>
+#include <duneuro/matlab/utilities.hh>
+
+/*
+ * Micro-benchmarks for the conversion between matlab arrays and duneuro data structures. The
+ * executable is linked against the stand-in for the mex api in duneuro/matlab/standalone, so it
+ * runs without matlab. Results are written as csv with one line per benchmark and size.
+ */
+
+namespace
+{
+  struct Options {
+    int minExponent = 3;
+    int maxExponent = 7;
+    int maxConfigExponent = 5;
+    int maxApplyExponent = 5;
+    int repetitions = 5;
+    std::string output;
+  };
+
+  void print_usage(const char* name)
+  {
+    std::cerr << "usage: " << name << " [--min-exponent n] [--max-exponent n]"
+              << " [--max-config-exponent n] [--max-apply-exponent n] [--repetitions n]"
+              << " [--output file.csv]\n";
+  }
+
+  Options parse_options(int argc, char** argv)
+  {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+      std::string arg(argv[i]);
+      if (i + 1 >= argc) {
+        print_usage(argv[0]);
+        std::exit(1);
+      }
+      if (arg == "--min-exponent") {
+        options.minExponent = std::atoi(argv[++i]);
+      } else if (arg == "--max-exponent") {
+        options.maxExponent = std::atoi(argv[++i]);
+      } else if (arg == "--max-config-exponent") {
+        options.maxConfigExponent = std::atoi(argv[++i]);
+      } else if (arg == "--max-apply-exponent") {
+        options.maxApplyExponent = std::atoi(argv[++i]);
+      } else if (arg == "--repetitions") {
+        options.repetitions = std::max(1, std::atoi(argv[++i]));
+      } else if (arg == "--output") {
+        options.output = argv[++i];
+      } else {
+        print_usage(argv[0]);
+        std::exit(1);
+      }
+    }
+    return options;
+  }
+
+  struct ArrayDeleter {
+    void operator()(mxArray* arr) const
+    {
+      mxDestroyArray(arr);
+    }
+  };
+  using ArrayPtr = std::unique_ptr<mxArray, ArrayDeleter>;
+
+  template <class T>
+  mxArray* make_uniform_matrix(std::size_t rows, std::size_t cols, mxClassID classID, T lower,
+                               T upper, std::mt19937_64& rng)
+  {
+    using Distribution = std::conditional_t<std::is_integral<T>::value,
+                                            std::uniform_int_distribution<T>,
+                                            std::uniform_real_distribution<T>>;
+    mxArray* arr = mxCreateUninitNumericMatrix(rows, cols, classID, mxREAL);
+    T* ptr = static_cast<T*>(mxGetData(arr));
+    Distribution dist(lower, upper);
+    std::generate(ptr, ptr + rows * cols, [&]() { return dist(rng); });
+    return arr;
+  }
+
+  mxArray* make_struct(std::initializer_list<std::pair<const char*, mxArray*>> fields)
+  {
+    mxArray* str = mxCreateStructMatrix(1, 1, 0, nullptr);
+    for (const auto& f : fields) {
+      mxAddField(str, f.first);
+      mxSetField(str, 0, f.first, f.second);
+    }
+    return str;
+  }
+
+  /** \brief synthetic tetrahedral mesh with the given number of elements and random indices */
+  template <class Index>
+  ArrayPtr make_mesh(std::size_t elements, mxClassID indexClass, std::mt19937_64& rng)
+  {
+    const std::size_t nodes = std::max<std::size_t>(4, elements / 5);
+    auto* nodeArray = make_uniform_matrix<double>(3, nodes, mxDOUBLE_CLASS, -100.0, 100.0, rng);
+    auto* elementArray =
+        make_uniform_matrix<Index>(4, elements, indexClass, 0, static_cast<Index>(nodes - 1), rng);
+    auto* labelArray = make_uniform_matrix<Index>(1, elements, indexClass, 0, 4, rng);
+    auto* conductivities = mxCreateDoubleMatrix(1, 5, mxREAL);
+    std::fill(mxGetPr(conductivities), mxGetPr(conductivities) + 5, 0.33);
+    auto* grid = make_struct({{"nodes", nodeArray}, {"elements", elementArray}});
+    auto* tensors = make_struct({{"labels", labelArray}, {"conductivities", conductivities}});
+    auto* vc = make_struct({{"grid", grid}, {"tensors", tensors}});
+    return ArrayPtr(make_struct({{"volume_conductor", vc}}));
+  }
+
+  /** \brief nested config struct with the given number of string entries, 10 per sub struct */
+  ArrayPtr make_config(std::size_t entries)
+  {
+    const std::size_t perSub = 10;
+    mxArray* root = mxCreateStructMatrix(1, 1, 0, nullptr);
+    for (std::size_t s = 0; s * perSub < entries; ++s) {
+      std::string subName = "sub" + std::to_string(s);
+      mxArray* sub = mxCreateStructMatrix(1, 1, 0, nullptr);
+      for (std::size_t k = 0; k < perSub && s * perSub + k < entries; ++k) {
+        std::string key = "key" + std::to_string(k);
+        mxAddField(sub, key.c_str());
+        mxSetField(sub, 0, key.c_str(), mxCreateString(std::to_string(s * perSub + k).c_str()));
+      }
+      mxAddField(root, subName.c_str());
+      mxSetField(root, 0, subName.c_str(), sub);
+    }
+    return ArrayPtr(root);
+  }
+
+  class Reporter
+  {
+  public:
+    Reporter(std::ostream& stream, int repetitions) : stream_(stream), repetitions_(repetitions)
+    {
+      stream_ << "benchmark,size,repetitions,min_seconds,median_seconds,bytes\n";
+    }
+
+    void run(const std::string& name, std::size_t size, std::size_t bytes,
+             const std::function<void()>& f)
+    {
+      std::vector<double> seconds;
+      for (int r = 0; r < repetitions_; ++r) {
+        auto begin = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        seconds.push_back(std::chrono::duration<double>(end - begin).count());
+      }
+      std::sort(seconds.begin(), seconds.end());
+      stream_ << name << "," << size << "," << repetitions_ << "," << seconds.front() << ","
+              << seconds[seconds.size() / 2] << "," << bytes << std::endl;
+    }
+
+  private:
+    std::ostream& stream_;
+    int repetitions_;
+  };
+
+  /**
+   * \brief stand-in for the transfer application of a driver
+   *
+   * every dipole contributes to a few nodes determined by its position, similar to the right hand
+   * side of a source model, and the result is the product of the matrix with these contributions.
+   */
+  std::vector<std::vector<double>>
+  apply_transfer(const duneuro::DenseMatrix<double>& tm,
+                 const std::vector<duneuro::Dipole<double, 3>>& dipoles)
+  {
+    const std::size_t nodesPerDipole = 8;
+    std::vector<std::vector<double>> result;
+    result.reserve(dipoles.size());
+    for (const auto& dipole : dipoles) {
+      const auto first = static_cast<std::size_t>(std::abs(dipole.position()[0]) * tm.cols());
+      std::vector<double> sensors(tm.rows(), 0.0);
+      for (std::size_t i = 0; i < tm.rows(); ++i) {
+        for (std::size_t k = 0; k < nodesPerDipole; ++k) {
+          sensors[i] += tm(i, (first + 97 * k) % tm.cols()) * dipole.moment()[k % 3];
+        }
+      }
+      result.push_back(std::move(sensors));
+    }
+    return result;
+  }
+
+  std::size_t array_bytes(const mxArray* arr)
+  {
+    return mxGetNumberOfElements(arr) * mxGetElementSize(arr);
+  }
+
+  std::size_t mesh_bytes(const mxArray* mesh)
+  {
+    auto* vc = mxGetField(mesh, 0, "volume_conductor");
+    auto* grid = mxGetField(vc, 0, "grid");
+    auto* tensors = mxGetField(vc, 0, "tensors");
+    return array_bytes(mxGetField(grid, 0, "nodes"))
+           + array_bytes(mxGetField(grid, 0, "elements"))
+           + array_bytes(mxGetField(tensors, 0, "labels"));
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options = parse_options(argc, argv);
+  std::ofstream file;
+  if (!options.output.empty()) {
+    file.open(options.output);
+    if (!file) {
+      std::cerr << "could not open " << options.output << "\n";
+      return 1;
+    }
+  }
+  Reporter reporter(options.output.empty() ? std::cout : file, options.repetitions);
+  std::mt19937_64 rng(42);
+
+  try {
+    for (int e = options.minExponent; e <= options.maxExponent; ++e) {
+      const std::size_t n = static_cast<std::size_t>(std::pow(10.0, e));
+      {
+        auto mesh = make_mesh<std::uint64_t>(n, mxUINT64_CLASS, rng);
+        reporter.run("extract_fitted_driver_data_from_struct_uint64", n, mesh_bytes(mesh.get()),
+                     [&]() {
+                       duneuro::FittedDriverData<3> data;
+                       duneuro::extract_fitted_driver_data_from_struct(mesh.get(), data);
+                     });
+        // baseline for the parallel validation and conversion
+        reporter.run("extract_fitted_driver_data_from_struct_uint64_serial", n,
+                     mesh_bytes(mesh.get()), [&]() {
+                       duneuro::FittedDriverData<3> data;
+                       duneuro::extract_fitted_driver_data_from_struct(mesh.get(), data, 1);
+                     });
+      }
+      {
+        auto mesh = make_mesh<std::uint32_t>(n, mxUINT32_CLASS, rng);
+        reporter.run("extract_fitted_driver_data_from_struct_uint32", n, mesh_bytes(mesh.get()),
+                     [&]() {
+                       duneuro::FittedDriverData<3> data;
+                       duneuro::extract_fitted_driver_data_from_struct(mesh.get(), data);
+                     });
+      }
+      {
+        ArrayPtr dipoles(make_uniform_matrix<double>(6, n, mxDOUBLE_CLASS, -1.0, 1.0, rng));
+        reporter.run("extract_dipoles", n, array_bytes(dipoles.get()),
+                     [&]() { duneuro::extract_dipoles(dipoles.get()); });
+        // overhead of the spatial reordering in the apply path
+        reporter.run("morton_order", n, array_bytes(dipoles.get()),
+                     [&]() { duneuro::morton_order(mxGetPr(dipoles.get()), n, 6); });
+      }
+      {
+        // n coils with a single projection each
+        ArrayPtr projections(make_uniform_matrix<double>(3, n, mxDOUBLE_CLASS, -1.0, 1.0, rng));
+        reporter.run("extract_projections", n, array_bytes(projections.get()),
+                     [&]() {
+                       std::size_t projectionsPerCoil;
+                       duneuro::extract_projections(projections.get(), projectionsPerCoil);
+                     });
+      }
+      if (e <= options.maxApplyExponent) {
+        // 64 sensors and n nodes, applied to 1000 dipoles. The single precision matrix is widened
+        // before it is applied, the difference to the double matrix is the cost of widening
+        const std::size_t sensors = 64;
+        const std::size_t dipoleCount = 1000;
+        ArrayPtr dipoles(
+            make_uniform_matrix<double>(6, dipoleCount, mxDOUBLE_CLASS, -1.0, 1.0, rng));
+        ArrayPtr doubleTm(make_uniform_matrix<double>(n, sensors, mxDOUBLE_CLASS, -1.0, 1.0, rng));
+        ArrayPtr singleTm(make_uniform_matrix<float>(n, sensors, mxSINGLE_CLASS, -1.0f, 1.0f, rng));
+        const duneuro::TransferInput input{mxGetPr(dipoles.get()), dipoleCount, false};
+        const Dune::ParameterTree config;
+        std::vector<double> out(sensors * dipoleCount);
+        reporter.run("apply_transfer_double", n, array_bytes(doubleTm.get()), [&]() {
+          const duneuro::DenseMatrix<double> tm(sensors, n, mxGetPr(doubleTm.get()));
+          duneuro::apply_transfer_blocked(tm, input, config, out.data(), apply_transfer);
+        });
+        reporter.run("apply_transfer_single", n, array_bytes(singleTm.get()), [&]() {
+          const duneuro::SingleTransferMatrix single{
+              static_cast<const float*>(mxGetData(singleTm.get())), sensors, n};
+          const auto tm = duneuro::widen_transfer_matrix(single, config);
+          duneuro::apply_transfer_blocked(*tm, input, config, out.data(), apply_transfer);
+        });
+      }
+      if (e <= options.maxConfigExponent) {
+        auto config = make_config(n);
+        reporter.run("matlab_struct_to_parametertree", n, 0,
+                     [&]() { duneuro::matlab_struct_to_parametertree(config.get()); });
+      }
+    }
+    {
+      // dispatch overhead of a command that does not do any work
+      ArrayPtr command(mxCreateString("reset_stats"));
+      const mxArray* prhs[] = {command.get()};
+      const std::size_t calls = 100000;
+      reporter.run("run_command", calls, 0, [&]() {
+        for (std::size_t i = 0; i < calls; ++i) {
+          duneuro::CommandHandler::run_command(0, nullptr, 1, prhs);
+        }
+      });
+    }
+  } catch (MexError& ex) {
+    std::cerr << "error: " << ex.what() << "\n";
+    return 1;
+  } catch (Dune::Exception& ex) {
+    std::cerr << "error: " << ex.what() << "\n";
+    return 1;
+  }
+  mexStandaloneRunAtExit();
+  return 0;
+}
@@ -0,0 +1,407 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <mex.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/array_file.hh>
+#include <duneuro/matlab/command_handler.hh>
+#include <duneuro/matlab/worker_group.hh>
+
+/*
+ * Runs the commands of duneuro_matlab from a job file without matlab. The executable is linked
+ * against the stand-in for the mex api in duneuro/matlab/standalone. A job file holds one
+ * statement per line:
+ *
+ *   # comment
+ *   load volume_conductor head.dar      read a variable from an array file
+ *   set cfg.type 'fitted'               set a variable or a (nested) field of a struct variable
+ *   set cfg.volume_conductor volume_conductor
+ *   driver = create cfg                 run a command, storing its outputs in variables
+ *   set_electrodes driver electrodes ecfg
+ *   tm = compute_eeg_transfer_matrix driver tcfg
+ *   save tm transfer.dar                write a variable to an array file
+ *   clear tm                            release variables
+ *
+ * arguments are variables, fields of struct variables (cfg.solver), numbers or strings in single
+ * quotes ('' denotes a quote). Several outputs are written as "a b = command ...", ~ discards an
+ * output. Array files are written and read in matlab with duneuro_write_array and
+ * duneuro_read_array. All objects are released when the job ends, the first failing statement
+ * aborts the job.
+ *
+ * A job can be executed by several processes, either by the ranks of mpirun (if built with mpi)
+ * or by local worker processes started with --workers. Every process runs the whole job, with
+ * the variables rank and ranks holding its rank and the number of processes. The transfer matrix
+ * rows of the sensors are computed independently, so each rank computes a part of them and the
+ * parts are concatenated on rank 0:
+ *
+ *   set tcfg.sensor_partition.index rank
+ *   set tcfg.sensor_partition.count ranks
+ *   tm = compute_eeg_transfer_matrix driver tcfg
+ *   gather tm                           concatenate the columns of all ranks on rank 0
+ *   save tm transfer.dar
+ *
+ * gather removes the variable on all other ranks, and save is only executed by rank 0. The mesh
+ * is best given as a mesh file (see duneuro_write_mesh_file), whose mapped pages are shared by
+ * the processes of a node. Local workers are not meant to be combined with mpirun.
+ */
+
+namespace
+{
+  struct Options {
+    std::string job;
+    bool verbose = false;
+    unsigned int workers = 1;
+  };
+
+  void print_usage(const char* name)
+  {
+    std::cerr << "usage: " << name << " [--verbose] [--workers count] job_file\n";
+  }
+
+  Options parse_options(int argc, char** argv)
+  {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+      std::string arg(argv[i]);
+      if (arg == "--verbose") {
+        options.verbose = true;
+      } else if (arg == "--workers" && i + 1 < argc) {
+        options.workers = std::max(1, std::atoi(argv[++i]));
+      } else if (options.job.empty() && arg.compare(0, 2, "--") != 0) {
+        options.job = arg;
+      } else {
+        print_usage(argv[0]);
+        std::exit(1);
+      }
+    }
+    if (options.job.empty()) {
+      print_usage(argv[0]);
+      std::exit(1);
+    }
+    return options;
+  }
+
+  struct ArrayDeleter {
+    void operator()(mxArray* arr) const
+    {
+      mxDestroyArray(arr);
+    }
+  };
+  using ArrayPtr = std::unique_ptr<mxArray, ArrayDeleter>;
+
+  struct Token {
+    std::string text;
+    bool quoted;
+  };
+
+  std::vector<Token> tokenize(const std::string& line)
+  {
+    std::vector<Token> tokens;
+    std::size_t i = 0;
+    while (i < line.size()) {
+      if (std::isspace(static_cast<unsigned char>(line[i]))) {
+        ++i;
+      } else if (line[i] == '#') {
+        break;
+      } else if (line[i] == '\'') {
+        std::string text;
+        for (++i;; ++i) {
+          if (i >= line.size()) {
+            DUNE_THROW(Dune::Exception, "unterminated string");
+          }
+          if (line[i] == '\'') {
+            if (i + 1 < line.size() && line[i + 1] == '\'') {
+              ++i;
+            } else {
+              break;
+            }
+          }
+          text += line[i];
+        }
+        ++i;
+        tokens.push_back({text, true});
+      } else {
+        std::size_t end = i;
+        while (end < line.size() && !std::isspace(static_cast<unsigned char>(line[end]))
+               && line[end] != '#' && line[end] != '\'') {
+          ++end;
+        }
+        tokens.push_back({line.substr(i, end - i), false});
+        i = end;
+      }
+    }
+    return tokens;
+  }
+
+  bool is_identifier(const std::string& name)
+  {
+    return !name.empty() && std::isalpha(static_cast<unsigned char>(name[0]))
+           && std::all_of(name.begin(), name.end(), [](char c) {
+                return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+              });
+  }
+
+  std::vector<std::string> split_path(const std::string& path)
+  {
+    std::vector<std::string> parts;
+    std::stringstream sstr(path);
+    std::string part;
+    while (std::getline(sstr, part, '.')) {
+      if (!is_identifier(part)) {
+        DUNE_THROW(Dune::Exception, "invalid name \"" << path << "\"");
+      }
+      parts.push_back(part);
+    }
+    if (parts.empty() || path.back() == '.') {
+      DUNE_THROW(Dune::Exception, "invalid name \"" << path << "\"");
+    }
+    return parts;
+  }
+
+  class Job
+  {
+  public:
+    Job(duneuro::WorkerGroup& group, bool verbose) : group_(group), verbose_(verbose)
+    {
+      variables_["rank"].reset(mxCreateDoubleScalar(group.rank()));
+      variables_["ranks"].reset(mxCreateDoubleScalar(group.size()));
+    }
+
+    void execute(const std::vector<Token>& tokens)
+    {
+      const std::string& keyword = tokens[0].text;
+      if (!tokens[0].quoted && keyword == "load") {
+        expect_arguments(tokens, 2);
+        variables_[variable_name(tokens[1])].reset(duneuro::read_array_file(tokens[2].text));
+      } else if (!tokens[0].quoted && keyword == "save") {
+        expect_arguments(tokens, 2);
+        if (group_.rank() == 0) {
+          duneuro::write_array_file(tokens[2].text, variable(tokens[1]));
+        }
+      } else if (!tokens[0].quoted && keyword == "clear") {
+        for (std::size_t i = 1; i < tokens.size(); ++i) {
+          variables_.erase(variable_name(tokens[i]));
+        }
+      } else if (!tokens[0].quoted && keyword == "gather") {
+        expect_arguments(tokens, 1);
+        const auto name = variable_name(tokens[1]);
+        mxArray* result = duneuro::gather_columns(group_, variable(tokens[1]));
+        if (result) {
+          variables_[name].reset(result);
+        } else {
+          variables_.erase(name);
+        }
+      } else if (!tokens[0].quoted && keyword == "set") {
+        expect_arguments(tokens, 2);
+        std::vector<ArrayPtr> temporaries;
+        assign(split_path(tokens[1].text), mxDuplicateArray(argument(tokens[2], temporaries)));
+      } else {
+        run(tokens);
+      }
+    }
+
+  private:
+    void expect_arguments(const std::vector<Token>& tokens, std::size_t count)
+    {
+      if (tokens.size() != count + 1) {
+        DUNE_THROW(Dune::Exception, tokens[0].text << " expects " << count << " arguments");
+      }
+    }
+
+    std::string variable_name(const Token& token)
+    {
+      if (token.quoted || !is_identifier(token.text)) {
+        DUNE_THROW(Dune::Exception, "invalid variable name \"" << token.text << "\"");
+      }
+      return token.text;
+    }
+
+    // a variable or a (nested) field of a struct variable
+    const mxArray* variable(const Token& token)
+    {
+      if (token.quoted) {
+        DUNE_THROW(Dune::Exception, "expected a variable instead of '" << token.text << "'");
+      }
+      const auto path = split_path(token.text);
+      auto it = variables_.find(path[0]);
+      const mxArray* arr = it == variables_.end() ? nullptr : it->second.get();
+      for (std::size_t i = 1; arr && i < path.size(); ++i) {
+        arr = mxIsStruct(arr) && mxGetNumberOfElements(arr) == 1
+                  ? mxGetField(arr, 0, path[i].c_str())
+                  : nullptr;
+      }
+      if (!arr) {
+        DUNE_THROW(Dune::Exception, "unknown variable \"" << token.text << "\"");
+      }
+      return arr;
+    }
+
+    // variables are passed as they are, literals are converted into temporaries
+    const mxArray* argument(const Token& token, std::vector<ArrayPtr>& temporaries)
+    {
+      if (token.quoted) {
+        temporaries.emplace_back(mxCreateString(token.text.c_str()));
+        return temporaries.back().get();
+      }
+      if (!std::isalpha(static_cast<unsigned char>(token.text[0]))) {
+        char* end = nullptr;
+        const double value = std::strtod(token.text.c_str(), &end);
+        if (end != token.text.c_str() && *end == '\0') {
+          temporaries.emplace_back(mxCreateDoubleScalar(value));
+          return temporaries.back().get();
+        }
+      }
+      return variable(token);
+    }
+
+    // store a value in a variable or a field of a struct variable, creating missing structs
+    void assign(const std::vector<std::string>& path, mxArray* value)
+    {
+      ArrayPtr owned(value);
+      ArrayPtr& root = variables_[path[0]];
+      if (path.size() == 1) {
+        root = std::move(owned);
+        return;
+      }
+      if (!root || !mxIsStruct(root.get()) || mxGetNumberOfElements(root.get()) != 1) {
+        root.reset(mxCreateStructMatrix(1, 1, 0, nullptr));
+      }
+      mxArray* node = root.get();
+      for (std::size_t i = 1; i < path.size(); ++i) {
+        const char* field = path[i].c_str();
+        mxAddField(node, field);
+        mxArray* child = mxGetField(node, 0, field);
+        if (i + 1 == path.size()) {
+          mxSetField(node, 0, field, owned.release());
+          mxDestroyArray(child);
+        } else {
+          if (!child || !mxIsStruct(child) || mxGetNumberOfElements(child) != 1) {
+            mxDestroyArray(child);
+            child = mxCreateStructMatrix(1, 1, 0, nullptr);
+            mxSetField(node, 0, field, child);
+          }
+          node = child;
+        }
+      }
+    }
+
+    void run(const std::vector<Token>& tokens)
+    {
+      auto assignment = std::find_if(tokens.begin(), tokens.end(),
+                                     [](const Token& t) { return !t.quoted && t.text == "="; });
+      std::vector<std::string> outputs;
+      auto command = tokens.begin();
+      if (assignment != tokens.end()) {
+        for (auto it = tokens.begin(); it != assignment; ++it) {
+          outputs.push_back(!it->quoted && it->text == "~" ? std::string() : variable_name(*it));
+        }
+        command = assignment + 1;
+        if (outputs.empty() || command == tokens.end()) {
+          DUNE_THROW(Dune::Exception, "expected \"outputs = command arguments\"");
+        }
+      }
+      if (command->quoted || !is_identifier(command->text)) {
+        DUNE_THROW(Dune::Exception, "invalid command \"" << command->text << "\"");
+      }
+      std::vector<ArrayPtr> temporaries;
+      std::vector<const mxArray*> inputs;
+      temporaries.emplace_back(mxCreateString(command->text.c_str()));
+      inputs.push_back(temporaries.back().get());
+      for (auto it = command + 1; it != tokens.end(); ++it) {
+        inputs.push_back(argument(*it, temporaries));
+      }
+      const int nlhs = outputs.size();
+      std::vector<mxArray*> results(std::max(nlhs, 1), nullptr);
+      const auto start = std::chrono::steady_clock::now();
+      try {
+        duneuro::CommandHandler::run_command(nlhs, results.data(), inputs.size(), inputs.data());
+      } catch (...) {
+        for (auto* arr : results) {
+          mxDestroyArray(arr);
+        }
+        throw;
+      }
+      if (verbose_) {
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        if (group_.size() > 1) {
+          std::cerr << "rank " << group_.rank() << ": ";
+        }
+        std::cerr << command->text << ": " << time.count() << " s\n";
+      }
+      for (int i = 0; i < std::max(nlhs, 1); ++i) {
+        if (i < nlhs && !outputs[i].empty()) {
+          variables_[outputs[i]].reset(results[i]);
+        } else {
+          mxDestroyArray(results[i]);
+        }
+      }
+    }
+
+    duneuro::WorkerGroup& group_;
+    bool verbose_;
+    std::map<std::string, ArrayPtr> variables_;
+  };
+}
+
+int main(int argc, char** argv)
+{
+  Options options = parse_options(argc, argv);
+  std::unique_ptr<duneuro::WorkerGroup> group;
+  try {
+    group = duneuro::WorkerGroup::create(argc, argv, options.workers);
+  } catch (Dune::Exception& ex) {
+    std::cerr << ex.what() << "\n";
+    return 1;
+  }
+  // opened by every process, as the position in an inherited file would be shared
+  std::ifstream job(options.job);
+  if (!job) {
+    std::cerr << "could not open " << options.job << "\n";
+    return group->finish(1);
+  }
+  int status = 0;
+  {
+    Job runner(*group, options.verbose);
+    std::string line;
+    for (std::size_t number = 1; status == 0 && std::getline(job, line); ++number) {
+      std::string error;
+      try {
+        const auto tokens = tokenize(line);
+        if (!tokens.empty()) {
+          runner.execute(tokens);
+        }
+      } catch (MexError& ex) {
+        error = ex.what();
+      } catch (Dune::Exception& ex) {
+        error = ex.what();
+      } catch (std::exception& ex) {
+        error = ex.what();
+      }
+      if (!error.empty()) {
+        std::cerr << options.job << ":" << number << ": ";
+        if (group->size() > 1) {
+          std::cerr << "rank " << group->rank() << ": ";
+        }
+        std::cerr << error << "\n";
+        status = 1;
+      }
+    }
+  }
+  duneuro::CommandHandler::at_exit();
+  return group->finish(status);
+}
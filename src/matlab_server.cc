@@ -0,0 +1,300 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <mex.h>
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <dune/common/exceptions.hh>
+
+#include <duneuro/matlab/command_handler.hh>
+#include <duneuro/matlab/handle_registry.hh>
+#include <duneuro/matlab/server_client.hh>
+#include <duneuro/matlab/server_protocol.hh>
+
+/*
+ * Local server hosting drivers, transfer matrices and all other objects for several matlab
+ * sessions, which connect through CommandHandler::connect_server. The executable is linked against
+ * the stand-in for the mex api in duneuro/matlab/standalone, so it runs without matlab.
+ *
+ * Every client is served by its own thread, and the requests of different clients run
+ * concurrently. Commands on a driver hold its lock, see DriverCache::lock, so only commands on
+ * the same driver wait for each other. Drivers created with driver_cache.enable from the same
+ * struct are shared between the clients, each client keeping its own electrodes and coils. All
+ * other drivers belong to the client that created them. The handles created by a client are
+ * released when it disconnects.
+ */
+
+namespace
+{
+  using Handle = duneuro::HandleRegistry::Handle;
+
+  struct Options {
+    std::string socket;
+    std::size_t sharedMemoryThreshold = std::size_t(1) << 20;
+  };
+
+  void print_usage(const char* name)
+  {
+    std::cerr << "usage: " << name << " --socket path [--shared-memory-threshold bytes]\n";
+  }
+
+  Options parse_options(int argc, char** argv)
+  {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+      std::string arg(argv[i]);
+      if (i + 1 >= argc) {
+        print_usage(argv[0]);
+        std::exit(1);
+      }
+      if (arg == "--socket") {
+        options.socket = argv[++i];
+      } else if (arg == "--shared-memory-threshold") {
+        options.sharedMemoryThreshold = std::strtoull(argv[++i], nullptr, 10);
+      } else {
+        print_usage(argv[0]);
+        std::exit(1);
+      }
+    }
+    if (options.socket.empty()) {
+      print_usage(argv[0]);
+      std::exit(1);
+    }
+    return options;
+  }
+
+  volatile std::sig_atomic_t stopRequested = 0;
+
+  void request_stop(int)
+  {
+    stopRequested = 1;
+  }
+
+  class ClientSession
+  {
+  public:
+    ClientSession(int fd, std::size_t sharedMemoryThreshold)
+        : fd_(fd), sharedMemoryThreshold_(sharedMemoryThreshold)
+    {
+    }
+
+    void run()
+    {
+      try {
+        std::string message;
+        if (handshake()) {
+          while (duneuro::receive_message(fd_, message)) {
+            serve(message);
+          }
+        }
+      } catch (Dune::Exception& ex) {
+        std::cerr << "client disconnected: " << ex.what() << "\n";
+      } catch (std::exception& ex) {
+        std::cerr << "client disconnected: " << ex.what() << "\n";
+      }
+      release_handles();
+    }
+
+  private:
+    bool handshake()
+    {
+      std::string message;
+      if (!duneuro::receive_message(fd_, message)) {
+        return false;
+      }
+      duneuro::MessageReader reader(message);
+      const auto version = reader.read<std::uint64_t>();
+      duneuro::MessageWriter response;
+      response.write<std::uint8_t>(version == duneuro::serverProtocolVersion ? 0 : 1);
+      if (version != duneuro::serverProtocolVersion) {
+        response.write_string("protocol version " + std::to_string(version) + ", expected "
+                              + std::to_string(duneuro::serverProtocolVersion));
+      }
+      duneuro::send_message(fd_, response.buffer());
+      return version == duneuro::serverProtocolVersion;
+    }
+
+    void serve(const std::string& request)
+    {
+      duneuro::SharedMemorySegments segments(sharedMemoryThreshold_);
+      duneuro::MessageWriter response;
+      execute(request, response, segments);
+      duneuro::send_message(fd_, response.buffer());
+      // the segments of the response are unlinked once the client has copied them
+      if (segments.size() > 0) {
+        std::string acknowledgement;
+        duneuro::receive_message(fd_, acknowledgement);
+      }
+    }
+
+    // run the command of the request and write the response
+    void execute(const std::string& request, duneuro::MessageWriter& response,
+                 duneuro::SharedMemorySegments& segments)
+    {
+      std::vector<mxArray*> inputs;
+      std::vector<mxArray*> outputs;
+      // handles created by other clients in the meantime are not recorded
+      duneuro::HandleRecording created;
+      std::string error;
+      // large outputs are created in shared memory, so that they are not copied again
+      duneuro::SharedMemoryAllocation allocation(segments);
+      try {
+        duneuro::MessageReader reader(request);
+        const auto nlhs = reader.read<std::uint32_t>();
+        const auto nrhs = reader.read<std::uint32_t>();
+        for (std::uint32_t i = 0; i < nrhs; ++i) {
+          inputs.push_back(reader.read_array());
+        }
+        // matlab provides space for one output even if none is requested
+        outputs.assign(std::max<std::uint32_t>(nlhs, 1), nullptr);
+        duneuro::CommandHandler::run_command(nlhs, outputs.data(), nrhs,
+                                             const_cast<const mxArray**>(inputs.data()));
+        duneuro::MessageWriter arrays;
+        for (auto* arr : outputs) {
+          arrays.write_array(arr, segments);
+        }
+        response.write<std::uint8_t>(0);
+        response.write<std::uint32_t>(segments.size());
+        response.write<std::uint32_t>(outputs.size());
+        response.write_bytes(arrays.buffer().data(), arrays.buffer().size());
+      } catch (MexError& ex) {
+        error = ex.what();
+      } catch (Dune::Exception& ex) {
+        error = ex.what();
+      } catch (std::exception& ex) {
+        error = ex.what();
+      }
+      for (auto* arr : inputs) {
+        mxDestroyArray(arr);
+      }
+      for (auto* arr : outputs) {
+        mxDestroyArray(arr);
+      }
+      if (!error.empty()) {
+        segments.clear();
+        response = duneuro::MessageWriter();
+        response.write<std::uint8_t>(1);
+        response.write_string(error);
+      }
+      track_handles(created.handles());
+    }
+
+    // keep the handles of this client which are still alive and add the ones created by the
+    // last command
+    void track_handles(const std::vector<Handle>& created)
+    {
+      std::vector<Handle> owned;
+      for (auto handle : handles_) {
+        if (duneuro::HandleRegistry::instance().type(handle) != duneuro::HandleType::none) {
+          owned.push_back(handle);
+        }
+      }
+      for (auto handle : created) {
+        if (duneuro::HandleRegistry::instance().type(handle) != duneuro::HandleType::none) {
+          owned.push_back(handle);
+        }
+      }
+      handles_ = std::move(owned);
+    }
+
+    void release_handles()
+    {
+      // release in the order of the handle types, e.g. futures before their drivers
+      std::stable_sort(handles_.begin(), handles_.end(), [](Handle a, Handle b) {
+        return duneuro::HandleRegistry::encoded_type(a)
+               < duneuro::HandleRegistry::encoded_type(b);
+      });
+      for (auto handle : handles_) {
+        duneuro::HandleRegistry::instance().release(handle);
+      }
+      handles_.clear();
+    }
+
+    int fd_;
+    std::size_t sharedMemoryThreshold_;
+    std::vector<Handle> handles_;
+  };
+
+  struct Connection {
+    int fd;
+    std::atomic<bool> done{false};
+    std::thread thread;
+  };
+
+  void reap(std::list<std::unique_ptr<Connection>>& connections, bool all)
+  {
+    for (auto it = connections.begin(); it != connections.end();) {
+      if (all) {
+        ::shutdown((*it)->fd, SHUT_RDWR);
+      }
+      if (all || (*it)->done) {
+        (*it)->thread.join();
+        ::close((*it)->fd);
+        it = connections.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Options options = parse_options(argc, argv);
+  int listenFd;
+  try {
+    listenFd = duneuro::listen_server_socket(options.socket);
+  } catch (Dune::Exception& ex) {
+    std::cerr << ex.what() << "\n";
+    return 1;
+  }
+  duneuro::ServerConnection::instance().disable();
+  struct sigaction action = {};
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+  std::cerr << "listening at " << options.socket << "\n";
+
+  std::list<std::unique_ptr<Connection>> connections;
+  while (!stopRequested) {
+    pollfd pfd = {listenFd, POLLIN, 0};
+    if (::poll(&pfd, 1, 500) <= 0) {
+      continue;
+    }
+    int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    reap(connections, false);
+    connections.push_back(std::make_unique<Connection>());
+    Connection* connection = connections.back().get();
+    connection->fd = fd;
+    connection->thread = std::thread([connection, &options]() {
+      ClientSession(connection->fd, options.sharedMemoryThreshold).run();
+      connection->done = true;
+    });
+  }
+
+  ::close(listenFd);
+  ::unlink(options.socket.c_str());
+  reap(connections, true);
+  duneuro::CommandHandler::at_exit();
+  return 0;
+}